@@ -0,0 +1,111 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+#include <atomic>
+#include <new>
+
+// global allocation counter; a bench is a single translation unit, so the
+// replacement operators below are defined exactly once per executable
+static std::atomic<uint64_t> bench_nallocs(0);
+
+// out of line so the compiler does not pair malloc/free with new/delete
+__attribute__((noinline)) static void *bench_alloc(size_t size)
+{
+    bench_nallocs.fetch_add(1, std::memory_order_relaxed);
+    void *ptr = malloc(size ? size : 1);
+    if (ptr == nullptr)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+__attribute__((noinline)) static void bench_free(void *ptr)
+{
+    free(ptr);
+}
+
+void *operator new(size_t size)
+{
+    return bench_alloc(size);
+}
+
+void *operator new[](size_t size)
+{
+    return bench_alloc(size);
+}
+
+void operator delete(void *ptr) noexcept
+{
+    bench_free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+    bench_free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept
+{
+    bench_free(ptr);
+}
+
+void operator delete[](void *ptr, size_t) noexcept
+{
+    bench_free(ptr);
+}
+
+// keep the compiler from discarding a result
+template <typename T>
+static inline void do_not_optimize(T &val)
+{
+    asm volatile("" : : "g"(&val) : "memory");
+}
+
+static inline int64_t bench_now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+struct BenchResult
+{
+    double ns = 0;     // per call
+    double allocs = 0; // operator new calls per call
+};
+
+/**
+ * @brief Run fn until at least min_ms have passed (after a warm-up) and
+ * print the mean time and number of heap allocations per call.
+ */
+template <typename Fn>
+static BenchResult bench_measure(const char *name, Fn &&fn, int64_t min_ms = 200)
+{
+    for (int i = 0; i < 1000; i++)
+        fn();
+    uint64_t iters = 0;
+    uint64_t nallocs = bench_nallocs.load();
+    int64_t start = bench_now_ns();
+    int64_t elapsed = 0;
+    do
+    {
+        for (int i = 0; i < 1000; i++)
+            fn();
+        iters += 1000;
+        elapsed = bench_now_ns() - start;
+    } while (elapsed < min_ms * 1000000);
+    BenchResult res;
+    res.ns = (double)elapsed / iters;
+    res.allocs = (double)(bench_nallocs.load() - nallocs) / iters;
+    printf("%-44s %10.1f ns/op %8.2f allocs/op\n", name, res.ns, res.allocs);
+    return res;
+}
+
+// ns/op only, see bench_measure
+template <typename Fn>
+static double bench_run(const char *name, Fn &&fn, int64_t min_ms = 200)
+{
+    return bench_measure(name, fn, min_ms).ns;
+}
@@ -0,0 +1,129 @@
+/**
+ * @file bench_control.cpp
+ * @brief Control path primitives: camera ID hashing, string_format, the
+ * NetPacket JSON round trip, the imagecams lookup and CharContainer
+ * construction, with representative payloads.
+ *
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <stdexcept>
+
+#include "stringhasher.hpp"
+#include "string_format.hpp"
+#include "netpacket.hpp"
+#include "charcontainer.hpp"
+#include "bench.hpp"
+
+int main()
+{
+    StringHasher hasher;
+    std::vector<std::string> idstrs = {"DEV_1AB22C00E2E5", "DEV_000F315C1A4B", "DEV_1AB22C00E2E6", "DEV_000F315C1A4C"};
+
+    printf("-- StringHasher::get_hash\n");
+    {
+        std::string idstr = idstrs[0];
+        bench_measure("  get_hash(\"DEV_1AB22C00E2E5\")", [&]()
+                      { uint32_t hash = hasher.get_hash(idstr); do_not_optimize(hash); });
+        // a std::string temporary from a C string, as cam_id lookups by name do
+        const char *cidstr = idstrs[1].c_str();
+        bench_measure("  get_hash(const char *)", [&]()
+                      { uint32_t hash = hasher.get_hash(cidstr); do_not_optimize(hash); });
+        std::string longid = "DEV_1AB22C00E2E5_with_a_name_longer_than_the_sso_buffer";
+        bench_measure("  get_hash(56 characters)", [&]()
+                      { uint32_t hash = hasher.get_hash(longid); do_not_optimize(hash); });
+    }
+
+    printf("-- string_format\n");
+    {
+        double exposure = 10000.0;
+        int64_t width = 1936, height = 1216;
+        const char *idstr = idstrs[0].c_str();
+        bench_measure("  \"%.6f\" (exposure)", [&]()
+                      { std::string out = string_format("%.6f", exposure); do_not_optimize(out); });
+        bench_measure("  \"%ld x %ld\" (image size)", [&]()
+                      { std::string out = string_format("%ld x %ld", width, height); do_not_optimize(out); });
+        bench_measure("  \"%s: %s\" (log line)", [&]()
+                      { std::string out = string_format("%s: %s", idstr, "Frame captured successfully, writing to disk"); do_not_optimize(out); });
+        bench_measure("  std::to_string(double) (reference)", [&]()
+                      { std::string out = std::to_string(exposure); do_not_optimize(out); });
+    }
+
+    printf("-- NetPacket JSON round trip\n");
+    {
+        std::vector<std::pair<const char *, std::string>> requests = {
+            {"  get exposure_us", R"({"cmd_type": "get", "cam_id": "2739061257", "command": 105, "arguments": [], "retcode": 0, "retargs": []})"},
+            {"  set image_size", R"({"cmd_type": "set", "cam_id": "2739061257", "command": 200, "arguments": ["1936", "1216"], "retcode": 0, "retargs": ["10000.000000"]})"},
+            {"  reconfigure (4 features)", R"({"cmd_type": "reconfigure", "cam_id": "2739061257", "command": 0, "arguments": ["105", "5000.0", "106", "30.0", "200", "1936", "1216", "102", "Mono12"], "retcode": 0, "retargs": []})"},
+        };
+        for (auto &request : requests)
+        {
+            printf("%s (%zu bytes)\n", request.first, request.second.size());
+            bench_measure("    json::parse -> NetPacket -> dump", [&]()
+                          {
+                              NetPacket packet = json::parse(request.second);
+                              std::string out = json(packet).dump();
+                              do_not_optimize(out); });
+            NetPacketDecoder decoder;
+            NetPacket packet;
+            std::string txbuf;
+            bench_measure("    NetPacketDecoder -> encode_netpacket", [&]()
+                          {
+                              decoder.decode(request.second.data(), request.second.size(), packet);
+                              encode_netpacket(packet, txbuf);
+                              do_not_optimize(txbuf); });
+        }
+    }
+
+    printf("-- imagecams.at()\n");
+    for (int ncams : {1, 4, 16})
+    {
+        // the server maps hashed camera IDs to cameras; the value is not dereferenced here
+        std::map<uint32_t, void *> imagecams;
+        std::vector<uint32_t> camids;
+        for (int i = 0; i < ncams; i++)
+        {
+            uint32_t hash = hasher.get_hash(string_format("DEV_1AB22C00%04X", i));
+            imagecams[hash] = &imagecams;
+            camids.push_back(hash);
+        }
+        // what cmd_get does: cam_id string -> atol -> at()
+        std::string cam_id = std::to_string(camids[ncams / 2]);
+        char name[64];
+        snprintf(name, sizeof(name), "  %2d cameras: atol + at() hit", ncams);
+        bench_measure(name, [&]()
+                      {
+                          uint32_t chash = atol(cam_id.c_str());
+                          void *cam = imagecams.at(chash);
+                          do_not_optimize(cam); });
+        uint32_t missing = camids[0] ^ 0x5a5a5a5a;
+        snprintf(name, sizeof(name), "  %2d cameras: at() miss (out_of_range)", ncams);
+        bench_measure(name, [&]()
+                      {
+                          void *cam = nullptr;
+                          try
+                          {
+                              cam = imagecams.at(missing);
+                          }
+                          catch (const std::out_of_range &oor)
+                          {
+                          }
+                          do_not_optimize(cam); });
+    }
+
+    printf("-- CharContainer construction\n");
+    {
+        const char *triglines[] = {"Line0", "Line1", "Line2", "Line3"};
+        const char *pixel_formats[] = {"Mono8", "Mono10", "Mono10p", "Mono12", "Mono12p", "Mono12Packed", "Mono14",
+                                       "BayerRG8", "BayerRG10", "BayerRG12", "BayerRG12Packed", "RGB8", "BGR8"};
+        bench_measure("  4 trigger lines", [&]()
+                      { CharContainer cc(triglines, 4); do_not_optimize(cc); });
+        bench_measure("  13 pixel formats, select \"Mono12\"", [&]()
+                      { CharContainer cc(pixel_formats, 13, "Mono12"); do_not_optimize(cc); });
+    }
+    return 0;
+}
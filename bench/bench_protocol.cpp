@@ -0,0 +1,171 @@
+/**
+ * @file bench_protocol.cpp
+ * @brief Request decode, cmd_type dispatch and reply encode: nlohmann DOM
+ * and string compare chain against the streaming decoder, perfect hash and
+ * direct encoder used by the server, and the allocation count of the
+ * server's steady state request loop through CaptureManager::execute on
+ * stub cameras.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include <czmq.h>
+
+#include "netpacket.hpp"
+#include "capture_manager.hpp"
+#include "string_format.hpp"
+#include "stub_camera.hpp"
+#include "bench.hpp"
+
+// the if/else chain order of the server before the dispatch table
+static int dispatch_chain(const std::string &cmd_type)
+{
+    if (cmd_type == "quit")
+        return 1;
+    else if (cmd_type == "status")
+        return 2;
+    else if (cmd_type == "metrics")
+        return 3;
+    else if (cmd_type == "sequence")
+        return 4;
+    else if (cmd_type == "reconfigure")
+        return 5;
+    else if (cmd_type == "get_feature" || cmd_type == "set_feature")
+        return 6;
+    else if (cmd_type == "list_features")
+        return 8;
+    else if (cmd_type == "list")
+        return 9;
+    else if (cmd_type == "start_capture_all")
+        return 10;
+    else if (cmd_type == "stop_capture_all")
+        return 11;
+    else if (cmd_type == "start_capture")
+        return 12;
+    else if (cmd_type == "stop_capture")
+        return 13;
+    else if (cmd_type == "get")
+        return 14;
+    else if (cmd_type == "set")
+        return 15;
+    return 0;
+}
+
+struct Payload
+{
+    const char *name;
+    std::string request;
+    std::vector<std::string> retargs; // what the handler replies for the stub cameras
+};
+
+int main()
+{
+    // the capability and envelope caches go to a scratch directory, not the user's
+    char cache_dir[] = "/tmp/bench_protocol.XXXXXX";
+    if (mkdtemp(cache_dir) != NULL)
+        setenv("XDG_CACHE_HOME", cache_dir, 1);
+    zsys_init();
+    zsys_set_logstream(NULL); // handlers log every request
+    CaptureManager manager;
+    ServerConfig config;
+    config.adio_minor = -1;
+    if (manager.open(config) != VmbErrorSuccess)
+    {
+        printf("!! CaptureManager::open failed on the stub cameras\n");
+        return 1;
+    }
+    uint32_t cam = manager.camera_ids()[0];
+    std::vector<std::string> status;
+    for (uint32_t id : manager.camera_ids())
+    {
+        const char *idstr = manager.camera(id)->get_info().idstr.c_str();
+        double temp = 0;
+        for (StubCamera &stub : stub_cameras)
+        {
+            if (strcmp(stub.idstr, idstr) == 0)
+                temp = stub.temperature;
+        }
+        std::vector<std::string> entry = {std::to_string(id), idstr, "False", "Sensor", string_format("%.6f", temp), "-1", "-1", "-1"};
+        status.insert(status.end(), entry.begin(), entry.end());
+    }
+    // what the Python client sends, including its stale retcode / retargs
+    std::vector<Payload> payloads = {
+        {"get exposure_us",
+         string_format(R"({"cmd_type": "get", "cam_id": "%u", "command": %d, "arguments": [], "retcode": 0, "retargs": []})", cam, (int)CommandNames::exposure_us),
+         {"10000.000000"}},
+        {"set image_size",
+         string_format(R"({"cmd_type": "set", "cam_id": "%u", "command": %d, "arguments": ["1936", "1216"], "retcode": 0, "retargs": ["10000.000000"]})", cam, (int)CommandNames::image_size),
+         {"1936", "1216"}},
+        {"status (all cameras)",
+         R"({"cmd_type": "status", "cam_id": "", "command": 0, "arguments": [], "retcode": 0, "retargs": []})",
+         status},
+    };
+    int ret = 0;
+    for (Payload &load : payloads)
+    {
+        printf("-- %s (%zu bytes)\n", load.name, load.request.size());
+        NetPacket reference = json::parse(load.request);
+        reference.retargs = load.retargs;
+
+        double dom_decode = bench_run("  decode: json::parse -> NetPacket", [&]()
+                                      { NetPacket packet = json::parse(load.request); do_not_optimize(packet); });
+        NetPacketDecoder decoder;
+        NetPacket reused;
+        double sax_decode = bench_run("  decode: NetPacketDecoder (reused packet)", [&]()
+                                      { bool ok = decoder.decode(load.request.data(), load.request.size(), reused); do_not_optimize(ok); });
+
+        double chain = bench_run("  dispatch: string compare chain", [&]()
+                                 { int idx = dispatch_chain(reference.cmd_type); do_not_optimize(idx); });
+        double phash = bench_run("  dispatch: perfect hash", [&]()
+                                 { CmdType type = cmd_lookup(reference.cmd_type); do_not_optimize(type); });
+
+        double dom_encode = bench_run("  encode: json(packet).dump()", [&]()
+                                      { json j = reference; std::string out = j.dump(); do_not_optimize(out); });
+        std::string txbuf;
+        double direct_encode = bench_run("  encode: encode_netpacket (reused buffer)", [&]()
+                                         { encode_netpacket(reference, txbuf); do_not_optimize(txbuf); });
+
+        decoder.decode(load.request.data(), load.request.size(), reused);
+        if (reused.cmd_type != reference.cmd_type || reused.cam_id != reference.cam_id || reused.command != reference.command || reused.arguments != reference.arguments)
+            printf("  !! NetPacketDecoder result differs from nlohmann\n");
+        encode_netpacket(reference, txbuf);
+        if (json::parse(txbuf) != json(reference))
+            printf("  !! encode_netpacket output differs from nlohmann\n");
+        printf("  total: %.1f -> %.1f ns/op (%.1fx)\n", dom_decode + chain + dom_encode, sax_decode + phash + direct_encode,
+               (dom_decode + chain + dom_encode) / (sax_decode + phash + direct_encode));
+
+        // the server loop: decode into the reused packet, run the real
+        // handler on the stub camera, encode the reply into the reused
+        // buffer. operator new is counted; czmq formats the handlers' log
+        // lines with malloc, outside the count.
+        VmbError_t err = VmbErrorSuccess;
+        BenchResult loop = bench_measure("  server loop: decode -> execute -> encode", [&]()
+                                         {
+                                             decoder.decode(load.request.data(), load.request.size(), reused);
+                                             err = manager.execute(reused);
+                                             reused.retcode = err;
+                                             encode_netpacket(reused, manager.reply(), txbuf);
+                                             do_not_optimize(txbuf); });
+        reference.retcode = VmbErrorSuccess;
+        encode_netpacket(reference, txbuf);
+        std::string expected = txbuf;
+        encode_netpacket(reused, manager.reply(), txbuf);
+        if (err != VmbErrorSuccess || txbuf != expected)
+        {
+            printf("  !! handler reply differs from the expected reply: %s\n", txbuf.c_str());
+            ret = 1;
+        }
+        if (loop.allocs > 0)
+        {
+            printf("  !! server loop allocates after warm-up\n");
+            ret = 1;
+        }
+    }
+    manager.close();
+    return ret;
+}
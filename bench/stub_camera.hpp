@@ -0,0 +1,392 @@
+#pragma once
+
+/**
+ * @file stub_camera.hpp
+ * @brief In-memory stand-in for alliedcam and the VmbC feature calls, so
+ * CaptureManager and its command handlers run in a bench without cameras.
+ *
+ * Cameras are fixed entries with a few scalar features; everything the
+ * stub does not model returns VmbErrorNotFound, which the server treats
+ * as a feature the camera does not have. No frames are delivered. Include
+ * in exactly one translation unit.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "alliedcam.h"
+
+struct StubCamera
+{
+    const char *idstr;
+    const char *name;
+    const char *model;
+    const char *serial;
+    double temperature;
+    double exposure_us = 10000;
+    double framerate = 30;
+    VmbBool_t framerate_auto = VmbBoolFalse;
+    VmbInt64_t width = 1936;
+    VmbInt64_t height = 1216;
+    VmbInt64_t ofst_x = 0;
+    VmbInt64_t ofst_y = 0;
+    VmbInt64_t throughput_limit = 450000000;
+    std::string image_format = "Mono8";
+    std::string sensor_bit_depth = "Bpp8";
+    std::string trigline = "Line0";
+    std::string trigline_mode = "Input";
+    std::string trigline_src = "Off";
+};
+
+static std::vector<StubCamera> stub_cameras = {
+    {"DEV_1AB22C00E2E5", "Allied Vision 1800 U-240m", "1800 U-240m", "0536", 41.25},
+    {"DEV_1AB22C00E2E6", "Allied Vision 1800 U-240m", "1800 U-240m", "0537", 43.5},
+};
+
+// handles are pointers to the entries; the VmbC handle is the same pointer
+static inline StubCamera *stub_camera(const void *handle)
+{
+    return (StubCamera *)handle;
+}
+
+// pointers and strings in one block, so allied_free_list releases both
+static VmbError_t stub_list(const std::vector<const char *> &items, char ***arr, bool **avail, VmbUint32_t *narr)
+{
+    size_t size = items.size() * sizeof(char *);
+    for (const char *item : items)
+        size += strlen(item) + 1;
+    *arr = (char **)malloc(size);
+    char *str = (char *)(*arr + items.size());
+    for (size_t i = 0; i < items.size(); i++)
+    {
+        strcpy(str, items[i]);
+        (*arr)[i] = str;
+        str += strlen(items[i]) + 1;
+    }
+    if (avail != NULL)
+        *avail = NULL;
+    *narr = (VmbUint32_t)items.size();
+    return VmbErrorSuccess;
+}
+
+VmbError_t allied_init_api(const char *config_path)
+{
+    return VmbErrorSuccess;
+}
+
+VmbError_t allied_close_api()
+{
+    return VmbErrorSuccess;
+}
+
+VmbError_t allied_list_cameras(VmbCameraInfo_t **cameras, VmbUint32_t *count)
+{
+    *cameras = (VmbCameraInfo_t *)calloc(stub_cameras.size(), sizeof(VmbCameraInfo_t));
+    for (size_t i = 0; i < stub_cameras.size(); i++)
+    {
+        (*cameras)[i].cameraIdString = stub_cameras[i].idstr;
+        (*cameras)[i].cameraIdExtended = stub_cameras[i].idstr;
+        (*cameras)[i].cameraName = stub_cameras[i].name;
+        (*cameras)[i].modelName = stub_cameras[i].model;
+        (*cameras)[i].serialString = stub_cameras[i].serial;
+    }
+    *count = (VmbUint32_t)stub_cameras.size();
+    return VmbErrorSuccess;
+}
+
+VmbError_t allied_open_camera(AlliedCameraHandle_t *handle, const char *id, VmbUint32_t bufsize)
+{
+    for (StubCamera &cam : stub_cameras)
+    {
+        if (strcmp(cam.idstr, id) == 0)
+        {
+            *handle = (AlliedCameraHandle_t)&cam;
+            return VmbErrorSuccess;
+        }
+    }
+    return VmbErrorNotFound;
+}
+
+VmbError_t allied_close_camera(AlliedCameraHandle_t *handle)
+{
+    *handle = nullptr;
+    return VmbErrorSuccess;
+}
+
+VmbError_t allied_start_capture(AlliedCameraHandle_t handle, AlliedCaptureCallback callback, void *user_data)
+{
+    return VmbErrorSuccess;
+}
+
+VmbError_t allied_stop_capture(AlliedCameraHandle_t handle)
+{
+    return VmbErrorSuccess;
+}
+
+VmbError_t allied_realloc_framebuffer(AlliedCameraHandle_t handle, VmbUint32_t bufsize)
+{
+    return VmbErrorSuccess;
+}
+
+VmbHandle_t allied_get_vmbhandle(AlliedCameraHandle_t handle)
+{
+    return (VmbHandle_t)handle;
+}
+
+const char *allied_strerr(VmbError_t status)
+{
+    return status == VmbErrorSuccess ? "Success" : "Stub error";
+}
+
+VmbUint32_t allied_get_frame_size(AlliedCameraHandle_t handle)
+{
+    return (VmbUint32_t)(stub_camera(handle)->width * stub_camera(handle)->height);
+}
+
+void allied_free_list(char ***list)
+{
+    free(*list);
+    *list = NULL;
+}
+
+VmbError_t allied_get_temperature(AlliedCameraHandle_t handle, double *temp)
+{
+    *temp = stub_camera(handle)->temperature;
+    return VmbErrorSuccess;
+}
+
+VmbError_t allied_get_temperature_src(AlliedCameraHandle_t handle, const char **src)
+{
+    *src = "Sensor";
+    return VmbErrorSuccess;
+}
+
+#define STUB_STRING_FEATURE(N)                                                 \
+    VmbError_t allied_get_##N(AlliedCameraHandle_t handle, const char **value) \
+    {                                                                          \
+        *value = stub_camera(handle)->N.c_str();                               \
+        return VmbErrorSuccess;                                                \
+    }                                                                          \
+    VmbError_t allied_set_##N(AlliedCameraHandle_t handle, const char *value)  \
+    {                                                                          \
+        stub_camera(handle)->N = value;                                        \
+        return VmbErrorSuccess;                                                \
+    }
+
+STUB_STRING_FEATURE(image_format)
+STUB_STRING_FEATURE(sensor_bit_depth)
+STUB_STRING_FEATURE(trigline)
+STUB_STRING_FEATURE(trigline_mode)
+STUB_STRING_FEATURE(trigline_src)
+
+VmbError_t allied_get_exposure_us(AlliedCameraHandle_t handle, double *value)
+{
+    *value = stub_camera(handle)->exposure_us;
+    return VmbErrorSuccess;
+}
+
+VmbError_t allied_set_exposure_us(AlliedCameraHandle_t handle, double value)
+{
+    stub_camera(handle)->exposure_us = value;
+    return VmbErrorSuccess;
+}
+
+VmbError_t allied_get_acq_framerate(AlliedCameraHandle_t handle, double *value)
+{
+    *value = stub_camera(handle)->framerate;
+    return VmbErrorSuccess;
+}
+
+VmbError_t allied_set_acq_framerate(AlliedCameraHandle_t handle, double value)
+{
+    stub_camera(handle)->framerate = value;
+    return VmbErrorSuccess;
+}
+
+VmbError_t allied_get_acq_framerate_auto(AlliedCameraHandle_t handle, VmbBool_t *value)
+{
+    *value = stub_camera(handle)->framerate_auto;
+    return VmbErrorSuccess;
+}
+
+VmbError_t allied_set_acq_framerate_auto(AlliedCameraHandle_t handle, bool value)
+{
+    stub_camera(handle)->framerate_auto = value ? VmbBoolTrue : VmbBoolFalse;
+    return VmbErrorSuccess;
+}
+
+VmbError_t allied_get_throughput_limit(AlliedCameraHandle_t handle, VmbInt64_t *value)
+{
+    *value = stub_camera(handle)->throughput_limit;
+    return VmbErrorSuccess;
+}
+
+VmbError_t allied_set_throughput_limit(AlliedCameraHandle_t handle, VmbInt64_t value)
+{
+    stub_camera(handle)->throughput_limit = value;
+    return VmbErrorSuccess;
+}
+
+VmbError_t allied_get_throughput_limit_range(AlliedCameraHandle_t handle, VmbInt64_t *vmin, VmbInt64_t *vmax, VmbInt64_t *vstep)
+{
+    *vmin = 1000000;
+    *vmax = 450000000;
+    if (vstep != NULL)
+        *vstep = 1;
+    return VmbErrorSuccess;
+}
+
+VmbError_t allied_get_trigline_src_list(AlliedCameraHandle_t handle, char ***arr, bool **avail, VmbUint32_t *narr)
+{
+    return stub_list({"Off", "ExposureActive", "FrameTriggerWait"}, arr, avail, narr);
+}
+
+VmbError_t allied_get_triglines_list(AlliedCameraHandle_t handle, char ***arr, bool **avail, VmbUint32_t *narr)
+{
+    return stub_list({"Line0", "Line1"}, arr, avail, narr);
+}
+
+VmbError_t allied_get_image_format_list(AlliedCameraHandle_t handle, char ***arr, bool **avail, VmbUint32_t *narr)
+{
+    return stub_list({"Mono8", "Mono10", "Mono12"}, arr, avail, narr);
+}
+
+VmbError_t allied_get_sensor_bit_depth_list(AlliedCameraHandle_t handle, char ***arr, bool **avail, VmbUint32_t *narr)
+{
+    return stub_list({"Bpp8", "Bpp10", "Bpp12"}, arr, avail, narr);
+}
+
+VmbError_t allied_get_sensor_size(AlliedCameraHandle_t handle, VmbInt64_t *width, VmbInt64_t *height)
+{
+    *width = 1936;
+    *height = 1216;
+    return VmbErrorSuccess;
+}
+
+VmbError_t allied_get_image_size(AlliedCameraHandle_t handle, VmbInt64_t *width, VmbInt64_t *height)
+{
+    *width = stub_camera(handle)->width;
+    *height = stub_camera(handle)->height;
+    return VmbErrorSuccess;
+}
+
+VmbError_t allied_set_image_size(AlliedCameraHandle_t handle, VmbInt64_t width, VmbInt64_t height)
+{
+    stub_camera(handle)->width = width;
+    stub_camera(handle)->height = height;
+    return VmbErrorSuccess;
+}
+
+VmbError_t allied_get_image_ofst(AlliedCameraHandle_t handle, VmbInt64_t *x, VmbInt64_t *y)
+{
+    *x = stub_camera(handle)->ofst_x;
+    *y = stub_camera(handle)->ofst_y;
+    return VmbErrorSuccess;
+}
+
+VmbError_t allied_set_image_ofst(AlliedCameraHandle_t handle, VmbInt64_t x, VmbInt64_t y)
+{
+    stub_camera(handle)->ofst_x = x;
+    stub_camera(handle)->ofst_y = y;
+    return VmbErrorSuccess;
+}
+
+// VmbC: no generic features, no events, no stream module
+VmbError_t VmbFeatureIntGet(const VmbHandle_t handle, const char *name, VmbInt64_t *value)
+{
+    return VmbErrorNotFound;
+}
+
+VmbError_t VmbFeatureIntSet(const VmbHandle_t handle, const char *name, VmbInt64_t value)
+{
+    return VmbErrorNotFound;
+}
+
+VmbError_t VmbFeatureFloatGet(const VmbHandle_t handle, const char *name, double *value)
+{
+    return VmbErrorNotFound;
+}
+
+VmbError_t VmbFeatureFloatSet(const VmbHandle_t handle, const char *name, double value)
+{
+    return VmbErrorNotFound;
+}
+
+VmbError_t VmbFeatureFloatRangeQuery(const VmbHandle_t handle, const char *name, double *vmin, double *vmax)
+{
+    return VmbErrorNotFound;
+}
+
+VmbError_t VmbFeatureBoolGet(const VmbHandle_t handle, const char *name, VmbBool_t *value)
+{
+    return VmbErrorNotFound;
+}
+
+VmbError_t VmbFeatureBoolSet(const VmbHandle_t handle, const char *name, VmbBool_t value)
+{
+    return VmbErrorNotFound;
+}
+
+VmbError_t VmbFeatureEnumGet(const VmbHandle_t handle, const char *name, const char **value)
+{
+    return VmbErrorNotFound;
+}
+
+VmbError_t VmbFeatureEnumSet(const VmbHandle_t handle, const char *name, const char *value)
+{
+    return VmbErrorNotFound;
+}
+
+VmbError_t VmbFeatureStringGet(const VmbHandle_t handle, const char *name, char *buffer, VmbUint32_t size, VmbUint32_t *filled)
+{
+    if (strcmp(name, "DeviceFirmwareVersion") != 0)
+        return VmbErrorNotFound;
+    snprintf(buffer, size, "stub");
+    if (filled != NULL)
+        *filled = (VmbUint32_t)strlen(buffer) + 1;
+    return VmbErrorSuccess;
+}
+
+VmbError_t VmbFeatureStringSet(const VmbHandle_t handle, const char *name, const char *value)
+{
+    return VmbErrorNotFound;
+}
+
+VmbError_t VmbFeatureCommandRun(const VmbHandle_t handle, const char *name)
+{
+    return VmbErrorNotFound;
+}
+
+VmbError_t VmbFeatureCommandIsDone(const VmbHandle_t handle, const char *name, VmbBool_t *done)
+{
+    return VmbErrorNotFound;
+}
+
+VmbError_t VmbFeatureInfoQuery(const VmbHandle_t handle, const char *name, VmbFeatureInfo_t *info, VmbUint32_t size)
+{
+    return VmbErrorNotFound;
+}
+
+VmbError_t VmbFeaturesList(VmbHandle_t handle, VmbFeatureInfo_t *list, VmbUint32_t length, VmbUint32_t *found, VmbUint32_t size)
+{
+    *found = 0;
+    return VmbErrorSuccess;
+}
+
+VmbError_t VmbFeatureInvalidationRegister(VmbHandle_t handle, const char *name, VmbInvalidationCallback callback, void *user)
+{
+    return VmbErrorNotFound;
+}
+
+VmbError_t VmbFeatureInvalidationUnregister(VmbHandle_t handle, const char *name, VmbInvalidationCallback callback)
+{
+    return VmbErrorNotFound;
+}
+
+VmbError_t VmbCameraInfoQueryByHandle(VmbHandle_t handle, VmbCameraInfo_t *info, VmbUint32_t size)
+{
+    return VmbErrorNotFound;
+}
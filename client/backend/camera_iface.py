@@ -2,7 +2,9 @@
 from __future__ import annotations
 import json
 import sys
-from typing import Any, List, Optional
+import time
+import uuid
+from typing import Any, List, Optional, Tuple
 import warnings
 import zmq
 import zmq.utils.monitor as zmonitor
@@ -33,6 +35,10 @@ class Commands(enum.IntEnum):
     """Acquisition framerate auto (bool)"""
     FrameSize = 108,             # int
     """Frame size (int)"""
+    FrameBuffers = 109,          # special
+    """Frame buffers announced, bytes committed, callback latency p50 and p99 in us (special)"""
+    MaxExposureUs = 110,         # special, argument: framerate
+    """Longest exposure in microseconds for a framerate, from the calibrated envelope (special, double)"""
     ImageSize = 200,             # special, two arguments, ints
     """Imae size (special, two arguments, ints)"""
     ImageOfst = 201,             # special, two arguments, ints
@@ -53,10 +59,30 @@ class Commands(enum.IntEnum):
     """Image formats list (special)"""
     SensorBitDepths = 306,       # special
     """Sensor bit depths list (special)"""
+    GigETuning = 307,            # special
+    """GigE tuning report: packet size before, after, NIC, MTU, rmem_max, CPU us per frame, warnings (special)"""
+    HDROutput = 308,             # special
+    """Directory for HDR merged sequence passes, empty disables (string)"""
+    HDRStats = 309,              # special
+    """HDR merged images written, dropped (special)"""
     ADIOBit = 10,                # special
     """ADIO bit (int)"""
+    ADIOMode = 11,               # special
+    """ADIO pulse source, 'frame' or 'exposure' (string)"""
+    ADIOLag = 12,                # special
+    """ADIO frame callback lag behind exposure end: samples, mean us, max us (special)"""
     CaptureMaxLen = 400,         # special, int, time in seconds
     """Maximum capture length (special, int, time in seconds)"""
+    BundleTol = 401,             # special, int, microseconds
+    """Frame set timestamp tolerance in microseconds (special, int)"""
+    BundleStats = 402,           # special
+    """Frame sets published, incomplete sets, dropped frames (special)"""
+    WatchdogPeriods = 403,       # special, int
+    """Frame periods without frames before a stream is restarted, 0 disables (special, int)"""
+    ClockSync = 500,             # special
+    """Camera to host clock model: samples, rejected, offset ns, drift ppm, rms ns (special)"""
+    FrameMeta = 501,             # special
+    """Last frame: frame id, camera ticks, host CLOCK_MONOTONIC_RAW ns, receive ns, sequence step, sequence pass (special)"""
 
 
 class ReturnCodes(enum.IntEnum):
@@ -124,16 +150,55 @@ class Camera:
     pass
 
 
+class FeatureChanges:
+    """Feature change notifications of subscribed features (see Camera.subscribe), pushed by the server on port + 3.
+    """
+
+    def __init__(self, ctx: zmq.Context, host: str, port: int, cam_ids: List[str]):
+        self._cam_ids = set(cam_ids)
+        self._sock: zmq.Socket = ctx.socket(zmq.SUB)
+        self._sock.setsockopt(zmq.LINGER, 0)
+        self._sock.connect(f"tcp://{host}:{port}")
+        for cam_id in self._cam_ids:
+            self._sock.setsockopt(zmq.SUBSCRIBE, f'feature:{cam_id}'.encode('utf-8'))
+
+    def recv(self, timeout_ms: int = 1000) -> Optional[dict]:
+        """Wait for the next change.
+
+        Args:
+            timeout_ms (int, optional): Time to wait. Defaults to 1000.
+
+        Returns:
+            Optional[dict]: seq, cam_id, feature, type, value (as text) and ts_ms, None on timeout.
+        """
+        while self._sock.poll(timeout_ms):
+            _, body = self._sock.recv_multipart()
+            change = json.loads(body)
+            # topics are prefix matched, feature:12 also matches feature:123
+            if change['cam_id'] in self._cam_ids:
+                return change
+        return None
+
+    def close(self):
+        self._sock.close()
+
+
 class CameraConnection:
     """Establish connection to a camera server. Allows for camera enumeration, and property setting/getting.
     """
 
-    def __init__(self, ctx: Optional[zmq.Context] = None, cam_id: Optional[str] = None, host: str = 'localhost', port: int = 5555, quit_on_close: bool = False):
+    def __init__(self, ctx: Optional[zmq.Context] = None, cam_id: Optional[str] = None, host: str = 'localhost', port: int = 5555, quit_on_close: bool = False, retries: int = 3, timeout_ms: int = 1000):
         self._ctx = ctx
         self._cam_id = '' if cam_id is None else cam_id
         self._host = host
         self._port = port
         self._qoc = quit_on_close
+        self._retries = retries
+        self._timeout_ms = timeout_ms
+        # the server caches replies per client identity and request ID, so a
+        # retransmitted request is answered without being run twice
+        self._identity = uuid.uuid4().hex.encode('ascii')
+        self._req_id = 0
         self._packet = {
             'cmd_type': 'list',
             'cam_id': '',
@@ -158,23 +223,31 @@ class CameraConnection:
         if self._opened:
             if self._qoc:
                 self._packet['cmd_type'] = 'quit'
-                self._sock.send(json.dumps(self._packet).encode('utf-8'))
-                _ = self._sock.recv()
+                try:
+                    _ = self._transact(self._packet, self._ctrl_sock)
+                except TimeoutError:
+                    pass
             self._sock.close()
+            self._ctrl_sock.close()
             self._opened = False
 
+    def _socket(self, port: int) -> zmq.Socket:
+        sock: zmq.Socket = self._ctx.socket(zmq.REQ)
+        sock.setsockopt(zmq.RCVTIMEO, self._timeout_ms)
+        sock.setsockopt(zmq.REQ_CORRELATE, 1)
+        sock.setsockopt(zmq.REQ_RELAXED, 1)
+        sock.setsockopt(zmq.LINGER, 0)
+        sock.setsockopt(zmq.ROUTING_ID, self._identity)
+        sock.connect(f"tcp://{self._host}:{port}")
+        return sock
+
     def open(self):
         if self._ctx is None:
             self._ctx = zmq.Context()
-        self._sock: zmq.Socket = self._ctx.socket(zmq.REQ)
-        self._sock.setsockopt(zmq.RCVTIMEO, 1000)
-        self._sock.setsockopt(zmq.REQ_CORRELATE, 1)
-        self._sock.setsockopt(zmq.REQ_RELAXED, 1)
-        self._sock.setsockopt(zmq.LINGER, 0)
-        self._sock.connect(f"tcp://{self._host}:{self._port}")
-        self._sock.send(json.dumps(self._packet).encode('utf-8'))
-        reply = self._sock.recv()
-        packet = json.loads(reply)
+        self._sock = self._socket(self._port)
+        # stop and quit go to the control endpoint, ahead of queued get/set traffic
+        self._ctrl_sock = self._socket(self._port + 2)
+        packet = self._transact(self._packet)
         if packet['retcode'] != ReturnCodes.VmbErrorSuccess:
             raise Exception(
                 f'Command {packet["cmd_type"]}: Error: {packet["retcode"]}')
@@ -184,9 +257,7 @@ class CameraConnection:
             packet['cmd_type'] = 'set'
             packet['command'] = Commands.ADIOBit
             packet['arguments'] = [str(idx)]
-            self._sock.send(json.dumps(packet).encode('utf-8'))
-            reply = self._sock.recv()
-            packet = json.loads(reply)
+            packet = self._transact(packet)
             if packet['retcode'] != ReturnCodes.VmbErrorSuccess:
                 retcode = ReturnCodes(packet['retcode'])
                 command = Commands(packet['command'])
@@ -194,6 +265,37 @@ class CameraConnection:
                     f'Command {packet["cmd_type"]} ({command.name}): Error: {retcode.name}')
         self._opened = True
 
+    def _transact(self, packet: dict, sock: Optional[zmq.Socket] = None) -> dict:
+        """Send a request and wait for its reply, retransmitting on timeout.
+        Retransmits keep the request ID, so the server replies from its cache instead of running the command again.
+        Each attempt carries a deadline, requests still queued on the server past it are dropped unexecuted.
+
+        Args:
+            packet (dict): Request packet, its req_id is set here.
+            sock (Optional[zmq.Socket]): Socket to use, the request socket if None.
+
+        Raises:
+            TimeoutError: No reply after the configured retries.
+
+        Returns:
+            dict: Reply packet.
+        """
+        if sock is None:
+            sock = self._sock
+        self._req_id += 1
+        packet['req_id'] = str(self._req_id)
+        for _ in range(self._retries + 1):
+            packet['deadline'] = int(time.time() * 1e3) + self._timeout_ms
+            sock.send(json.dumps(packet).encode('utf-8'))
+            try:
+                reply = json.loads(sock.recv())
+            except zmq.Again:
+                continue
+            if reply.get('req_id', packet['req_id']) == packet['req_id']:
+                return reply
+        raise TimeoutError(
+            f'Command {packet["cmd_type"]}: no reply after {self._retries + 1} attempts')
+
     @property
     def zmq_context(self) -> zmq.Context:
         return self._ctx
@@ -206,21 +308,72 @@ class CameraConnection:
     def status(self) -> Result[List[str], ReturnCodes]:
         self._packet['cmd_type'] = 'status'
         self._packet['cam_id'] = ''  # for all
-        self._sock.send(json.dumps(self._packet).encode('utf-8'))
-        reply = self._sock.recv()
-        packet = json.loads(reply)
+        packet = self._transact(self._packet)
         if packet['retcode'] != ReturnCodes.VmbErrorSuccess:
             return Err(ReturnCodes(packet['retcode']))
         return Ok(packet['retargs'])
 
+    @property
+    def metrics(self) -> Result[dict, ReturnCodes]:
+        self._packet['cmd_type'] = 'metrics'
+        self._packet['cam_id'] = ''  # for all
+        packet = self._transact(self._packet)
+        if packet['retcode'] != ReturnCodes.VmbErrorSuccess:
+            return Err(ReturnCodes(packet['retcode']))
+        args = packet['retargs']
+        return Ok(dict(zip(args[::2], args[1::2])))
+
+    def feature_changes(self, cam_ids: Optional[List[str]] = None) -> FeatureChanges:
+        """Receive changes of the features subscribed to with Camera.subscribe, without polling the cameras.
+
+        Args:
+            cam_ids (Optional[List[str]], optional): Cameras to listen to, all if None.
+
+        Returns:
+            FeatureChanges: Notification receiver.
+        """
+        return FeatureChanges(self._ctx, self._host, self._port + 3, self._cameras if cam_ids is None else cam_ids)
+
+    def start_capture_all(self, start_at_ms: Optional[int] = None) -> Result[dict, ReturnCodes]:
+        """Start all cameras.
+
+        Args:
+            start_at_ms (Optional[int], optional): Wall clock start time, ms since the epoch; now if None.
+            A coordinator schedules every start, picking a time shortly ahead if None.
+            The reply comes right away; the cameras start at that time.
+
+        Returns:
+            Result[dict, ReturnCodes]: Start time report of a scheduled start (name: value, times in us), empty otherwise.
+            The actual start of each camera is reported as <cam_id>.start_us in metrics.
+        """
+        self._packet['cmd_type'] = 'start_capture_all'
+        self._packet['cam_id'] = ''
+        self._packet['arguments'] = [] if start_at_ms is None else [str(int(start_at_ms))]
+        packet = self._transact(self._packet)
+        if packet['retcode'] != ReturnCodes.VmbErrorSuccess:
+            return Err(ReturnCodes(packet['retcode']))
+        args = packet['retargs']
+        return Ok(dict(zip(args[::2], args[1::2])))
+
+    def stop_capture_all(self) -> Result[None, ReturnCodes]:
+        """Stop all cameras. Sent on the control endpoint, so it does not wait behind queued get/set requests.
+
+        Returns:
+            Result[None, ReturnCodes]: Ok on success, Err on failure.
+        """
+        self._packet['cmd_type'] = 'stop_capture_all'
+        self._packet['cam_id'] = ''
+        packet = self._transact(self._packet, self._ctrl_sock)
+        if packet['retcode'] != ReturnCodes.VmbErrorSuccess:
+            return Err(ReturnCodes(packet['retcode']))
+        return Ok(None)
+
     def set_nocheck(self, camera_id: str, command: Commands, arguments: List[Any]) -> Result[None, ReturnCodes]:
         self._packet['cmd_type'] = 'set'
         self._packet['cam_id'] = camera_id
         self._packet['command'] = command.value
         self._packet['arguments'] = [str(arg) for arg in arguments]
-        self._sock.send(json.dumps(self._packet).encode('utf-8'))
-        reply = self._sock.recv()
-        packet = json.loads(reply)
+        packet = self._transact(self._packet)
         retcode = ReturnCodes(packet['retcode'])
         if retcode != ReturnCodes.VmbErrorSuccess:
             return Err(retcode)
@@ -231,22 +384,20 @@ class CameraConnection:
             return None
         return self.set_nocheck(camera_id, command, arguments)
 
-    def get_nocheck(self, camera_id: str, command: Commands) -> Result[List[str], ReturnCodes]:
+    def get_nocheck(self, camera_id: str, command: Commands, arguments: List[Any] = []) -> Result[List[str], ReturnCodes]:
         self._packet['cmd_type'] = 'get'
         self._packet['cam_id'] = camera_id
         self._packet['command'] = command.value
-        self._packet['arguments'] = []
-        self._sock.send(json.dumps(self._packet).encode('utf-8'))
-        reply = self._sock.recv()
-        packet = json.loads(reply)
+        self._packet['arguments'] = list(map(str, arguments))
+        packet = self._transact(self._packet)
         if packet['retcode'] != ReturnCodes.VmbErrorSuccess:
             return Err(ReturnCodes(packet['retcode']))
         return Ok(packet['retargs'])
 
-    def get(self, camera_id: str, command: Commands) -> Result[List[str], ReturnCodes]:
+    def get(self, camera_id: str, command: Commands, arguments: List[Any] = []) -> Result[List[str], ReturnCodes]:
         if camera_id not in self._cameras:
             return None
-        return self.get_nocheck(camera_id, command)
+        return self.get_nocheck(camera_id, command, arguments)
 
     def get_camera(self, camera_id: str) -> Camera:
         return Camera(self, camera_id)
@@ -264,6 +415,24 @@ class CameraConnection:
         self.set_nocheck(self._cameras[0], Commands.CaptureMaxLen, [
                          value.total_seconds()*1e3])
 
+    @property
+    def bundle_tolerance(self) -> timedelta:
+        """Get the timestamp tolerance used to group frames from different cameras into frame sets.
+        Frame sets are published on port + 1 with topic 'bundle'.
+
+        Returns:
+            timedelta: tolerance
+        """
+        res = self.get_nocheck(self._cameras[0], Commands.BundleTol)
+        if res.is_err():
+            return timedelta(0)
+        return timedelta(microseconds=float(res.unwrap()[0]))
+
+    @bundle_tolerance.setter
+    def bundle_tolerance(self, value: timedelta):
+        self.set_nocheck(self._cameras[0], Commands.BundleTol, [
+                         int(value.total_seconds()*1e6)])
+
 
 class Camera:
     """Camera object for setting/getting camera properties.
@@ -278,18 +447,51 @@ class Camera:
         """Get camera status.
 
         Returns:
-            Result[List[str], ReturnCodes]: Status list or error code.
+            Result[List[str], ReturnCodes]: Status list (capturing, temperature source, temperature, frames dropped, packets missed, packets resent; the stream counters are -1 for cameras without stream statistics) or error code.
         """
         self._parent._packet['cmd_type'] = 'status'
         self._parent._packet['cam_id'] = self._cam_id  # for all
-        self._parent._sock.send(json.dumps(
-            self._parent._packet).encode('utf-8'))
-        reply = self._parent._sock.recv()
-        packet = json.loads(reply)
+        packet = self._parent._transact(self._parent._packet)
         if packet['retcode'] != ReturnCodes.VmbErrorSuccess:
             return Err(ReturnCodes(packet['retcode']))
         return Ok(packet['retargs'])
 
+    @property
+    def metrics(self) -> Result[dict, ReturnCodes]:
+        """Get camera metrics (frames, stalls, recoveries, ...).
+
+        Returns:
+            Result[dict, ReturnCodes]: Metric name to value, or error code.
+        """
+        self._parent._packet['cmd_type'] = 'metrics'
+        self._parent._packet['cam_id'] = self._cam_id
+        packet = self._parent._transact(self._parent._packet)
+        if packet['retcode'] != ReturnCodes.VmbErrorSuccess:
+            return Err(ReturnCodes(packet['retcode']))
+        args = packet['retargs']
+        return Ok(dict(zip(args[::2], args[1::2])))
+
+    def start_capture(self) -> Result[None, ReturnCodes]:
+        self._parent._packet['cmd_type'] = 'start_capture'
+        self._parent._packet['cam_id'] = self._cam_id
+        packet = self._parent._transact(self._parent._packet)
+        if packet['retcode'] != ReturnCodes.VmbErrorSuccess:
+            return Err(ReturnCodes(packet['retcode']))
+        return Ok(None)
+
+    def stop_capture(self) -> Result[None, ReturnCodes]:
+        """Stop capturing. Sent on the control endpoint, so it does not wait behind queued get/set requests.
+
+        Returns:
+            Result[None, ReturnCodes]: Ok on success, Err on failure.
+        """
+        self._parent._packet['cmd_type'] = 'stop_capture'
+        self._parent._packet['cam_id'] = self._cam_id
+        packet = self._parent._transact(self._parent._packet, self._parent._ctrl_sock)
+        if packet['retcode'] != ReturnCodes.VmbErrorSuccess:
+            return Err(ReturnCodes(packet['retcode']))
+        return Ok(None)
+
     def set(self, command: Commands, arguments: List[Any]) -> Result[None, ReturnCodes]:
         """Set a camera property.
 
@@ -302,8 +504,153 @@ class Camera:
         """
         return self._parent.set(self._cam_id, command, arguments)
 
-    def get(self, command: Commands) -> Result[List[str], ReturnCodes]:
-        return self._parent.get(self._cam_id, command)
+    def get(self, command: Commands, arguments: List[Any] = []) -> Result[List[str], ReturnCodes]:
+        return self._parent.get(self._cam_id, command, arguments)
+
+    @property
+    def hdr_output(self) -> str:
+        """Get the directory merged exposure sequence passes are written to
+
+        Returns:
+            str: directory, empty if merging is disabled
+        """
+        res = self.get(Commands.HDROutput)
+        if res.is_err():
+            return ''
+        return res.unwrap()[0]
+
+    @hdr_output.setter
+    def hdr_output(self, value: str):
+        """Merge each pass of an exposure sequence into one radiance image (PFM, counts per microsecond).
+
+        Args:
+            value (str): Output directory on the server, empty to disable.
+        """
+        self.set(Commands.HDROutput, [value])
+
+    def run_sequence(self, steps: List[Tuple[timedelta, int]], repeats: int = 1) -> Result[None, ReturnCodes]:
+        """Start a capture that steps through a list of exposures on the server, frame by frame.
+        The capture stops by itself after the last pass.
+
+        Args:
+            steps (List[Tuple[timedelta, int]]): (exposure, frame count) steps.
+            repeats (int, optional): Passes through the steps, 0 to repeat until stopped. Defaults to 1.
+
+        Returns:
+            Result[None, ReturnCodes]: Ok on success, Err on failure.
+        """
+        self._parent._packet['cmd_type'] = 'sequence'
+        self._parent._packet['cam_id'] = self._cam_id
+        self._parent._packet['arguments'] = [str(repeats)] + [
+            str(x) for exposure, count in steps for x in (exposure.total_seconds()*1e6, count)]
+        packet = self._parent._transact(self._parent._packet)
+        if packet['retcode'] != ReturnCodes.VmbErrorSuccess:
+            return Err(ReturnCodes(packet['retcode']))
+        return Ok(None)
+
+    def reconfigure(self, settings: List[Tuple[Commands, List[Any]]]) -> Result[Tuple[timedelta, bool, int, List[str]], ReturnCodes]:
+        """Apply several settings in one server-side stop/apply/start cycle.
+
+        Args:
+            settings (List[Tuple[Commands, List[Any]]]): (command, arguments) pairs, applied in order.
+
+        Returns:
+            Result[Tuple[timedelta, bool, int, List[str]], ReturnCodes]: Stream downtime, whether frame buffers were reallocated, new frame size and the read-back values, or error code.
+        """
+        self._parent._packet['cmd_type'] = 'reconfigure'
+        self._parent._packet['cam_id'] = self._cam_id
+        self._parent._packet['arguments'] = [
+            str(x) for command, args in settings for x in [command.value] + list(args)]
+        packet = self._parent._transact(self._parent._packet)
+        if packet['retcode'] != ReturnCodes.VmbErrorSuccess:
+            return Err(ReturnCodes(packet['retcode']))
+        args = packet['retargs']
+        return Ok((timedelta(microseconds=int(args[0])), args[1] == 'True', int(args[2]), args[3:]))
+
+    def get_feature(self, name: str) -> Result[Tuple[str, str], ReturnCodes]:
+        """Read any camera or stream feature by its GenICam name.
+
+        Args:
+            name (str): Feature name, e.g. 'Gain'.
+
+        Returns:
+            Result[Tuple[str, str], ReturnCodes]: Feature type ('Int', 'Float', 'Enum', 'String', 'Bool', 'Command', 'Raw') and value as text, or error code.
+        """
+        self._parent._packet['cmd_type'] = 'get_feature'
+        self._parent._packet['cam_id'] = self._cam_id
+        self._parent._packet['arguments'] = [name]
+        packet = self._parent._transact(self._parent._packet)
+        if packet['retcode'] != ReturnCodes.VmbErrorSuccess:
+            return Err(ReturnCodes(packet['retcode']))
+        return Ok((packet['retargs'][0], packet['retargs'][1]))
+
+    def set_feature(self, name: str, value: Any = '') -> Result[Tuple[str, str], ReturnCodes]:
+        """Write any camera or stream feature by its GenICam name. Command features are run.
+
+        Args:
+            name (str): Feature name, e.g. 'Gain'.
+            value (Any): New value, ignored for command features.
+
+        Returns:
+            Result[Tuple[str, str], ReturnCodes]: Feature type and the value read back, or error code.
+        """
+        self._parent._packet['cmd_type'] = 'set_feature'
+        self._parent._packet['cam_id'] = self._cam_id
+        self._parent._packet['arguments'] = [name, str(value)]
+        packet = self._parent._transact(self._parent._packet)
+        if packet['retcode'] != ReturnCodes.VmbErrorSuccess:
+            return Err(ReturnCodes(packet['retcode']))
+        return Ok((packet['retargs'][0], packet['retargs'][1]))
+
+    def subscribe(self, names: List[str] = []) -> Result[List[str], ReturnCodes]:
+        """Watch features for changes, published to CameraConnection.feature_changes receivers.
+        Changes made by the camera itself (e.g. auto exposure), by other clients and by the server are all reported.
+
+        Args:
+            names (List[str], optional): GenICam feature names; exposure, framerate and trigger settings if empty.
+
+        Returns:
+            Result[List[str], ReturnCodes]: All features now watched on this camera, or error code.
+        """
+        self._parent._packet['cmd_type'] = 'subscribe'
+        self._parent._packet['cam_id'] = self._cam_id
+        self._parent._packet['arguments'] = list(names)
+        packet = self._parent._transact(self._parent._packet)
+        if packet['retcode'] != ReturnCodes.VmbErrorSuccess:
+            return Err(ReturnCodes(packet['retcode']))
+        return Ok(packet['retargs'])
+
+    def unsubscribe(self, names: List[str] = []) -> Result[List[str], ReturnCodes]:
+        """Stop watching features.
+
+        Args:
+            names (List[str], optional): GenICam feature names, all if empty.
+
+        Returns:
+            Result[List[str], ReturnCodes]: Features still watched, or error code.
+        """
+        self._parent._packet['cmd_type'] = 'unsubscribe'
+        self._parent._packet['cam_id'] = self._cam_id
+        self._parent._packet['arguments'] = list(names)
+        packet = self._parent._transact(self._parent._packet)
+        if packet['retcode'] != ReturnCodes.VmbErrorSuccess:
+            return Err(ReturnCodes(packet['retcode']))
+        return Ok(packet['retargs'])
+
+    def list_features(self) -> Result[dict, ReturnCodes]:
+        """List the camera and stream features.
+
+        Returns:
+            Result[dict, ReturnCodes]: Feature name to (type, access, unit); access is a combination of 'r' and 'w'.
+        """
+        self._parent._packet['cmd_type'] = 'list_features'
+        self._parent._packet['cam_id'] = self._cam_id
+        self._parent._packet['arguments'] = []
+        packet = self._parent._transact(self._parent._packet)
+        if packet['retcode'] != ReturnCodes.VmbErrorSuccess:
+            return Err(ReturnCodes(packet['retcode']))
+        args = packet['retargs']
+        return Ok({args[i]: (args[i + 1], args[i + 2], args[i + 3]) for i in range(0, len(args) - 3, 4)})
 
     @property
     def sensor_size(self) -> List[int]:
@@ -565,18 +912,80 @@ class Camera:
             return []
         return list(map(int, res.unwrap()))
 
-    def max_exposure(self, retry: int = 50) -> timedelta:
+    @property
+    def adio_mode(self) -> str:
+        """Get the aDIO pulse source
+
+        Returns:
+            str: 'frame' (frame-complete callback) or 'exposure' (exposure events)
+        """
+        res = self.get(Commands.ADIOMode)
+        if res.is_err():
+            return ''
+        return res.unwrap()[0]
+
+    @adio_mode.setter
+    def adio_mode(self, value: str):
+        if value not in ['frame', 'exposure']:
+            raise Exception('Invalid aDIO mode')
+        self.set(Commands.ADIOMode, [value])
+
+    @property
+    def adio_lag(self) -> List[float]:
+        """Get the delay of the frame-complete callback behind the exposure end
+
+        Returns:
+            List[float]: samples, mean delay (us), max delay (us)
+        """
+        res = self.get(Commands.ADIOLag)
+        if res.is_err():
+            return []
+        return list(map(float, res.unwrap()))
+
+    @property
+    def clock_sync(self) -> List[float]:
+        """Get the camera to host clock model
+
+        Returns:
+            List[float]: samples, rejected samples, offset (ns), drift (ppm), rms residual (ns)
+        """
+        res = self.get(Commands.ClockSync)
+        if res.is_err():
+            return []
+        return list(map(float, res.unwrap()))
+
+    @property
+    def frame_meta(self) -> List[int]:
+        """Get the metadata of the last received frame
+
+        Returns:
+            List[int]: frame id, camera timestamp (ticks), host timestamp (ns, CLOCK_MONOTONIC_RAW, -1 if unsynchronized), receive time (ns), exposure sequence step (-1 outside a sequence), sequence pass
+        """
+        res = self.get(Commands.FrameMeta)
+        if res.is_err():
+            return []
+        return list(map(int, res.unwrap()))
+
+    def max_exposure(self, retry: int = 50, framerate: Optional[float] = None) -> timedelta:
         """Get the maximum exposure time for a set framerate.
 
+        The server answers from a calibrated exposure / framerate envelope,
+        swept once per camera configuration and cached on disk. Servers
+        without the envelope are probed by stepping the exposure.
+
         Args:
             retry (int, optional): Number of retries to find the maximum exposure time. Defaults to 50.
+            framerate (float, optional): Target framerate. Defaults to the current framerate.
 
         Returns:
             timedelta: maximum exposure time
         """
+        res = self.get(Commands.MaxExposureUs, [] if framerate is None else [framerate])
+        if res.is_ok():
+            return timedelta(microseconds=float(res.unwrap()[0]))
         auto = self.framerate_auto
 
-        fps_target = fps = self.framerate
+        fps_target = fps = self.framerate if framerate is None else framerate
         exposure_max = timedelta(microseconds=50)
         increment = timedelta(seconds=1/fps) * 0.25
         self.exposure = exposure_max
@@ -0,0 +1,401 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <czmq.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include "server.hpp"
+#include "netpacket.hpp"
+#include "string_format.hpp"
+#include "clocksync.hpp"
+
+/**
+ * @brief Front end that serves the capture server protocol on behalf of
+ * several capture servers (backends).
+ *
+ * Requests with a cam_id go to the backend that owns the camera and the
+ * reply is relayed unchanged: the backend echoes the client envelope.
+ * Requests without one are fanned out to every backend, carrying
+ * ("", fan-out ID) as their envelope, and the replies are merged in
+ * backend order. Feature change notifications of all backends are
+ * republished on one endpoint.
+ *
+ * Used by the process-per-camera supervisor and the cluster coordinator;
+ * they decide which backends are up, answer some requests themselves and
+ * add their own metrics.
+ */
+class Broker
+{
+public:
+    static constexpr int64_t FANOUT_TIMEOUT_MS = 5000;
+    static constexpr int64_t DEADLINE_MARGIN_MS = 50; // partial replies leave before the client's deadline
+
+protected:
+    struct Backend
+    {
+        std::string name;
+        std::string prefix;      // of server wide metrics names, they would collide across backends
+        zsock_t *req = nullptr;  // DEALER to the backend request endpoint
+        zsock_t *ctrl = nullptr; // DEALER to the backend control endpoint
+        int64_t rtt_us = -1;     // of the last fan-out request answered
+        bool reachable = false;  // answered the last fan-out request
+        int64_t last_reply_ms = 0; // zclock_mono(), any reply on either endpoint
+    };
+
+    struct FanOut
+    {
+        void *front = nullptr; // the reply goes back where the request came in, nullptr: the broker asked
+        std::vector<std::string> envelope;
+        NetPacket packet;
+        std::vector<std::vector<std::string>> retargs; // per backend
+        std::vector<int> retcodes;                     // per backend
+        std::vector<int64_t> recv_us;                  // per backend, wall clock
+        std::vector<bool> pending;                     // per backend
+        size_t npending = 0;
+        int retcode = VmbErrorSuccess;
+        int64_t sent_us = 0; // wall clock
+        int64_t expires_ms = 0;
+    };
+
+    std::vector<Backend> backends;
+    std::map<uint32_t, size_t> routes; // camera hash -> backend
+    std::map<uint64_t, FanOut> fanouts;
+    uint64_t fanout_seq = 0;
+    bool quitting = false; // a quit was fanned out
+    zsock_t *pipe = nullptr;
+    zsock_t *ctrl = nullptr;
+    zsock_t *pub = nullptr; // feature changes of all backends
+    zsock_t *sub = nullptr;
+    zpoller_t *poller = nullptr;
+    NetPacketDecoder decoder;
+    NetPacket packet;
+    NetPacket reply; // backend reply being collected
+    std::vector<std::string> frames;
+    std::string txbuf;
+    std::string fanout_buf;
+
+    // one multipart message, false if none is waiting
+    static bool recv_frames(void *sock, std::vector<std::string> &frames)
+    {
+        frames.clear();
+        zmq_msg_t message;
+        zmq_msg_init(&message);
+        while (true)
+        {
+            if (zmq_msg_recv(&message, sock, ZMQ_DONTWAIT) < 0)
+            {
+                zmq_msg_close(&message);
+                return !frames.empty();
+            }
+            frames.emplace_back((const char *)zmq_msg_data(&message), zmq_msg_size(&message));
+            if (!zmq_msg_more(&message))
+                break;
+        }
+        zmq_msg_close(&message);
+        return true;
+    }
+
+    // envelope[0, nenvelope), then payload
+    static void send_frames(void *sock, const std::vector<std::string> &envelope, size_t nenvelope, const std::string &payload)
+    {
+        for (size_t i = 0; i < nenvelope; i++)
+        {
+            zmq_send(sock, envelope[i].data(), envelope[i].size(), ZMQ_SNDMORE);
+        }
+        zmq_send(sock, payload.data(), payload.size(), 0);
+    }
+
+    // answer the request in packet / frames without a backend
+    void reply_direct(void *front, size_t nenvelope, int retcode, const std::vector<std::string> &retargs)
+    {
+        packet.retcode = retcode;
+        encode_netpacket(packet, retargs, txbuf);
+        send_frames(front, frames, nenvelope, txbuf);
+    }
+
+    // false while a backend cannot take requests, e.g. restarting
+    virtual bool backend_up(size_t idx) const
+    {
+        return true;
+    }
+
+    // answer a request without cam_id here instead of fanning it out; true if answered
+    virtual bool serve_local(void *front, size_t nenvelope, CmdType type)
+    {
+        return false;
+    }
+
+    // a request to one fan-out backend, if it differs from the others; true if out was set
+    virtual bool tailor_fanout(size_t idx, const NetPacket &request, NetPacket &out)
+    {
+        return false;
+    }
+
+    // broker wide entries of an all-camera metrics reply
+    virtual void append_metrics(std::vector<std::string> &merged)
+    {
+    }
+
+    // replies of a fan-out request into one argument list
+    virtual void merge(FanOut &f, std::vector<std::string> &merged)
+    {
+        bool metrics = cmd_lookup(f.packet.cmd_type) == CmdType::Metrics;
+        for (size_t i = 0; i < backends.size(); i++)
+        {
+            std::vector<std::string> &args = f.retargs[i];
+            for (size_t j = 0; j < args.size(); j++)
+            {
+                // name, value pairs
+                if (metrics && j % 2 == 0 && args[j].compare(0, 7, "server.") == 0)
+                    merged.push_back(backends[i].prefix + "." + args[j]);
+                else
+                    merged.push_back(std::move(args[j]));
+            }
+        }
+        if (metrics)
+            append_metrics(merged);
+    }
+
+    void connect_backend(const std::string &name, const std::string &prefix, const std::string &host, int port)
+    {
+        Backend b;
+        b.name = name;
+        b.prefix = prefix;
+        b.req = zsock_new_dealer(string_format(">tcp://%s:%d", host.c_str(), port).c_str());
+        b.ctrl = zsock_new_dealer(string_format(">tcp://%s:%d", host.c_str(), port + 2).c_str());
+        assert(b.req && b.ctrl);
+        zsock_connect(sub, "tcp://%s:%d", host.c_str(), port + 3);
+        zpoller_add(poller, b.req);
+        zpoller_add(poller, b.ctrl);
+        backends.push_back(b);
+    }
+
+    // bind the front end endpoints: requests, control, feature changes
+    bool bind(const std::string &endpoint, const std::string &control_endpoint, const std::string &notify_endpoint)
+    {
+        pipe = zsock_new_router(endpoint.c_str());
+        ctrl = zsock_new_router(control_endpoint.c_str());
+        pub = zsock_new_pub(notify_endpoint.c_str());
+        sub = zsock_new(ZMQ_SUB);
+        if (pipe == NULL || ctrl == NULL || pub == NULL || sub == NULL)
+        {
+            ZSYS_ERROR("Could not bind %s, %s, %s.", endpoint.c_str(), control_endpoint.c_str(), notify_endpoint.c_str());
+            return false;
+        }
+        zsock_set_subscribe(sub, "");
+        poller = zpoller_new(pipe, ctrl, sub, NULL);
+        return poller != NULL;
+    }
+
+    void route(void *front, bool control_endpoint)
+    {
+        size_t nenvelope = frames.size() - 1;
+        if (nenvelope == 0)
+            return; // not from a ROUTER peer, nowhere to reply
+        const std::string &payload = frames.back();
+        packet.retargs.clear();
+        if (!decoder.decode(payload.data(), payload.size(), packet))
+        {
+            ZSYS_ERROR("Malformed packet.");
+            reply_direct(front, nenvelope, VmbErrorBadParameter, {});
+            return;
+        }
+        if (packet.cam_id.empty())
+        {
+            CmdType type = cmd_lookup(packet.cmd_type);
+            if (!serve_local(front, nenvelope, type))
+                fan_out(front, frames, nenvelope, packet);
+            return;
+        }
+        auto it = routes.find(atol(packet.cam_id.c_str()));
+        if (it == routes.end())
+        {
+            reply_direct(front, nenvelope, VmbErrorNotFound, {});
+            return;
+        }
+        if (!backend_up(it->second))
+        {
+            // the client retries
+            reply_direct(front, nenvelope, VmbErrorNotAvailable, {});
+            return;
+        }
+        Backend &b = backends[it->second];
+        send_frames(zsock_resolve(control_endpoint ? b.ctrl : b.req), frames, frames.size() - 1, payload);
+    }
+
+    /**
+     * @brief Send a request to every backend that is up.
+     *
+     * @param front Where the merged reply goes, nullptr to only merge it.
+     * @param request Decoded request, kept for the reply.
+     * @param timeout_ms Merge what arrived after this long, at most until
+     * the request's deadline: a late merge reaches nobody.
+     */
+    uint64_t fan_out(void *front, const std::vector<std::string> &envelope, size_t nenvelope, const NetPacket &request, int64_t timeout_ms = FANOUT_TIMEOUT_MS)
+    {
+        uint64_t id = ++fanout_seq;
+        FanOut &f = fanouts[id];
+        f.front = front;
+        f.envelope.assign(envelope.begin(), envelope.begin() + nenvelope);
+        f.packet = request;
+        f.retargs.resize(backends.size());
+        f.retcodes.assign(backends.size(), VmbErrorTimeout);
+        f.recv_us.assign(backends.size(), 0);
+        f.pending.assign(backends.size(), false);
+        f.sent_us = host_realtime_us();
+        if (request.deadline > 0)
+            timeout_ms = std::min<int64_t>(timeout_ms, std::max<int64_t>(0, request.deadline - DEADLINE_MARGIN_MS - zclock_time()));
+        f.expires_ms = zclock_mono() + timeout_ms;
+        bool control = front != nullptr && front == zsock_resolve(ctrl);
+        std::vector<std::string> fanout_envelope = {"", std::to_string(id)};
+        // without req_id: the backends see this broker, not the client, and
+        // must not answer it from their reply cache with another client's reply
+        NetPacket forwarded = request;
+        forwarded.req_id.clear();
+        encode_netpacket(forwarded, std::vector<std::string>(), fanout_buf);
+        NetPacket tailored;
+        std::string tailored_buf;
+        for (size_t i = 0; i < backends.size(); i++)
+        {
+            if (!backend_up(i))
+                continue;
+            const std::string *out = &fanout_buf;
+            if (tailor_fanout(i, forwarded, tailored))
+            {
+                encode_netpacket(tailored, std::vector<std::string>(), tailored_buf);
+                out = &tailored_buf;
+            }
+            send_frames(zsock_resolve(control ? backends[i].ctrl : backends[i].req), fanout_envelope, fanout_envelope.size(), *out);
+            f.pending[i] = true;
+            f.npending++;
+        }
+        if (cmd_lookup(request.cmd_type) == CmdType::Quit)
+        {
+            ZSYS_INFO("Received quit command.");
+            quitting = true;
+        }
+        if (f.npending == 0)
+            finish(id, VmbErrorNotAvailable);
+        return id;
+    }
+
+    // a backend answered a fan-out request
+    void collect(size_t idx)
+    {
+        if (frames.size() != 3)
+            return;
+        auto it = fanouts.find(strtoull(frames[1].c_str(), NULL, 10));
+        if (it == fanouts.end() || !it->second.pending[idx])
+            return; // expired
+        FanOut &f = it->second;
+        int retcode = VmbErrorOther;
+        f.recv_us[idx] = host_realtime_us();
+        if (decoder.decode(frames[2].data(), frames[2].size(), reply, true))
+        {
+            retcode = reply.retcode;
+            f.retargs[idx].swap(reply.retargs);
+        }
+        else
+        {
+            ZSYS_ERROR("%s: malformed reply to %s.", backends[idx].name.c_str(), f.packet.cmd_type.c_str());
+        }
+        f.retcodes[idx] = retcode;
+        if (f.retcode == VmbErrorSuccess)
+            f.retcode = retcode;
+        f.pending[idx] = false;
+        backends[idx].reachable = true;
+        backends[idx].rtt_us = f.recv_us[idx] - f.sent_us;
+        if (--f.npending == 0)
+            finish(it->first, VmbErrorSuccess);
+    }
+
+    // merge the backend replies and answer the client
+    void finish(uint64_t id, int retcode)
+    {
+        FanOut &f = fanouts[id];
+        if (f.retcode == VmbErrorSuccess)
+            f.retcode = retcode;
+        std::vector<std::string> merged;
+        merge(f, merged);
+        if (f.front != nullptr)
+        {
+            f.packet.retcode = f.retcode;
+            encode_netpacket(f.packet, merged, txbuf);
+            send_frames(f.front, f.envelope, f.envelope.size(), txbuf);
+        }
+        fanouts.erase(id);
+    }
+
+    void expire(int64_t now)
+    {
+        for (auto it = fanouts.begin(); it != fanouts.end();)
+        {
+            uint64_t id = (it++)->first;
+            FanOut &f = fanouts[id];
+            if (now < f.expires_ms)
+                continue;
+            for (size_t i = 0; i < backends.size(); i++)
+            {
+                if (!f.pending[i])
+                    continue;
+                ZSYS_WARNING("%s: no reply to %s.", backends[i].name.c_str(), f.packet.cmd_type.c_str());
+                backends[i].reachable = false;
+            }
+            finish(id, VmbErrorTimeout);
+        }
+    }
+
+    /**
+     * @brief Move everything waiting on the front end and the backends.
+     *
+     * Few sockets: they are all read rather than dispatching on the one
+     * that woke the poller.
+     */
+    void relay(int64_t now)
+    {
+        for (size_t i = 0; i < backends.size(); i++)
+        {
+            while (recv_frames(zsock_resolve(backends[i].ctrl), frames))
+            {
+                backends[i].last_reply_ms = now;
+                if (frames[0].empty())
+                    collect(i);
+                else
+                    send_frames(zsock_resolve(ctrl), frames, frames.size() - 1, frames.back());
+            }
+            while (recv_frames(zsock_resolve(backends[i].req), frames))
+            {
+                backends[i].last_reply_ms = now;
+                if (frames[0].empty())
+                    collect(i);
+                else
+                    send_frames(zsock_resolve(pipe), frames, frames.size() - 1, frames.back());
+            }
+        }
+        while (recv_frames(zsock_resolve(ctrl), frames))
+            route(zsock_resolve(ctrl), true);
+        while (recv_frames(zsock_resolve(pipe), frames))
+            route(zsock_resolve(pipe), false);
+        while (recv_frames(zsock_resolve(sub), frames))
+            send_frames(zsock_resolve(pub), frames, frames.size() - 1, frames.back());
+        expire(now);
+    }
+
+public:
+    virtual ~Broker()
+    {
+        zpoller_destroy(&poller);
+        for (Backend &b : backends)
+        {
+            zsock_destroy(&b.req);
+            zsock_destroy(&b.ctrl);
+        }
+        zsock_destroy(&sub);
+        zsock_destroy(&pub);
+        zsock_destroy(&ctrl);
+        zsock_destroy(&pipe);
+    }
+};
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <fstream>
+#include "json.hpp"
+#include "meb_print.h"
+#include "alliedcam.h"
+#include "envelope.hpp"
+
+/**
+ * @brief Option lists of one camera model and firmware. They do not change
+ * while the camera is open, so they are fetched once and shared by every
+ * camera with the same key. The pixel format list depends on the selected
+ * sensor bit depth and is read from the camera instead.
+ */
+class Capabilities
+{
+public:
+    std::string key = "";
+    std::vector<std::string> triglines;
+    std::map<std::string, std::vector<std::string>> trigline_srcs; // by line
+    std::vector<std::string> sensor_bit_depths;
+    // per list fetch result, served as the get return code
+    int32_t triglines_err = VmbErrorSuccess;
+    int32_t trigline_srcs_err = VmbErrorSuccess;
+    int32_t sensor_bit_depths_err = VmbErrorSuccess;
+
+    // read, or known to be absent on this model
+    static bool settled(int32_t err)
+    {
+        return err == VmbErrorSuccess || err == VmbErrorNotFound || err == VmbErrorNotAvailable || err == VmbErrorNotImplemented || err == VmbErrorNotSupported;
+    }
+
+    // no list failed transiently; only complete tables are shared and persisted
+    bool complete() const
+    {
+        return settled(triglines_err) && settled(trigline_srcs_err) && settled(sensor_bit_depths_err);
+    }
+
+    NLOHMANN_DEFINE_TYPE_INTRUSIVE(Capabilities, key, triglines, trigline_srcs, sensor_bit_depths, triglines_err, trigline_srcs_err, sensor_bit_depths_err)
+};
+
+// copy an alliedcam option list, fn is one of the allied_get_*_list functions
+template <typename ListFn>
+static inline VmbError_t fetch_capability_list(ListFn fn, AlliedCameraHandle_t handle, std::vector<std::string> &out)
+{
+    char **arr = nullptr;
+    VmbUint32_t narr = 0;
+    out.clear();
+    VmbError_t err = fn(handle, &arr, NULL, &narr);
+    if (err != VmbErrorSuccess)
+        return err;
+    out.assign(arr, arr + narr);
+    allied_free_list(&arr);
+    return err;
+}
+
+/**
+ * @brief Process wide table of interned capability lists, keyed by
+ * "model|firmware", optionally persisted as JSON.
+ */
+class CapabilityRegistry
+{
+    std::mutex lock;
+    std::map<std::string, std::shared_ptr<const Capabilities>> table;
+    std::string path = "";
+
+    CapabilityRegistry() {}
+
+    void save()
+    {
+        if (path == "")
+            return;
+        nlohmann::json j = nlohmann::json::array();
+        for (auto &entry : table)
+            j.push_back(*entry.second);
+        std::string tmp = path + ".tmp";
+        std::ofstream ofs(tmp);
+        if (!ofs.good())
+            return;
+        ofs << j.dump();
+        ofs.close();
+        rename(tmp.c_str(), path.c_str());
+    }
+
+public:
+    static std::string default_path()
+    {
+        return user_cache_dir() + "/allied_capture_capabilities.json";
+    }
+
+    static CapabilityRegistry &instance()
+    {
+        static CapabilityRegistry registry;
+        return registry;
+    }
+
+    // load previously persisted tables and keep the file updated, empty path disables
+    void set_path(const std::string &path)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        this->path = path;
+        if (path == "")
+            return;
+        std::ifstream ifs(path);
+        if (!ifs.good())
+            return;
+        try
+        {
+            nlohmann::json j = nlohmann::json::parse(ifs);
+            for (auto &item : j)
+            {
+                Capabilities caps = item.get<Capabilities>();
+                if (caps.complete() && !table.count(caps.key))
+                    table[caps.key] = std::make_shared<const Capabilities>(caps);
+            }
+        }
+        catch (const std::exception &e)
+        {
+            dbprintlf("Ignoring capability cache %s: %s", path.c_str(), e.what());
+        }
+    }
+
+    std::shared_ptr<const Capabilities> find(const std::string &key)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        auto it = table.find(key);
+        return it == table.end() ? nullptr : it->second;
+    }
+
+    // returns the existing entry if another camera interned the key first;
+    // an incomplete table is returned unshared and not persisted, so a
+    // transient fetch error is retried rather than served from then on
+    std::shared_ptr<const Capabilities> intern(const Capabilities &caps)
+    {
+        if (!caps.complete())
+            return std::make_shared<const Capabilities>(caps);
+        std::lock_guard<std::mutex> guard(lock);
+        auto it = table.find(caps.key);
+        if (it != table.end())
+            return it->second;
+        std::shared_ptr<const Capabilities> entry = std::make_shared<const Capabilities>(caps);
+        table[caps.key] = entry;
+        save();
+        return entry;
+    }
+};
@@ -0,0 +1,108 @@
+/**
+ * @file capture_api.h
+ * @brief C API of the capture library: the camera manager of the capture
+ * server, embedded in process. Commands are the ones the server accepts
+ * over ZMQ (cmd_type, command and arguments as text), minus the transport.
+ *
+ * Functions return VmbError_t codes (0 on success). A manager is not thread
+ * safe; call it from one thread. Frame callbacks run on the Vimba frame
+ * thread of their camera.
+ *
+ */
+
+#ifndef CAPTURE_API_H
+#define CAPTURE_API_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    typedef struct capture_manager capture_manager_t;
+
+    /**
+     * @brief One received frame. buffer is only valid during the callback.
+     */
+    typedef struct
+    {
+        const void *buffer;    // image data
+        uint32_t size;         // bytes
+        uint32_t width;
+        uint32_t height;
+        uint32_t pixel_format; // VmbPixelFormat_t
+        int32_t status;        // VmbFrameStatus_t
+        uint64_t frame_id;
+        uint64_t cam_ts;       // camera timestamp, ticks
+        int64_t host_ts_ns;    // camera timestamp in host CLOCK_MONOTONIC_RAW, -1 if not synchronized
+        int64_t recv_ts_ns;    // host CLOCK_MONOTONIC_RAW at frame callback
+        int32_t seq_step;      // exposure sequence step, -1 outside a sequence
+        uint32_t seq_pass;     // exposure sequence pass
+        double exposure_us;    // commanded exposure of the sequence step
+    } capture_frame_t;
+
+    typedef void (*capture_frame_cb_t)(uint32_t cam_id, const capture_frame_t *frame, void *user);
+
+    capture_manager_t *capture_manager_new(void);
+    void capture_manager_free(capture_manager_t *mgr);
+
+    /**
+     * @brief Initialize Vimba and aDIO and open the cameras.
+     *
+     * @param camera_id Open only cameras whose ID or serial number matches this fnmatch pattern, NULL or "" for all.
+     * @param adio_minor aDIO minor device number, negative to run without aDIO.
+     */
+    int32_t capture_manager_open(capture_manager_t *mgr, const char *camera_id, int adio_minor);
+    void capture_manager_close(capture_manager_t *mgr);
+
+    /**
+     * @brief IDs of the open cameras.
+     *
+     * @param ids Output, may be NULL to query the count.
+     * @param max Capacity of ids.
+     * @param count Number of open cameras.
+     */
+    int32_t capture_manager_cameras(capture_manager_t *mgr, uint32_t *ids, size_t max, size_t *count);
+
+    /**
+     * @brief Run a command, e.g. ("get", cam_id, 105, NULL, 0) for the exposure.
+     * cam_id 0 addresses all cameras where the command allows it.
+     * Return arguments are read with capture_manager_reply_count and
+     * capture_manager_reply until the next command.
+     */
+    int32_t capture_manager_command(capture_manager_t *mgr, const char *cmd_type, uint32_t cam_id, int command, const char *const *args, size_t nargs);
+    size_t capture_manager_reply_count(const capture_manager_t *mgr);
+
+    /**
+     * @brief Copy a return argument, NUL terminated.
+     *
+     * @return int32_t VmbErrorMoreData if it was truncated to len - 1, VmbErrorBadParameter if idx is out of range.
+     */
+    int32_t capture_manager_reply(const capture_manager_t *mgr, size_t idx, char *buf, size_t len);
+
+    // capture time limit, watchdog and sequence bookkeeping; call every few hundred ms
+    // and by capture_manager_poll_timeout, which also starts scheduled captures
+    void capture_manager_poll(capture_manager_t *mgr);
+
+    // ms until capture_manager_poll is due, at most max_ms; short ahead of a scheduled start_capture_all
+    int64_t capture_manager_poll_timeout(const capture_manager_t *mgr, int64_t max_ms);
+
+    // true once a quit command was run
+    int capture_manager_quit_requested(const capture_manager_t *mgr);
+
+    /**
+     * @brief Call cb for every frame of a camera, NULL to remove.
+     *
+     * cb runs on the camera's frame thread. Once this returns, no call of
+     * the previous callback is still running and none will start, so its
+     * user data may be freed. Do not call it from inside cb.
+     */
+    int32_t capture_manager_set_frame_callback(capture_manager_t *mgr, uint32_t cam_id, capture_frame_cb_t cb, void *user);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CAPTURE_API_H
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <functional>
+#include "server.hpp"
+#include "imagecam.hpp"
+#include "replyarena.hpp"
+#include "serverconfig.hpp"
+#include "capture_api.h"
+
+class FrameBundler;
+class FeatureNotifier;
+
+// state shared by the command handlers
+struct CaptureState
+{
+    std::vector<uint32_t> camids;
+    std::map<uint32_t, CameraInfo> caminfos;
+    std::map<uint32_t, ImageCam *> imagecams;
+    // Capture time limit
+    int64_t capture_timelim = 5000; // milliseconds
+    // Exposure / frame rate envelopes, calibrated once per configuration
+    EnvelopeCache envelopes;
+    // Stall watchdog, in frame periods, 0 to disable
+    int watchdog_periods = 5;
+    // Frame set bundling, only meaningful with more than one camera
+    FrameBundler *bundler = nullptr;
+    // Feature change notifications
+    FeatureNotifier *notifier = nullptr;
+    // Return arguments of the current request, reused across requests
+    ReplyArena reply;
+    // Pending start_capture_all, wall clock us, 0 if none
+    int64_t start_at_us = 0;
+    // Set by the quit command
+    bool quit = false;
+    DeviceHandle adio_dev = nullptr;
+    // Appends host wide entries to an all-camera metrics reply
+    std::function<void(ReplyArena &)> metrics_hook;
+};
+
+/**
+ * @brief The cameras of one host and the commands the capture server runs
+ * on them, without the transport.
+ *
+ * The server wraps it in ZMQ; other programs embed it directly, through
+ * this class or the C API in capture_api.h. Not thread safe: open, execute
+ * and poll must be called from one thread.
+ */
+class CaptureManager
+{
+    CaptureState state;
+    bool api_open = false;
+    // Stream statistics poll interval
+    static constexpr int64_t stats_interval = 1000; // milliseconds
+    int64_t stats_last = 0;
+
+public:
+    CaptureManager() = default;
+    CaptureManager(const CaptureManager &) = delete;
+    CaptureManager &operator=(const CaptureManager &) = delete;
+
+    ~CaptureManager()
+    {
+        close();
+    }
+
+    /**
+     * @brief Initialize Vimba and aDIO and open the cameras.
+     *
+     * Uses the camera patterns, aDIO minor and bit map and buffer budget
+     * of config; a worker leaves the aDIO port setup to its supervisor.
+     *
+     * @return VmbError_t VmbErrorNotFound if no camera is connected.
+     */
+    VmbError_t open(const ServerConfig &config);
+
+    // port 0 as output, all bits low
+    static void reset_adio_port(DeviceHandle adio_dev);
+
+    // stop and release the cameras, aDIO and the publishers
+    void close();
+
+    // IDs (hashes of the camera ID strings) of the open cameras
+    std::vector<uint32_t> camera_ids() const;
+
+    // nullptr if not open
+    ImageCam *camera(uint32_t cam_id);
+
+    /**
+     * @brief Run one request. Return arguments are in reply() until the next
+     * call; packet.retcode is not touched.
+     */
+    VmbError_t execute(NetPacket &packet);
+
+    const ReplyArena &reply() const
+    {
+        return state.reply;
+    }
+
+    /**
+     * @brief Stream statistics, stall watchdog, exposure sequence and capture
+     * time limit bookkeeping.
+     *
+     * @param now_ms zclock_mono()
+     */
+    void poll(int64_t now_ms);
+
+    // longest wait until poll is due, at most max_ms; shorter ahead of a scheduled start
+    // and while an exposure sequence runs
+    int64_t poll_timeout(int64_t max_ms) const;
+
+    bool quit_requested() const
+    {
+        return state.quit;
+    }
+
+    // publish frame sets on endpoint, only with more than one camera open
+    void enable_bundling(const std::string &endpoint);
+
+    // publish changes of subscribed features on endpoint
+    void enable_notifications(const std::string &endpoint);
+
+    // cb runs on the frame thread of the camera, nullptr to remove
+    VmbError_t set_frame_callback(uint32_t cam_id, capture_frame_cb_t cb, void *user);
+
+    void set_metrics_hook(std::function<void(ReplyArena &)> hook)
+    {
+        state.metrics_hook = std::move(hook);
+    }
+};
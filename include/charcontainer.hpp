@@ -0,0 +1,82 @@
+#pragma once
+
+#include <stddef.h>
+#include <string.h>
+
+class CharContainer
+{
+private:
+    char *strdup(const char *str)
+    {
+        int len = strlen(str);
+        char *out = new char[len + 1];
+        strcpy(out, str);
+        return out;
+    }
+
+public:
+    char **arr = nullptr;
+    int narr = 0;
+    int selected;
+    size_t maxlen = 0;
+
+    ~CharContainer()
+    {
+        if (arr)
+        {
+            for (int i = 0; i < narr; i++)
+            {
+                delete[] arr[i];
+            }
+            delete[] arr;
+        }
+    }
+
+    CharContainer()
+    {
+        arr = nullptr;
+        narr = 0;
+        selected = -1;
+    }
+
+    CharContainer(const char **arr, int narr)
+    {
+        this->arr = new char *[narr];
+        this->narr = narr;
+        this->selected = -1;
+        for (int i = 0; i < narr; i++)
+        {
+            this->arr[i] = strdup(arr[i]);
+            if (strlen(arr[i]) > maxlen)
+            {
+                maxlen = strlen(arr[i]);
+            }
+        }
+    }
+
+    CharContainer(const char **arr, int narr, const char *key)
+    {
+        this->arr = new char *[narr];
+        this->narr = narr;
+        for (int i = 0; i < narr; i++)
+        {
+            this->arr[i] = strdup(arr[i]);
+            if (strlen(arr[i]) > maxlen)
+            {
+                maxlen = strlen(arr[i]);
+            }
+        }
+        this->selected = find_idx(key);
+    }
+
+    int find_idx(const char *str)
+    {
+        int res = -1;
+        for (int i = 0; i < narr; i++)
+        {
+            if (strcmp(arr[i], str) == 0)
+                res = i;
+        }
+        return res;
+    }
+};
@@ -0,0 +1,205 @@
+#pragma once
+
+#include <stdint.h>
+#include <time.h>
+#include <math.h>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+
+static inline int64_t host_mono_raw_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// wall clock, comparable across hosts to the extent their clocks are synchronized
+static inline int64_t host_realtime_us()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+/**
+ * @brief Maps camera timestamps to the host CLOCK_MONOTONIC_RAW domain.
+ *
+ * Fed with (camera ticks, host ns, round trip ns) latch samples. Keeps a
+ * window of recent samples and fits host = host_ref + slope * (cam - cam_ref)
+ * by least squares weighted by the latch round trip. Samples with an
+ * unusually long round trip or a residual beyond 3 MAD are rejected before
+ * the final fit.
+ */
+class ClockSync
+{
+    struct Sample
+    {
+        int64_t cam;
+        int64_t host;
+        int64_t rtt;
+    };
+
+    static const size_t WINDOW = 32;
+
+    mutable std::mutex lock;
+    std::vector<Sample> samples;
+    size_t next = 0;
+    double nominal_slope = 1.0; // ns per tick
+    // model
+    bool valid = false;
+    int64_t cam_ref = 0;
+    int64_t host_ref = 0;
+    double slope = 1.0;
+    double residual_ns = 0;
+    uint64_t accepted = 0;
+    uint64_t rejected = 0;
+
+    bool fit(const std::vector<const Sample *> &used, int64_t &cref, int64_t &href, double &m) const
+    {
+        if (used.size() < 2)
+            return false;
+        double sw = 0, sx = 0, sy = 0;
+        int64_t c0 = used[0]->cam, h0 = used[0]->host;
+        for (auto s : used)
+        {
+            double w = 1.0 / ((double)s->rtt * s->rtt + 1.0);
+            sw += w;
+            sx += w * (double)(s->cam - c0);
+            sy += w * (double)(s->host - h0);
+        }
+        double mx = sx / sw, my = sy / sw;
+        double sxx = 0, sxy = 0;
+        for (auto s : used)
+        {
+            double w = 1.0 / ((double)s->rtt * s->rtt + 1.0);
+            double dx = (double)(s->cam - c0) - mx;
+            double dy = (double)(s->host - h0) - my;
+            sxx += w * dx * dx;
+            sxy += w * dx * dy;
+        }
+        if (sxx <= 0)
+            return false;
+        m = sxy / sxx;
+        cref = c0 + (int64_t)llround(mx);
+        href = h0 + (int64_t)llround(my - m * (mx - llround(mx)));
+        return true;
+    }
+
+public:
+    ClockSync()
+    {
+        samples.reserve(WINDOW);
+    }
+
+    void reset(double tick_ns = 1.0)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        samples.clear();
+        next = 0;
+        nominal_slope = tick_ns;
+        valid = false;
+        slope = tick_ns;
+        residual_ns = 0;
+        accepted = rejected = 0;
+    }
+
+    void add_sample(int64_t cam_ticks, int64_t host_ns, int64_t rtt_ns)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        Sample s = {cam_ticks, host_ns, rtt_ns};
+        if (samples.size() < WINDOW)
+            samples.push_back(s);
+        else
+            samples[next] = s;
+        next = (next + 1) % WINDOW;
+
+        // gate on round trip: latches that took much longer than the best are suspect
+        int64_t min_rtt = INT64_MAX;
+        for (auto &x : samples)
+            min_rtt = std::min(min_rtt, x.rtt);
+        std::vector<const Sample *> used;
+        used.reserve(samples.size());
+        for (auto &x : samples)
+            if (x.rtt <= 2 * min_rtt + 20000)
+                used.push_back(&x);
+
+        int64_t cref, href;
+        double m;
+        if (!fit(used, cref, href, m))
+        {
+            if (!valid) // single sample, use nominal rate
+            {
+                cam_ref = cam_ticks;
+                host_ref = host_ns;
+                slope = nominal_slope;
+                valid = true;
+            }
+            return;
+        }
+        // residual based outlier rejection
+        std::vector<double> res;
+        res.reserve(used.size());
+        for (auto s : used)
+            res.push_back(fabs((double)(s->host - href) - m * (double)(s->cam - cref)));
+        std::vector<double> sorted = res;
+        std::nth_element(sorted.begin(), sorted.begin() + sorted.size() / 2, sorted.end());
+        double mad = sorted[sorted.size() / 2] * 1.4826 + 1.0;
+        const Sample *newest = &samples[(next + WINDOW - 1) % WINDOW];
+        bool inlier = false;
+        std::vector<const Sample *> inliers;
+        inliers.reserve(used.size());
+        for (size_t i = 0; i < used.size(); i++)
+        {
+            if (res[i] <= 3 * mad)
+            {
+                inliers.push_back(used[i]);
+                inlier |= used[i] == newest;
+            }
+        }
+        if (inlier)
+            accepted++;
+        else
+            rejected++;
+        if (fit(inliers, cref, href, m))
+        {
+            double ss = 0;
+            for (auto s : inliers)
+            {
+                double r = (double)(s->host - href) - m * (double)(s->cam - cref);
+                ss += r * r;
+            }
+            cam_ref = cref;
+            host_ref = href;
+            slope = m;
+            residual_ns = sqrt(ss / inliers.size());
+            valid = true;
+        }
+    }
+
+    bool ready() const
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        return valid;
+    }
+
+    // host CLOCK_MONOTONIC_RAW ns for a camera timestamp, -1 if no model yet
+    int64_t to_host_ns(uint64_t cam_ticks) const
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (!valid)
+            return -1;
+        return host_ref + (int64_t)llround(slope * (double)((int64_t)cam_ticks - cam_ref));
+    }
+
+    // samples in window, rejected latches, offset (ns, host - cam at cam = 0), drift (ppm vs nominal), rms residual (ns)
+    void get_model(size_t &nsamples, uint64_t &nrejected, double &offset_ns, double &drift_ppm, double &rms_ns) const
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        nsamples = samples.size();
+        nrejected = rejected;
+        offset_ns = (double)host_ref - slope * (double)cam_ref;
+        drift_ppm = (slope / nominal_slope - 1.0) * 1e6;
+        rms_ns = residual_ns;
+    }
+};
@@ -0,0 +1,315 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <czmq.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include "server.hpp"
+#include "broker.hpp"
+#include "string_format.hpp"
+
+/**
+ * @brief One front end for the capture servers of several hosts.
+ *
+ * Clients use it like a single capture server. Cameras are routed to the
+ * server that has them open, learned from status replies; list, status and
+ * metrics cover the whole cluster. start_capture_all is scheduled: every
+ * server starts at the same time in the coordinator clock, sent to each in
+ * its own clock using the offset measured by the route refresh. The reply
+ * reports the scheduled starts; the cameras' actual starts and their skew
+ * are in the metrics once they ran.
+ */
+class Coordinator : public Broker
+{
+public:
+    static constexpr int64_t ROUTE_REFRESH_MS = 2000;
+    static constexpr int64_t START_LEAD_MS = 500; // default, from the request to the start
+    static constexpr size_t STATUS_FIELDS = 8;    // per camera in an all-camera status reply
+
+private:
+    struct Server
+    {
+        std::string host;
+        int port;
+        int64_t offset_us = 0; // server clock - coordinator clock, by backend index
+        bool offset_known = false;
+    };
+
+    std::vector<Server> servers;
+    bool probing = false;     // route refresh, sent to unreachable servers too
+    uint64_t refresh_id = 0;  // pending route refresh
+    uint64_t clock_id = 0;    // pending clock offset refresh
+    int64_t refresh_last = 0; // zclock_mono()
+    int64_t start_skew_us = -1; // of the camera starts in the last metrics
+
+    bool backend_up(size_t idx) const override
+    {
+        return probing || backends[idx].reachable;
+    }
+
+    bool serve_local(void *front, size_t nenvelope, CmdType type) override
+    {
+        if (type == CmdType::List)
+        {
+            // cameras open on some server, rather than every camera each host can see
+            std::vector<std::string> list;
+            for (auto &route : routes)
+                list.push_back(std::to_string(route.first));
+            reply_direct(front, nenvelope, VmbErrorSuccess, list);
+            return true;
+        }
+        if (type == CmdType::StartCaptureAll)
+        {
+            // optional argument: start time, ms since the epoch; tailor_fanout
+            // converts it to each server's clock
+            NetPacket request = packet;
+            int64_t start_ms = request.arguments.size() > 0 ? atoll(request.arguments[0].c_str()) : 0;
+            if (start_ms <= 0)
+                start_ms = zclock_time() + START_LEAD_MS;
+            request.arguments.assign(1, std::to_string(start_ms));
+            fan_out(front, frames, nenvelope, request);
+            return true;
+        }
+        return false;
+    }
+
+    bool tailor_fanout(size_t idx, const NetPacket &request, NetPacket &out) override
+    {
+        if (cmd_lookup(request.cmd_type) != CmdType::StartCaptureAll || !servers[idx].offset_known)
+            return false;
+        out = request;
+        int64_t start_us = atoll(request.arguments[0].c_str()) * 1000 + servers[idx].offset_us;
+        out.arguments[0] = string_format("%.3f", start_us / 1000.0);
+        return true;
+    }
+
+    void append_metrics(std::vector<std::string> &merged) override
+    {
+        merged.push_back("coordinator.start_skew_us");
+        merged.push_back(std::to_string(start_skew_us));
+        for (size_t i = 0; i < backends.size(); i++)
+        {
+            Backend &b = backends[i];
+            std::string prefix = "coordinator." + b.name + ".";
+            size_t ncameras = 0;
+            for (auto &route : routes)
+            {
+                if (backends[route.second].name == b.name)
+                    ncameras++;
+            }
+            merged.push_back(prefix + "reachable");
+            merged.push_back(b.reachable ? "True" : "False");
+            merged.push_back(prefix + "rtt_us");
+            merged.push_back(std::to_string(b.rtt_us));
+            merged.push_back(prefix + "cameras");
+            merged.push_back(std::to_string(ncameras));
+            merged.push_back(prefix + "offset_us");
+            merged.push_back(servers[i].offset_known ? std::to_string(servers[i].offset_us) : "None");
+        }
+    }
+
+    static bool ends_with(const std::string &str, const char *suffix)
+    {
+        size_t len = strlen(suffix);
+        return str.size() >= len && str.compare(str.size() - len, len, suffix) == 0;
+    }
+
+    /**
+     * @brief Server clock offsets from an all-camera metrics reply, and the
+     * skew of the camera starts it reports.
+     *
+     * Each server's offset is estimated from the request's round trip, as
+     * NTP does: ((t1 - t0) + (t2 - t3)) / 2, with t0, t3 the send and
+     * receive times here and t1 = t2 the server's clock in the reply.
+     */
+    void update_clocks(FanOut &f)
+    {
+        int64_t first = 0, last = 0;
+        size_t nstarts = 0;
+        for (size_t i = 0; i < backends.size(); i++)
+        {
+            if (f.pending[i] || f.retcodes[i] != VmbErrorSuccess)
+                continue;
+            std::vector<std::string> &args = f.retargs[i];
+            for (size_t j = 0; j + 1 < args.size(); j += 2)
+            {
+                // behind a supervisor, prefixed with the worker
+                if (ends_with(args[j], "server.clock_us"))
+                {
+                    int64_t t1 = atoll(args[j + 1].c_str());
+                    servers[i].offset_us = ((t1 - f.sent_us) + (t1 - f.recv_us[i])) / 2;
+                    servers[i].offset_known = true;
+                    break;
+                }
+            }
+            for (size_t j = 0; j + 1 < args.size(); j += 2)
+            {
+                int64_t start = atoll(args[j + 1].c_str());
+                if (!ends_with(args[j], ".start_us") || start < 0)
+                    continue;
+                start -= servers[i].offset_us;
+                if (nstarts == 0 || start < first)
+                    first = start;
+                if (nstarts == 0 || start > last)
+                    last = start;
+                nstarts++;
+            }
+        }
+        if (nstarts > 0)
+            start_skew_us = last - first;
+    }
+
+    // cameras open on the servers that answered an all-camera status
+    void update_routes(FanOut &f)
+    {
+        for (size_t i = 0; i < backends.size(); i++)
+        {
+            if (f.pending[i] || f.retcodes[i] != VmbErrorSuccess)
+                continue; // keep what is known of servers that did not answer
+            for (auto it = routes.begin(); it != routes.end();)
+            {
+                if (it->second == i)
+                    it = routes.erase(it);
+                else
+                    it++;
+            }
+            std::vector<std::string> &args = f.retargs[i];
+            for (size_t j = 0; j + STATUS_FIELDS <= args.size(); j += STATUS_FIELDS)
+            {
+                uint32_t hash = strtoul(args[j].c_str(), NULL, 10);
+                auto route = routes.find(hash);
+                if (route != routes.end() && route->second != i)
+                    ZSYS_WARNING("Camera %s is open on %s and %s.", args[j + 1].c_str(), backends[route->second].name.c_str(), backends[i].name.c_str());
+                routes[hash] = i;
+            }
+        }
+    }
+
+    /**
+     * @brief Scheduled starts in the coordinator clock and their skew.
+     *
+     * The reply's handler entry and exit, t1 and t2, give a fresh offset
+     * estimate as in update_clocks; a server whose start was already due
+     * reports the start of each camera instead of start_at_us.
+     */
+    void merge_start(FanOut &f, std::vector<std::string> &merged)
+    {
+        int64_t target_us = atoll(f.packet.arguments[0].c_str()) * 1000;
+        std::vector<std::pair<std::string, int64_t>> starts;
+        std::vector<std::string> servers_merged;
+        for (size_t i = 0; i < backends.size(); i++)
+        {
+            std::vector<std::string> &args = f.retargs[i];
+            std::map<std::string, int64_t> values;
+            for (size_t j = 0; j + 1 < args.size(); j += 2)
+                values[args[j]] = atoll(args[j + 1].c_str());
+            if (f.pending[i] || values.count("entry_us") == 0 || values.count("exit_us") == 0)
+                continue;
+            int64_t t0 = f.sent_us, t1 = values["entry_us"], t2 = values["exit_us"], t3 = f.recv_us[i];
+            int64_t offset = ((t1 - t0) + (t2 - t3)) / 2;
+            int64_t delay = (t3 - t0) - (t2 - t1);
+            values.erase("entry_us");
+            values.erase("exit_us");
+            for (auto &value : values)
+                starts.emplace_back(value.first == "start_at_us" ? backends[i].name + ".start_at_us" : value.first, value.second - offset);
+            servers[i].offset_us = offset;
+            servers[i].offset_known = true;
+            servers_merged.push_back(backends[i].name + ".offset_us");
+            servers_merged.push_back(std::to_string(offset));
+            servers_merged.push_back(backends[i].name + ".delay_us");
+            servers_merged.push_back(std::to_string(delay));
+        }
+        int64_t first = 0, last = 0;
+        for (size_t i = 0; i < starts.size(); i++)
+        {
+            if (i == 0 || starts[i].second < first)
+                first = starts[i].second;
+            if (i == 0 || starts[i].second > last)
+                last = starts[i].second;
+        }
+        merged.push_back("skew_us");
+        merged.push_back(std::to_string(last - first));
+        merged.push_back("target_us");
+        merged.push_back(std::to_string(target_us));
+        for (auto &start : starts)
+        {
+            merged.push_back(start.first); // <server>.start_at_us or <hash>.start_us
+            merged.push_back(std::to_string(start.second));
+        }
+        merged.insert(merged.end(), servers_merged.begin(), servers_merged.end());
+        ZSYS_INFO("start_capture_all: %lu starts, skew %ld us.", starts.size(), last - first);
+    }
+
+    void merge(FanOut &f, std::vector<std::string> &merged) override
+    {
+        CmdType type = cmd_lookup(f.packet.cmd_type);
+        if (type == CmdType::Status)
+            update_routes(f);
+        if (type == CmdType::Metrics && f.packet.cam_id.empty())
+            update_clocks(f);
+        if (type == CmdType::StartCaptureAll)
+            merge_start(f, merged);
+        else
+            Broker::merge(f, merged);
+    }
+
+    void refresh_routes(int64_t now)
+    {
+        if (fanouts.count(refresh_id) || fanouts.count(clock_id) || now - refresh_last < ROUTE_REFRESH_MS)
+            return;
+        refresh_last = now;
+        NetPacket request;
+        request.cmd_type = "status";
+        request.cam_id = "";
+        probing = true;
+        refresh_id = fan_out(nullptr, {}, 0, request);
+        // the clock offsets scheduled starts are sent with
+        request.cmd_type = "metrics";
+        clock_id = fan_out(nullptr, {}, 0, request);
+        probing = false;
+    }
+
+public:
+    /**
+     * @param servers host:port of the capture servers.
+     */
+    Coordinator(const std::vector<std::string> &servers)
+    {
+        for (const std::string &server : servers)
+        {
+            size_t colon = server.rfind(':');
+            Server s;
+            s.host = colon == std::string::npos ? server : server.substr(0, colon);
+            s.port = colon == std::string::npos ? 5555 : atoi(server.c_str() + colon + 1);
+            this->servers.push_back(s);
+        }
+    }
+
+    int run(int port)
+    {
+        if (!bind(string_format("tcp://*:%d", port), string_format("tcp://*:%d", port + 2), string_format("tcp://*:%d", port + 3)))
+            return 1;
+        for (Server &s : servers)
+        {
+            std::string name = string_format("%s:%d", s.host.c_str(), s.port);
+            connect_backend(name, name, s.host, s.port);
+        }
+        ZSYS_INFO("Coordinating %lu servers on port %d.", servers.size(), port);
+        while (!zsys_interrupted && !(quitting && fanouts.empty()))
+        {
+            zpoller_wait(poller, 100);
+            int64_t now = zclock_mono();
+            refresh_routes(now);
+            relay(now);
+        }
+        if (zsys_interrupted)
+        {
+            ZSYS_INFO("Received SIGINT.");
+        }
+        return 0;
+    }
+};
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <fstream>
+#include "json.hpp"
+#include "meb_print.h"
+
+// $XDG_CACHE_HOME or ~/.cache, created if missing
+static inline std::string user_cache_dir()
+{
+    const char *base = getenv("XDG_CACHE_HOME");
+    std::string dir = base != NULL ? base : std::string(getenv("HOME") != NULL ? getenv("HOME") : "/tmp") + "/.cache";
+    mkdir(dir.c_str(), 0755);
+    return dir;
+}
+
+/**
+ * @brief Exposure / frame rate envelope of one camera configuration.
+ *
+ * Sampled as (exposure, shortest frame period) pairs, sorted by exposure.
+ * The frame period is piecewise linear in the exposure (readout bound, then
+ * exposure bound), so linear interpolation between samples is accurate.
+ */
+class Envelope
+{
+public:
+    std::vector<double> exposure_us;
+    std::vector<double> period_us;
+
+    /**
+     * @brief Longest exposure that still allows the given frame rate.
+     *
+     * @return double Exposure in us, -1 if the frame rate is not reachable at all.
+     */
+    double max_exposure_at(double fps) const
+    {
+        if (exposure_us.empty() || fps <= 0)
+            return -1;
+        double period = 1e6 / fps;
+        if (period < period_us.front())
+            return -1;
+        if (period >= period_us.back())
+            return exposure_us.back();
+        for (size_t i = 1; i < period_us.size(); i++)
+        {
+            if (period_us[i] > period)
+            {
+                double dp = period_us[i] - period_us[i - 1];
+                if (dp <= 0)
+                    return exposure_us[i - 1];
+                double f = (period - period_us[i - 1]) / dp;
+                return exposure_us[i - 1] + f * (exposure_us[i] - exposure_us[i - 1]);
+            }
+        }
+        return exposure_us.back();
+    }
+
+    NLOHMANN_DEFINE_TYPE_INTRUSIVE(Envelope, exposure_us, period_us)
+};
+
+/**
+ * @brief Envelopes keyed by camera configuration, persisted as JSON.
+ */
+class EnvelopeCache
+{
+    std::map<std::string, Envelope> table;
+    std::string path;
+
+public:
+    static std::string default_path()
+    {
+        return user_cache_dir() + "/allied_capture_envelopes.json";
+    }
+
+    EnvelopeCache(const std::string &path = default_path())
+    {
+        this->path = path;
+        std::ifstream ifs(path);
+        if (!ifs.good())
+            return;
+        try
+        {
+            nlohmann::json j = nlohmann::json::parse(ifs);
+            table = j.get<std::map<std::string, Envelope>>();
+        }
+        catch (const std::exception &e)
+        {
+            dbprintlf("Ignoring envelope cache %s: %s", path.c_str(), e.what());
+            table.clear();
+        }
+    }
+
+    const Envelope *find(const std::string &key) const
+    {
+        auto it = table.find(key);
+        return it == table.end() ? nullptr : &it->second;
+    }
+
+    const Envelope *insert(const std::string &key, const Envelope &env)
+    {
+        table[key] = env;
+        save();
+        return &table[key];
+    }
+
+    bool save() const
+    {
+        std::string tmp = path + ".tmp";
+        std::ofstream ofs(tmp);
+        if (!ofs.good())
+            return false;
+        ofs << nlohmann::json(table).dump();
+        ofs.close();
+        return rename(tmp.c_str(), path.c_str()) == 0;
+    }
+};
@@ -0,0 +1,220 @@
+#pragma once
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "alliedcam.h"
+#include "featuretraits.hpp"
+
+/**
+ * @brief Resolved GenICam feature: the module that owns it and its type.
+ */
+struct FeatureEntry
+{
+    VmbHandle_t owner = nullptr; // remote device or stream
+    VmbFeatureData_t type = VmbFeatureDataUnknown;
+    VmbFeatureFlags_t flags = VmbFeatureFlagsNone;
+    std::string unit = "";
+};
+
+static inline const char *feature_type_name(VmbFeatureData_t type)
+{
+    switch (type)
+    {
+    case VmbFeatureDataInt:
+        return "Int";
+    case VmbFeatureDataFloat:
+        return "Float";
+    case VmbFeatureDataEnum:
+        return "Enum";
+    case VmbFeatureDataString:
+        return "String";
+    case VmbFeatureDataBool:
+        return "Bool";
+    case VmbFeatureDataCommand:
+        return "Command";
+    case VmbFeatureDataRaw:
+        return "Raw";
+    default:
+        return "Unknown";
+    }
+}
+
+/**
+ * @brief Name to feature table of one camera, built once at open so that
+ * generic get / set by name skips the per-call owner and type queries.
+ *
+ * Values are carried as text in the same form as the typed features.
+ */
+class FeatureMap
+{
+    std::unordered_map<std::string, FeatureEntry> entries;
+    std::vector<std::string> names; // discovery order
+
+    void add_module(VmbHandle_t module)
+    {
+        if (module == nullptr)
+            return;
+        VmbUint32_t count = 0;
+        if (VmbFeaturesList(module, nullptr, 0, &count, sizeof(VmbFeatureInfo_t)) != VmbErrorSuccess || count == 0)
+            return;
+        std::vector<VmbFeatureInfo_t> infos(count);
+        if (VmbFeaturesList(module, infos.data(), count, &count, sizeof(VmbFeatureInfo_t)) != VmbErrorSuccess)
+            return;
+        for (VmbUint32_t i = 0; i < count; i++)
+        {
+            const VmbFeatureInfo_t &info = infos[i];
+            if (info.name == nullptr || entries.count(info.name))
+                continue;
+            FeatureEntry entry;
+            entry.owner = module;
+            entry.type = info.featureDataType;
+            entry.flags = info.featureFlags;
+            entry.unit = info.unit != nullptr ? info.unit : "";
+            entries.emplace(info.name, entry);
+            names.push_back(info.name);
+        }
+    }
+
+public:
+    // device features take precedence over stream features of the same name
+    void build(VmbHandle_t device, VmbHandle_t stream)
+    {
+        entries.clear();
+        names.clear();
+        add_module(device);
+        add_module(stream);
+    }
+
+    size_t size() const
+    {
+        return entries.size();
+    }
+
+    const std::vector<std::string> &get_names() const
+    {
+        return names;
+    }
+
+    const FeatureEntry *find(const std::string &name) const
+    {
+        auto it = entries.find(name);
+        return it == entries.end() ? nullptr : &it->second;
+    }
+
+    /**
+     * @brief Read a feature as text.
+     *
+     * @return VmbError_t VmbErrorNotFound for unknown names, VmbErrorWrongType for commands and raw features.
+     */
+    VmbError_t get(const std::string &name, char *buf, size_t len, const FeatureEntry **entry_out = nullptr) const
+    {
+        const FeatureEntry *entry = find(name);
+        if (entry_out != nullptr)
+            *entry_out = entry;
+        if (entry == nullptr)
+            return VmbErrorNotFound;
+        VmbError_t err = VmbErrorWrongType;
+        switch (entry->type)
+        {
+        case VmbFeatureDataInt:
+        {
+            VmbInt64_t val;
+            err = VmbFeatureIntGet(entry->owner, name.c_str(), &val);
+            if (err == VmbErrorSuccess)
+                FeatureCodec<VmbInt64_t>::format(val, buf, len);
+            break;
+        }
+        case VmbFeatureDataFloat:
+        {
+            double val;
+            err = VmbFeatureFloatGet(entry->owner, name.c_str(), &val);
+            if (err == VmbErrorSuccess)
+                FeatureCodec<double>::format(val, buf, len);
+            break;
+        }
+        case VmbFeatureDataBool:
+        {
+            VmbBool_t val;
+            err = VmbFeatureBoolGet(entry->owner, name.c_str(), &val);
+            if (err == VmbErrorSuccess)
+                FeatureCodec<bool>::format(val, buf, len);
+            break;
+        }
+        case VmbFeatureDataEnum:
+        {
+            const char *val = nullptr;
+            err = VmbFeatureEnumGet(entry->owner, name.c_str(), &val);
+            if (err == VmbErrorSuccess)
+                FeatureCodec<const char *>::format(val, buf, len);
+            break;
+        }
+        case VmbFeatureDataString:
+        {
+            VmbUint32_t filled = 0;
+            err = VmbFeatureStringGet(entry->owner, name.c_str(), buf, len, &filled);
+            break;
+        }
+        default:
+            break;
+        }
+        return err;
+    }
+
+    /**
+     * @brief Write a feature from text and read it back into buf. Commands
+     * are run, the value is ignored.
+     *
+     * @return VmbError_t Error of the write if it failed, else of the read-back.
+     */
+    VmbError_t set(const std::string &name, const char *value, char *buf, size_t len, const FeatureEntry **entry_out = nullptr) const
+    {
+        const FeatureEntry *entry = find(name);
+        if (entry_out != nullptr)
+            *entry_out = entry;
+        if (entry == nullptr)
+            return VmbErrorNotFound;
+        VmbError_t err = VmbErrorWrongType;
+        switch (entry->type)
+        {
+        case VmbFeatureDataInt:
+        {
+            VmbInt64_t val;
+            err = FeatureCodec<VmbInt64_t>::parse(value, val) ? VmbFeatureIntSet(entry->owner, name.c_str(), val) : VmbErrorInvalidValue;
+            break;
+        }
+        case VmbFeatureDataFloat:
+        {
+            double val;
+            err = FeatureCodec<double>::parse(value, val) ? VmbFeatureFloatSet(entry->owner, name.c_str(), val) : VmbErrorInvalidValue;
+            break;
+        }
+        case VmbFeatureDataBool:
+        {
+            bool val;
+            err = FeatureCodec<bool>::parse(value, val) ? VmbFeatureBoolSet(entry->owner, name.c_str(), val ? VmbBoolTrue : VmbBoolFalse) : VmbErrorInvalidValue;
+            break;
+        }
+        case VmbFeatureDataEnum:
+            err = VmbFeatureEnumSet(entry->owner, name.c_str(), value);
+            break;
+        case VmbFeatureDataString:
+            err = VmbFeatureStringSet(entry->owner, name.c_str(), value);
+            break;
+        case VmbFeatureDataCommand:
+            err = VmbFeatureCommandRun(entry->owner, name.c_str());
+            snprintf(buf, len, "%s", allied_strerr(err));
+            return err;
+        default:
+            break;
+        }
+        if (err != VmbErrorSuccess)
+        {
+            get(name, buf, len);
+            return err;
+        }
+        return get(name, buf, len);
+    }
+};
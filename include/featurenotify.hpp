@@ -0,0 +1,122 @@
+#pragma once
+
+#include <czmq.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <thread>
+#include <atomic>
+#include <utility>
+#include "server.hpp"
+#include "imagecam.hpp"
+
+/**
+ * @brief Publishes changes of subscribed camera features.
+ *
+ * Every interval the dirty features of each camera are read once and the
+ * ones whose value differs from the last published value go out, so bursts
+ * of invalidations (auto exposure, a reconfigure) collapse into at most one
+ * message per feature and interval, and cameras are only read when
+ * something was flagged.
+ *
+ * Changes are published as one two-part message ("feature:<cam_id>", JSON)
+ * on a PUB socket owned by the notifier thread.
+ */
+class FeatureNotifier
+{
+    struct Member
+    {
+        uint32_t hash;
+        ImageCam *cam;
+        std::string topic;
+        std::map<std::string, std::string> last; // published values
+    };
+
+    std::string endpoint;
+    std::vector<Member> members;
+    std::thread thread;
+    std::atomic<bool> quit;
+    std::atomic<int64_t> interval_ms;
+    std::atomic<uint64_t> published;
+    std::atomic<uint64_t> flagged;
+
+    void publish(zsock_t *pub, Member &m, std::vector<std::pair<std::string, bool>> &dirty, uint64_t &seq)
+    {
+        char buf[FEATURE_TEXT_MAX];
+        for (auto &item : dirty)
+        {
+            flagged++;
+            const FeatureEntry *entry = nullptr;
+            if (m.cam->feature_map.get(item.first, buf, sizeof(buf), &entry) != VmbErrorSuccess)
+                continue;
+            auto it = m.last.find(item.first);
+            if (it != m.last.end() && it->second == buf && !item.second)
+                continue;
+            m.last[item.first] = buf;
+            nlohmann::json change;
+            change["seq"] = seq++;
+            change["cam_id"] = std::to_string(m.hash);
+            change["feature"] = item.first;
+            change["type"] = feature_type_name(entry->type);
+            change["value"] = buf;
+            change["ts_ms"] = zclock_time();
+            zmsg_t *msg = zmsg_new();
+            zmsg_addstr(msg, m.topic.c_str());
+            zmsg_addstr(msg, change.dump().c_str());
+            zmsg_send(&msg, pub);
+            published++;
+        }
+    }
+
+    void run()
+    {
+        zsock_t *pub = zsock_new_pub(endpoint.c_str());
+        if (pub == NULL)
+        {
+            ZSYS_ERROR("Could not bind feature change publisher to %s.", endpoint.c_str());
+            return;
+        }
+        ZSYS_INFO("Publishing feature changes on %s.", endpoint.c_str());
+        uint64_t seq = 0;
+        std::vector<std::pair<std::string, bool>> dirty;
+        while (!quit)
+        {
+            for (auto &m : members)
+            {
+                if (m.cam->feature_watch.take_dirty(dirty) > 0)
+                    publish(pub, m, dirty, seq);
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(interval_ms.load()));
+        }
+        zsock_destroy(&pub);
+    }
+
+public:
+    FeatureNotifier(const std::string &endpoint, std::map<uint32_t, ImageCam *> &imagecams)
+    {
+        this->endpoint = endpoint;
+        quit = false;
+        interval_ms = 50;
+        published = 0;
+        flagged = 0;
+        for (auto &image_cam_pair : imagecams)
+        {
+            members.push_back({image_cam_pair.first, image_cam_pair.second, "feature:" + std::to_string(image_cam_pair.first), {}});
+        }
+        thread = std::thread(&FeatureNotifier::run, this);
+    }
+
+    ~FeatureNotifier()
+    {
+        quit = true;
+        if (thread.joinable())
+            thread.join();
+    }
+
+    // changes published, features flagged dirty (published + coalesced or unchanged)
+    void get_stats(uint64_t &npublished, uint64_t &nflagged) const
+    {
+        npublished = published;
+        nflagged = flagged;
+    }
+};
@@ -0,0 +1,258 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <atomic>
+#include <charconv>
+#include "alliedcam.h"
+
+/**
+ * @brief Value classes a feature reads from or writes to. A write to a
+ * feature invalidates the cached value of every feature that depends on
+ * what it provides.
+ */
+enum FeatureDeps : uint32_t
+{
+    DEP_NONE = 0,
+    DEP_FORMAT = 1 << 0,    // pixel format, sensor bit depth
+    DEP_ROI = 1 << 1,       // image size, offset
+    DEP_EXPOSURE = 1 << 2,  // exposure time
+    DEP_FRAMERATE = 1 << 3, // frame rate and its auto mode
+    DEP_BANDWIDTH = 1 << 4, // device link throughput limit
+    DEP_TRIGSEL = 1 << 5,   // trigger line selector
+    DEP_TRIGGER = 1 << 6,   // selected line mode, source
+};
+
+static const size_t FEATURE_TEXT_MAX = 128;
+
+/**
+ * @brief Per type codecs.
+ *
+ * parse/format convert to and from the text form carried in NetPacket JSON
+ * arguments, pack/unpack to and from a fixed 8 byte binary slot. None of
+ * them allocate.
+ *
+ * @tparam T Feature value type.
+ */
+template <typename T>
+struct FeatureCodec;
+
+template <>
+struct FeatureCodec<const char *>
+{
+    typedef const char *get_type;
+    typedef const char *set_type;
+
+    static bool parse(const char *str, const char *&val)
+    {
+        val = str;
+        return true;
+    }
+
+    static int format(const char *val, char *buf, size_t len)
+    {
+        return snprintf(buf, len, "%s", val != nullptr ? val : "None");
+    }
+
+    // enum strings are owned by the camera for as long as it is open
+    static uint64_t pack(const char *val)
+    {
+        return (uint64_t)(uintptr_t)val;
+    }
+
+    static const char *unpack(uint64_t slot)
+    {
+        return (const char *)(uintptr_t)slot;
+    }
+};
+
+template <>
+struct FeatureCodec<VmbInt64_t>
+{
+    typedef VmbInt64_t get_type;
+    typedef VmbInt64_t set_type;
+
+    static bool parse(const char *str, VmbInt64_t &val)
+    {
+        while (isspace(*str))
+            str++;
+        if (*str == '+')
+            str++;
+        std::from_chars_result res = std::from_chars(str, str + strlen(str), val);
+        return res.ec == std::errc();
+    }
+
+    static int format(VmbInt64_t val, char *buf, size_t len)
+    {
+        std::to_chars_result res = std::to_chars(buf, buf + len - 1, val);
+        *res.ptr = '\0';
+        return res.ptr - buf;
+    }
+
+    static uint64_t pack(VmbInt64_t val)
+    {
+        return (uint64_t)val;
+    }
+
+    static VmbInt64_t unpack(uint64_t slot)
+    {
+        return (VmbInt64_t)slot;
+    }
+};
+
+template <>
+struct FeatureCodec<double>
+{
+    typedef double get_type;
+    typedef double set_type;
+
+    static bool parse(const char *str, double &val)
+    {
+        char *end = nullptr;
+        val = strtod(str, &end);
+        return end != str;
+    }
+
+    static int format(double val, char *buf, size_t len)
+    {
+        return snprintf(buf, len, "%.6f", val);
+    }
+
+    static uint64_t pack(double val)
+    {
+        uint64_t slot;
+        memcpy(&slot, &val, sizeof(slot));
+        return slot;
+    }
+
+    static double unpack(uint64_t slot)
+    {
+        double val;
+        memcpy(&val, &slot, sizeof(val));
+        return val;
+    }
+};
+
+template <>
+struct FeatureCodec<bool>
+{
+    typedef VmbBool_t get_type;
+    typedef bool set_type;
+
+    // "true"/"false" (any case) or "1"/"0", anything else is rejected
+    static bool parse(const char *str, bool &val)
+    {
+        if (strcasecmp(str, "true") == 0 || strcmp(str, "1") == 0)
+            val = true;
+        else if (strcasecmp(str, "false") == 0 || strcmp(str, "0") == 0)
+            val = false;
+        else
+            return false;
+        return true;
+    }
+
+    static int format(bool val, char *buf, size_t len)
+    {
+        return snprintf(buf, len, "%s", val ? "True" : "False");
+    }
+
+    static uint64_t pack(bool val)
+    {
+        return val ? 1 : 0;
+    }
+
+    static bool unpack(uint64_t slot)
+    {
+        return slot != 0;
+    }
+};
+
+/**
+ * @brief Compile-time description of a scalar camera feature.
+ *
+ * @tparam T Value type, one of const char *, VmbInt64_t, double, bool.
+ */
+template <typename T>
+struct FeatureDef
+{
+    typedef T value_type;
+    typedef FeatureCodec<T> codec;
+
+    int id;
+    const char *name;
+    const char *genicam; // camera feature behind the accessors, watched for changes
+    VmbError_t (*get)(AlliedCameraHandle_t, typename FeatureCodec<T>::get_type *);
+    VmbError_t (*set)(AlliedCameraHandle_t, typename FeatureCodec<T>::set_type);
+    uint32_t provides; // value classes a write changes
+    uint32_t depends;  // value classes the read-back depends on
+};
+
+/**
+ * @brief Last read value of each table feature of one camera.
+ *
+ * Filled and read by the command thread. Invalidation is safe from any
+ * thread (e.g. the sequencer switching exposure in the frame callback): a
+ * value read before an invalidation is never marked valid after it.
+ */
+class FeatureCache
+{
+public:
+    static const size_t NSLOTS = 32;
+
+private:
+    uint64_t slots[NSLOTS];
+    std::atomic<uint32_t> valid;
+    std::atomic<uint32_t> generation;
+
+public:
+    FeatureCache()
+    {
+        valid = 0;
+        generation = 0;
+    }
+
+    bool lookup(size_t idx, uint64_t &slot) const
+    {
+        if (!(valid.load(std::memory_order_acquire) & (1u << idx)))
+            return false;
+        slot = slots[idx];
+        return true;
+    }
+
+    // call before reading the camera, pass the result to store()
+    uint32_t begin_read() const
+    {
+        return generation.load();
+    }
+
+    void store(size_t idx, uint64_t slot, uint32_t gen)
+    {
+        slots[idx] = slot;
+        valid.fetch_or(1u << idx);
+        if (generation.load() != gen) // raced with an invalidation
+            valid.fetch_and(~(1u << idx));
+    }
+
+    // mask of slot indices
+    void invalidate(uint32_t mask)
+    {
+        generation.fetch_add(1);
+        valid.fetch_and(~mask);
+    }
+
+    void invalidate_all()
+    {
+        invalidate(0xffffffff);
+    }
+};
+
+// camera feature whose change drops the given cache slots
+struct FeatureCacheSource
+{
+    const char *genicam;
+    uint32_t mask;
+};
@@ -0,0 +1,221 @@
+#pragma once
+
+#include <string.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <utility>
+#include "alliedcam.h"
+#include "featuretraits.hpp"
+#include "featuremap.hpp"
+
+/**
+ * @brief GenICam features of one camera that clients subscribed to, with a
+ * dirty flag per feature.
+ *
+ * Vimba invalidation callbacks and server side writes set the flag; the
+ * notifier takes the dirty set, reads the current values and publishes the
+ * ones that changed, so any number of invalidations between two notifier
+ * passes collapse into one message.
+ *
+ * Independent of subscriptions, the camera features behind the read-back
+ * cache are watched too, so a change by auto exposure or another client
+ * drops the cached values that depend on it.
+ */
+class FeatureWatch
+{
+    struct Watched
+    {
+        VmbHandle_t owner = nullptr;
+        bool dirty = false;
+        bool fresh = false; // just subscribed, publish even if unchanged
+    };
+
+    std::mutex lock;
+    std::map<std::string, Watched> watched;
+    FeatureCache *cache = nullptr;
+    // only changed while none of them is registered
+    std::vector<FeatureCacheSource> sources;
+    VmbHandle_t sources_owner = nullptr;
+    std::atomic<uint64_t> ninvalidations;
+
+    static void InvalidationCallback(const VmbHandle_t handle, const char *name, void *user_data)
+    {
+        FeatureWatch *self = (FeatureWatch *)user_data;
+        self->ninvalidations.fetch_add(1, std::memory_order_relaxed);
+        std::lock_guard<std::mutex> guard(self->lock);
+        auto it = self->watched.find(name);
+        if (it != self->watched.end())
+            it->second.dirty = true;
+    }
+
+    // changed outside the server feature table, e.g. auto exposure or another client
+    static void CacheCallback(const VmbHandle_t handle, const char *name, void *user_data)
+    {
+        FeatureWatch *self = (FeatureWatch *)user_data;
+        self->ninvalidations.fetch_add(1, std::memory_order_relaxed);
+        for (const FeatureCacheSource &src : self->sources)
+        {
+            if (strcmp(src.genicam, name) == 0)
+                self->cache->invalidate(src.mask);
+        }
+    }
+
+public:
+    FeatureWatch()
+    {
+        ninvalidations = 0;
+    }
+
+    ~FeatureWatch()
+    {
+        unwatch_all();
+        untrack_cache();
+    }
+
+    // read-back cache to drop when a feature behind it changes
+    void set_cache(FeatureCache *cache)
+    {
+        this->cache = cache;
+    }
+
+    /**
+     * @brief Watch the camera features behind the read-back cache.
+     *
+     * Best effort: a feature the model does not have is skipped.
+     *
+     * @param owner Handle the features are registered on.
+     * @param sources Features and the cache slots they drop.
+     * @return size_t Number of features watched.
+     */
+    size_t track_cache(VmbHandle_t owner, const std::vector<FeatureCacheSource> &sources)
+    {
+        untrack_cache();
+        this->sources = sources;
+        return track_cache(owner);
+    }
+
+    // again with the last sources, after the camera was reopened
+    size_t track_cache(VmbHandle_t owner)
+    {
+        untrack_cache();
+        if (cache == nullptr || owner == nullptr)
+            return 0;
+        size_t ntracked = 0;
+        for (const FeatureCacheSource &src : sources)
+        {
+            VmbError_t err = VmbFeatureInvalidationRegister(owner, src.genicam, &CacheCallback, (void *)this);
+            if (err == VmbErrorSuccess)
+                ntracked++;
+            else
+                dbprintlf("Could not watch %s for the feature cache: %s", src.genicam, allied_strerr(err));
+        }
+        sources_owner = owner;
+        return ntracked;
+    }
+
+    void untrack_cache()
+    {
+        if (sources_owner == nullptr)
+            return;
+        for (const FeatureCacheSource &src : sources)
+            VmbFeatureInvalidationUnregister(sources_owner, src.genicam, &CacheCallback);
+        sources_owner = nullptr;
+    }
+
+    VmbError_t watch(const FeatureMap &map, const std::string &name)
+    {
+        const FeatureEntry *entry = map.find(name);
+        if (entry == nullptr)
+            return VmbErrorNotFound;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if (watched.count(name))
+                return VmbErrorSuccess;
+            Watched &w = watched[name];
+            w.owner = entry->owner;
+            w.dirty = true;
+            w.fresh = true;
+        }
+        // not under the lock, the callback takes it
+        VmbError_t err = VmbFeatureInvalidationRegister(entry->owner, name.c_str(), &InvalidationCallback, (void *)this);
+        if (err != VmbErrorSuccess)
+        {
+            dbprintlf("Could not watch %s: %s", name.c_str(), allied_strerr(err));
+            std::lock_guard<std::mutex> guard(lock);
+            watched.erase(name);
+        }
+        return err;
+    }
+
+    VmbError_t unwatch(const std::string &name)
+    {
+        VmbHandle_t owner = nullptr;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            auto it = watched.find(name);
+            if (it == watched.end())
+                return VmbErrorNotFound;
+            owner = it->second.owner;
+            watched.erase(it);
+        }
+        return VmbFeatureInvalidationUnregister(owner, name.c_str(), &InvalidationCallback);
+    }
+
+    void unwatch_all()
+    {
+        for (const std::string &name : get_names())
+            unwatch(name);
+    }
+
+    // after a server side write: anything may have moved with it
+    void mark_all_dirty()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        for (auto &entry : watched)
+            entry.second.dirty = true;
+    }
+
+    /**
+     * @brief Take the features flagged since the last call.
+     *
+     * @param out (name, fresh) pairs, reused; fresh ones are published even if unchanged.
+     * @return size_t Number of entries in out.
+     */
+    size_t take_dirty(std::vector<std::pair<std::string, bool>> &out)
+    {
+        out.clear();
+        std::lock_guard<std::mutex> guard(lock);
+        for (auto &entry : watched)
+        {
+            if (!entry.second.dirty)
+                continue;
+            out.emplace_back(entry.first, entry.second.fresh);
+            entry.second.dirty = false;
+            entry.second.fresh = false;
+        }
+        return out.size();
+    }
+
+    std::vector<std::string> get_names()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        std::vector<std::string> names;
+        for (auto &entry : watched)
+            names.push_back(entry.first);
+        return names;
+    }
+
+    size_t size()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        return watched.size();
+    }
+
+    uint64_t invalidations() const
+    {
+        return ninvalidations.load(std::memory_order_relaxed);
+    }
+};
@@ -0,0 +1,171 @@
+#pragma once
+
+#include <czmq.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <thread>
+#include <atomic>
+#include "server.hpp"
+#include "imagecam.hpp"
+
+/**
+ * @brief Joins the per-camera frame rings into frame sets.
+ *
+ * Streaming merge over the ring heads: the oldest head sets the reference
+ * time, every camera whose head lies within the tolerance of it joins the
+ * set and is consumed, the rest are marked missing. A set is emitted once
+ * every camera has a head or the reference is older than max_wait. Each
+ * frame is looked at a constant number of times.
+ *
+ * Sets are published as one two-part message ("bundle", JSON) on a PUB
+ * socket owned by the merge thread.
+ */
+class FrameBundler
+{
+    struct Member
+    {
+        uint32_t hash;
+        ImageCam *cam;
+        bool has_head;
+        FrameMeta head;
+    };
+
+    std::string endpoint;
+    std::vector<Member> members;
+    std::thread thread;
+    std::atomic<bool> quit;
+    std::atomic<int64_t> tolerance_ns;
+    std::atomic<int64_t> max_wait_ns;
+    std::atomic<uint64_t> bundles;
+    std::atomic<uint64_t> incomplete;
+
+    static int64_t frame_time(const FrameMeta &meta)
+    {
+        // fall back to arrival time until the clock model is up
+        return meta.host_ts_ns >= 0 ? meta.host_ts_ns : meta.recv_ts_ns;
+    }
+
+    // one merge step, returns true if a set was emitted
+    bool step(zsock_t *pub, uint64_t &seq)
+    {
+        int64_t tref = INT64_MAX;
+        bool all = true;
+        for (auto &m : members)
+        {
+            if (!m.has_head)
+                m.has_head = m.cam->get_frame_ring().pop(m.head);
+            if (m.has_head)
+                tref = std::min(tref, frame_time(m.head));
+            else
+                all = false;
+        }
+        if (tref == INT64_MAX)
+            return false;
+        if (!all && host_mono_raw_ns() - tref < max_wait_ns)
+            return false;
+
+        int64_t tol = tolerance_ns;
+        bool complete = true;
+        nlohmann::json set;
+        set["seq"] = seq++;
+        set["t_ref_ns"] = tref;
+        nlohmann::json &jmembers = set["members"] = nlohmann::json::array();
+        for (auto &m : members)
+        {
+            nlohmann::json jm;
+            jm["cam_id"] = std::to_string(m.hash);
+            if (m.has_head && frame_time(m.head) - tref <= tol)
+            {
+                jm["missing"] = false;
+                jm["frame_id"] = m.head.frame_id;
+                jm["cam_ts"] = m.head.cam_ts;
+                jm["host_ts_ns"] = frame_time(m.head);
+                jm["seq_step"] = m.head.seq_step;
+                m.has_head = false;
+            }
+            else
+            {
+                jm["missing"] = true;
+                complete = false;
+            }
+            jmembers.push_back(jm);
+        }
+        set["complete"] = complete;
+        bundles++;
+        if (!complete)
+            incomplete++;
+        zmsg_t *msg = zmsg_new();
+        zmsg_addstr(msg, "bundle");
+        zmsg_addstr(msg, set.dump().c_str());
+        zmsg_send(&msg, pub);
+        return true;
+    }
+
+    void run()
+    {
+        zsock_t *pub = zsock_new_pub(endpoint.c_str());
+        if (pub == NULL)
+        {
+            ZSYS_ERROR("Could not bind frame set publisher to %s.", endpoint.c_str());
+            return;
+        }
+        ZSYS_INFO("Publishing frame sets on %s.", endpoint.c_str());
+        uint64_t seq = 0;
+        while (!quit)
+        {
+            bool emitted = false;
+            while (step(pub, seq))
+                emitted = true;
+            if (!emitted)
+                std::this_thread::sleep_for(std::chrono::microseconds(500));
+        }
+        zsock_destroy(&pub);
+    }
+
+public:
+    FrameBundler(const std::string &endpoint, std::map<uint32_t, ImageCam *> &imagecams)
+    {
+        this->endpoint = endpoint;
+        quit = false;
+        tolerance_ns = 1000000;
+        max_wait_ns = 100000000;
+        bundles = 0;
+        incomplete = 0;
+        for (auto &image_cam_pair : imagecams)
+        {
+            members.push_back({image_cam_pair.first, image_cam_pair.second, false, FrameMeta()});
+            image_cam_pair.second->enable_frame_ring(true);
+        }
+        thread = std::thread(&FrameBundler::run, this);
+    }
+
+    ~FrameBundler()
+    {
+        quit = true;
+        if (thread.joinable())
+            thread.join();
+        for (auto &m : members)
+            m.cam->enable_frame_ring(false);
+    }
+
+    void set_tolerance_us(int64_t us)
+    {
+        tolerance_ns = us * 1000;
+    }
+
+    int64_t get_tolerance_us() const
+    {
+        return tolerance_ns / 1000;
+    }
+
+    // sets emitted, sets with missing members, frames dropped by full rings
+    void get_stats(uint64_t &nbundles, uint64_t &nincomplete, uint64_t &ndropped) const
+    {
+        nbundles = bundles;
+        nincomplete = incomplete;
+        ndropped = 0;
+        for (auto &m : members)
+            ndropped += m.cam->get_frame_ring().get_dropped();
+    }
+};
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+/**
+ * @brief Lock-free single producer, single consumer ring.
+ *
+ * The producer is the camera frame callback, the consumer is a pipeline
+ * stage. When full, new items are dropped and counted.
+ *
+ * @tparam T Item type, copied in and out.
+ * @tparam N Capacity, power of 2.
+ */
+template <typename T, size_t N>
+class FrameRing
+{
+    static_assert((N & (N - 1)) == 0, "FrameRing capacity must be a power of 2");
+
+    T items[N];
+    std::atomic<size_t> head; // written by producer
+    char pad[64];             // keep head and tail on separate cache lines
+    std::atomic<size_t> tail; // written by consumer
+    std::atomic<uint64_t> dropped;
+
+public:
+    FrameRing()
+    {
+        head = 0;
+        tail = 0;
+        dropped = 0;
+    }
+
+    bool push(const T &item)
+    {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) >= N)
+        {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        items[h & (N - 1)] = item;
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T &item)
+    {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t == head.load(std::memory_order_acquire))
+            return false;
+        item = items[t & (N - 1)];
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer side only
+    void clear()
+    {
+        tail.store(head.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+    size_t size() const
+    {
+        return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+    }
+
+    uint64_t get_dropped() const
+    {
+        return dropped.load(std::memory_order_relaxed);
+    }
+};
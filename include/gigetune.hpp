@@ -0,0 +1,104 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <ifaddrs.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Result of the open-time GigE stream tuning step.
+ *
+ * Host checks are kept free of VmbC calls so they can be exercised with
+ * made-up numbers.
+ */
+struct GigETuneReport
+{
+    bool gige = false;
+    int64_t packet_size_before = -1;
+    int64_t packet_size = -1;
+    std::string nic = "";
+    int64_t nic_mtu = -1;
+    int64_t rmem_max = -1;
+    double cpu_us_per_frame = -1; // process CPU time per frame over the last capture
+    std::vector<std::string> warnings;
+};
+
+static inline void gige_check_host(GigETuneReport &report, uint32_t frame_size)
+{
+    report.warnings.clear();
+    if (report.nic_mtu > 0)
+    {
+        if (report.nic_mtu <= 1500)
+            report.warnings.push_back(
+                "NIC " + report.nic + " MTU is " + std::to_string(report.nic_mtu) + ", enable jumbo frames (9000) to cut per-packet CPU cost");
+        else if (report.packet_size > 0 && report.packet_size <= 1500)
+            report.warnings.push_back(
+                "NIC " + report.nic + " supports jumbo frames but the camera negotiated " + std::to_string(report.packet_size) + " byte packets");
+        // GVSPPacketSize already counts the IP, UDP and GVSP headers
+        if (report.packet_size > 0 && report.packet_size > report.nic_mtu)
+            report.warnings.push_back(
+                "Packet size " + std::to_string(report.packet_size) + " exceeds NIC MTU " + std::to_string(report.nic_mtu));
+    }
+    else
+    {
+        report.warnings.push_back("Could not determine the NIC the camera is connected to");
+    }
+    // the receive socket should hold at least two frames or 4 MiB, whichever is more
+    int64_t want = 2 * (int64_t)frame_size;
+    if (want < (4 << 20))
+        want = 4 << 20;
+    if (report.rmem_max >= 0 && report.rmem_max < want)
+        report.warnings.push_back(
+            "net.core.rmem_max is " + std::to_string(report.rmem_max) + ", raise it to at least " + std::to_string(want));
+}
+
+static inline int64_t read_sysfs_int(const char *path)
+{
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL)
+        return -1;
+    long long val = -1;
+    if (fscanf(fp, "%lld", &val) != 1)
+        val = -1;
+    fclose(fp);
+    return val;
+}
+
+// find the local interface on the camera's subnet, ip in host byte order
+static inline std::string gige_find_nic(uint32_t ip)
+{
+    std::string name = "";
+    struct ifaddrs *ifs = nullptr;
+    if (getifaddrs(&ifs) != 0)
+        return name;
+    for (struct ifaddrs *ifa = ifs; ifa != nullptr; ifa = ifa->ifa_next)
+    {
+        if (ifa->ifa_addr == nullptr || ifa->ifa_netmask == nullptr || ifa->ifa_addr->sa_family != AF_INET)
+            continue;
+        uint32_t addr = ntohl(((struct sockaddr_in *)ifa->ifa_addr)->sin_addr.s_addr);
+        uint32_t mask = ntohl(((struct sockaddr_in *)ifa->ifa_netmask)->sin_addr.s_addr);
+        if ((addr & mask) == (ip & mask))
+        {
+            name = ifa->ifa_name;
+            break;
+        }
+    }
+    freeifaddrs(ifs);
+    return name;
+}
+
+static inline void gige_probe_host(GigETuneReport &report, uint32_t camera_ip)
+{
+    report.nic = gige_find_nic(camera_ip);
+    if (report.nic != "")
+    {
+        std::string path = "/sys/class/net/" + report.nic + "/mtu";
+        report.nic_mtu = read_sysfs_int(path.c_str());
+    }
+    report.rmem_max = read_sysfs_int("/proc/sys/net/core/rmem_max");
+}
@@ -0,0 +1,247 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include "alliedcam.h"
+
+/**
+ * @brief Merges a bracket of differently exposed frames into one radiance
+ * image (counts per microsecond).
+ *
+ * Each sample is weighted by a hat function that is zero at or below the
+ * noise floor and at or above the saturation level, so the merged value of
+ * a pixel comes only from the exposures where it was well exposed. Rows are
+ * split across OpenMP threads and the per-row loop is vectorized.
+ *
+ * Finished images are handed to a writer thread and stored as PFM (little
+ * endian, greyscale) files.
+ */
+class HdrMerge
+{
+    uint32_t width = 0;
+    uint32_t height = 0;
+    float lo = 0;
+    float hi = 0;
+    std::vector<float> num;
+    std::vector<float> den;
+    std::vector<float> shortest; // fallback for pixels saturated in every exposure
+    float min_exposure = 0;
+    uint32_t nframes = 0;
+
+    std::string outdir;
+    std::string prefix;
+    std::thread writer;
+    std::mutex lock;
+    std::condition_variable cv;
+    bool quit = false;
+    bool pending = false;
+    std::vector<float> out;
+    uint64_t out_idx = 0;
+    std::atomic<uint64_t> written;
+    std::atomic<uint64_t> dropped;
+
+    // the first frame of a bracket overwrites, so the sums need no clearing
+    template <bool FIRST, typename T>
+    void accumulate(const T *data, float inv_exposure, bool is_shortest)
+    {
+        const float l = lo, h = hi;
+#pragma omp parallel for schedule(static)
+        for (uint32_t row = 0; row < height; row++)
+        {
+            const T *src = data + (size_t)row * width;
+            float *n = num.data() + (size_t)row * width;
+            float *d = den.data() + (size_t)row * width;
+            float *s = shortest.data() + (size_t)row * width;
+#pragma omp simd
+            for (uint32_t col = 0; col < width; col++)
+            {
+                float z = (float)src[col];
+                float w = fmaxf(0.0f, fminf(z - l, h - z));
+                n[col] = (FIRST ? 0.0f : n[col]) + w * z * inv_exposure;
+                d[col] = (FIRST ? 0.0f : d[col]) + w;
+                if (is_shortest)
+                    s[col] = z * inv_exposure;
+            }
+        }
+    }
+
+    void write_loop()
+    {
+        std::unique_lock<std::mutex> lk(lock);
+        while (true)
+        {
+            cv.wait(lk, [this]()
+                    { return quit || pending; });
+            if (!pending)
+                break;
+            std::string fname = outdir + "/" + prefix + "_" + std::to_string(out_idx) + ".pfm";
+            lk.unlock();
+            FILE *fp = fopen(fname.c_str(), "wb");
+            if (fp != NULL)
+            {
+                fprintf(fp, "Pf\n%u %u\n-1.0\n", width, height);
+                // PFM stores rows bottom to top
+                for (uint32_t row = height; row > 0; row--)
+                    fwrite(out.data() + (size_t)(row - 1) * width, sizeof(float), width, fp);
+                fclose(fp);
+                written++;
+            }
+            lk.lock();
+            pending = false;
+        }
+    }
+
+public:
+    /**
+     * @param outdir Directory for merged images.
+     * @param prefix File name prefix, files are <prefix>_<bracket>.pfm.
+     */
+    HdrMerge(const std::string &outdir, const std::string &prefix)
+    {
+        this->outdir = outdir;
+        this->prefix = prefix;
+        written = 0;
+        dropped = 0;
+        writer = std::thread(&HdrMerge::write_loop, this);
+    }
+
+    ~HdrMerge()
+    {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            quit = true;
+        }
+        cv.notify_all();
+        writer.join();
+    }
+
+    const std::string &get_outdir() const
+    {
+        return outdir;
+    }
+
+    /**
+     * @brief Size the buffers for the coming capture, so the frame path
+     * does not allocate. Call while not capturing.
+     */
+    void prepare(uint32_t width, uint32_t height)
+    {
+        this->width = width;
+        this->height = height;
+        size_t npix = (size_t)width * height;
+        num.resize(npix);
+        den.resize(npix);
+        shortest.resize(npix);
+        nframes = 0;
+        std::lock_guard<std::mutex> guard(lock);
+        if (!pending)
+            out.resize(npix);
+    }
+
+    /**
+     * @brief Add a frame of the current bracket. Supports Mono8 and the
+     * unpacked 16 bit mono formats. The caller leaves out frames that may
+     * still carry the previous step's exposure.
+     *
+     * @return VmbError_t VmbErrorWrongType for unsupported pixel formats.
+     */
+    VmbError_t add(const VmbFrame_t *frame, double exposure_us)
+    {
+        const void *data = frame->imageData != nullptr ? (const void *)frame->imageData : frame->buffer;
+        float maxval;
+        switch (frame->pixelFormat)
+        {
+        case VmbPixelFormatMono8:
+            maxval = 255;
+            break;
+        case VmbPixelFormatMono10:
+            maxval = 1023;
+            break;
+        case VmbPixelFormatMono12:
+            maxval = 4095;
+            break;
+        case VmbPixelFormatMono14:
+            maxval = 16383;
+            break;
+        case VmbPixelFormatMono16:
+            maxval = 65535;
+            break;
+        default:
+            return VmbErrorWrongType;
+        }
+        if (frame->width != width || frame->height != height)
+        {
+            // not prepared for this geometry; allocates once
+            width = frame->width;
+            height = frame->height;
+            num.resize((size_t)width * height);
+            den.resize((size_t)width * height);
+            shortest.resize((size_t)width * height);
+            nframes = 0;
+        }
+        if (nframes == 0)
+            min_exposure = 0;
+        lo = 0.02f * maxval; // noise floor
+        hi = 0.95f * maxval; // saturation
+        // the first frame is the shortest so far, shortest is always written by it
+        bool is_shortest = min_exposure == 0 || exposure_us < min_exposure;
+        if (is_shortest)
+            min_exposure = exposure_us;
+        if (frame->pixelFormat == VmbPixelFormatMono8)
+        {
+            if (nframes == 0)
+                accumulate<true>((const uint8_t *)data, 1.0f / exposure_us, is_shortest);
+            else
+                accumulate<false>((const uint8_t *)data, 1.0f / exposure_us, is_shortest);
+        }
+        else
+        {
+            if (nframes == 0)
+                accumulate<true>((const uint16_t *)data, 1.0f / exposure_us, is_shortest);
+            else
+                accumulate<false>((const uint16_t *)data, 1.0f / exposure_us, is_shortest);
+        }
+        nframes++;
+        return VmbErrorSuccess;
+    }
+
+    // close the bracket and queue the merged image, dropped if the writer is still busy
+    void finish(uint64_t bracket)
+    {
+        if (nframes == 0)
+            return;
+        std::unique_lock<std::mutex> lk(lock);
+        if (pending)
+        {
+            dropped++;
+        }
+        else
+        {
+            out.resize((size_t)width * height);
+            float *o = out.data();
+            const float *n = num.data(), *d = den.data(), *s = shortest.data();
+            size_t npix = (size_t)width * height;
+#pragma omp parallel for simd schedule(static)
+            for (size_t i = 0; i < npix; i++)
+                o[i] = d[i] > 0 ? n[i] / d[i] : s[i];
+            out_idx = bracket;
+            pending = true;
+            cv.notify_all();
+        }
+        lk.unlock();
+        nframes = 0;
+    }
+
+    void get_stats(uint64_t &nwritten, uint64_t &ndropped) const
+    {
+        nwritten = written;
+        ndropped = dropped;
+    }
+};
@@ -5,86 +5,26 @@
 #include "meb_print.h"
 #include "alliedcam.h"
 #include "aDIO_library.h"
+#include "clocksync.hpp"
+#include "framering.hpp"
+#include "latencyhist.hpp"
+#include "gigetune.hpp"
+#include "hdrmerge.hpp"
+#include "envelope.hpp"
+#include "featuretraits.hpp"
+#include "featuremap.hpp"
+#include "capabilities.hpp"
+#include "charcontainer.hpp"
+#include "featurewatch.hpp"
+#include "capture_api.h"
 #include <string>
 #include <stdexcept>
-
-class CharContainer
-{
-private:
-    char *strdup(const char *str)
-    {
-        int len = strlen(str);
-        char *out = new char[len + 1];
-        strcpy(out, str);
-        return out;
-    }
-
-public:
-    char **arr = nullptr;
-    int narr = 0;
-    int selected;
-    size_t maxlen = 0;
-
-    ~CharContainer()
-    {
-        if (arr)
-        {
-            for (int i = 0; i < narr; i++)
-            {
-                delete[] arr[i];
-            }
-            delete[] arr;
-        }
-    }
-
-    CharContainer()
-    {
-        arr = nullptr;
-        narr = 0;
-        selected = -1;
-    }
-
-    CharContainer(const char **arr, int narr)
-    {
-        this->arr = new char *[narr];
-        this->narr = narr;
-        this->selected = -1;
-        for (int i = 0; i < narr; i++)
-        {
-            this->arr[i] = strdup(arr[i]);
-            if (strlen(arr[i]) > maxlen)
-            {
-                maxlen = strlen(arr[i]);
-            }
-        }
-    }
-
-    CharContainer(const char **arr, int narr, const char *key)
-    {
-        this->arr = new char *[narr];
-        this->narr = narr;
-        for (int i = 0; i < narr; i++)
-        {
-            this->arr[i] = strdup(arr[i]);
-            if (strlen(arr[i]) > maxlen)
-            {
-                maxlen = strlen(arr[i]);
-            }
-        }
-        this->selected = find_idx(key);
-    }
-
-    int find_idx(const char *str)
-    {
-        int res = -1;
-        for (int i = 0; i < narr; i++)
-        {
-            if (strcmp(arr[i], str) == 0)
-                res = i;
-        }
-        return res;
-    }
-};
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <functional>
 
 class CameraInfo
 {
@@ -121,7 +61,7 @@ public:
 
 namespace std
 {
-    std::string to_string(const CameraInfo &info) noexcept
+    static inline std::string to_string(const CameraInfo &info) noexcept
     {
         std::string reply = "ID: " + info.idstr + ",\n";
         reply += "Name: " + info.name + ",\n";
@@ -131,49 +71,285 @@ namespace std
     }
 };
 
+struct StreamStats
+{
+    bool available = false;
+    VmbInt64_t frames_delivered = 0;
+    VmbInt64_t frames_dropped = 0;
+    VmbInt64_t frames_underrun = 0;
+    VmbInt64_t packets_received = 0;
+    VmbInt64_t packets_missed = 0;
+    VmbInt64_t packets_resent = 0;
+    VmbInt64_t packets_requested = 0;
+};
+
+struct FrameMeta
+{
+    uint64_t frame_id = 0;
+    uint64_t cam_ts = 0;      // camera timestamp, ticks
+    int64_t host_ts_ns = -1;  // camera timestamp in host CLOCK_MONOTONIC_RAW, -1 if not synchronized
+    int64_t recv_ts_ns = 0;   // host CLOCK_MONOTONIC_RAW at frame callback
+    VmbFrameStatus_t status = VmbFrameStatusComplete;
+    int32_t seq_step = -1;    // exposure sequence step, -1 outside a sequence
+    uint32_t seq_pass = 0;    // exposure sequence pass
+    double exposure_us = 0;   // commanded exposure of the sequence step
+};
+
+// hand-off of an exposure sequence step between the frame path and poll()
+enum class SeqSwitch
+{
+    None,      // counting frames of the current step
+    Requested, // step complete, waiting for poll() to write the next exposure
+    Written,   // exposure written, the frame path picks up the next step
+};
+
+struct SeqStep
+{
+    double exposure_us;
+    uint32_t frames;
+};
+
+enum class AdioMode
+{
+    Frame = 0,    // toggle on frame-complete callback
+    Exposure = 1, // high on ExposureStart event, low on ExposureEnd event
+};
+
 class ImageCam
 {
+    static const int EXPOSURE_RING_LEN = 16; // must be a power of 2
+
     bool opened = false;
-    unsigned char state = 0;
-    bool capturing;
+    // aDIO line level; written from the frame, event and command threads
+    std::atomic<unsigned char> state;
+    std::atomic<bool> capturing; // cleared by the watchdog thread when a restart fails
     DeviceHandle adio_hdl = nullptr;
     CameraInfo info;
     int64_t capture_start_time = -1;
     uint64_t frames = 0;
 
+    std::atomic<AdioMode> adio_mode; // selects the one callback path that drives the line
+    bool events_registered = false;
+    // exposure end host time (us) indexed by camera frame ID, filled from the event path
+    std::atomic<uint64_t> exposure_end_id[EXPOSURE_RING_LEN];
+    std::atomic<int64_t> exposure_end_us[EXPOSURE_RING_LEN];
+    // delay between exposure end and frame-complete callback
+    std::atomic<uint64_t> lag_count;
+    std::atomic<int64_t> lag_sum_us;
+    std::atomic<int64_t> lag_max_us;
+
+    // camera to host clock estimator, fed by a background latch thread
+    ClockSync clock_sync;
+    std::thread sync_thread;
+    std::mutex sync_lock;
+    std::condition_variable sync_cv;
+    bool sync_quit = false;
+    const char *latch_cmd = nullptr;
+    const char *latch_val = nullptr;
+
+    std::mutex meta_lock;
+    FrameMeta last_meta;
+    std::atomic<bool> ring_enabled;
+    // in-process frame consumer, see capture_api.h; replaced whole, never modified
+    struct FrameHook
+    {
+        capture_frame_cb_t cb;
+        void *user;
+        uint32_t cam_id;
+    };
+    std::atomic<const FrameHook *> frame_hook;
+    std::atomic<int> frame_hook_calls; // frame callbacks between loading the hook and done with it
+    FrameRing<FrameMeta, 256> frame_ring;
+
+    // transport layer stream counters (GigE), last two polls
+    std::mutex stats_lock;
+    StreamStats stream_stats;
+    StreamStats stream_stats_prev;
+    VmbHandle_t stats_handle = nullptr;
+    bool stats_probed = false;
+
+    // exposure sequencer, only modified while not capturing; during a capture
+    // the frame path counts frames and poll() writes the exposure
+    std::vector<SeqStep> sequence;
+    uint32_t seq_repeats = 0; // 0 repeats until stopped
+    int32_t seq_step = -1;
+    uint32_t seq_pass = 0;
+    uint32_t seq_left = 0;
+    int32_t seq_next_step = -1;     // step the frame path asked for, -1 ends the sequence
+    uint32_t seq_next_pass = 0;
+    bool seq_settled = true;        // a frame exposed after the last write has arrived
+    int64_t seq_settle_ns = -1;     // earliest host timestamp of a frame exposed after the write
+    uint64_t seq_write_id = 0;      // last frame delivered before the write
+    std::atomic<SeqSwitch> seq_switch;
+    std::atomic<bool> seq_done;
+    HdrMerge *hdr = nullptr; // merges each sequence pass into one image
+    std::shared_ptr<const Capabilities> caps; // option lists, shared by cameras of the same model and firmware
+
+    GigETuneReport gige;
+    int64_t cpu_start_ns = -1;
+
+    uint32_t frame_buffers = 5;             // frame buffers announced to the driver
+    uint64_t buffer_budget = 256ULL << 20;  // bytes the frame buffers may commit
+    LatencyHist consumer_latency;           // time spent in the frame callback
+    LatencyHist delivery_latency;           // camera timestamp to callback entry, host clock
+
+    // stall watchdog
+    std::mutex capture_lock;
+    double frame_period_ms = 1000;
+    std::atomic<int64_t> last_frame_ms;
+    std::atomic<bool> stalled;
+    std::atomic<bool> recovering;
+    std::thread recovery_thread;
+    std::atomic<uint64_t> stalls;
+    std::atomic<uint64_t> recoveries;
+    std::atomic<uint64_t> recovery_failures;
+
     ImageCam(const ImageCam &other) = delete;
 
 public:
     int adio_bit = -1;
+    int64_t start_all_us = -1; // wall clock, when the last start_capture_all started this camera
     AlliedCameraHandle_t handle = nullptr;
+    FeatureCache feature_cache; // read-back values of the server feature table
+    FeatureMap feature_map;     // all GenICam features by name, resolved at open
+    FeatureWatch feature_watch; // features clients subscribed to for change notifications
+
+    std::shared_ptr<const Capabilities> get_capabilities() const
+    {
+        return caps;
+    }
+
+    // model|firmware, the key capability tables are shared by
+    std::string capability_key() const
+    {
+        char firmware[128] = "unknown";
+        VmbUint32_t len = 0;
+        if (VmbFeatureStringGet(vmb_handle(), "DeviceFirmwareVersion", firmware, sizeof(firmware), &len) != VmbErrorSuccess)
+            snprintf(firmware, sizeof(firmware), "unknown");
+        return info.model + "|" + firmware;
+    }
+
+    /**
+     * @brief Attach the shared capability table of this model and firmware,
+     * fetching it from the camera if no camera interned it yet. The
+     * selected trigger line is restored after the per-line source lists
+     * are read. Called again to retry after a list could not be read.
+     */
+    void load_capabilities()
+    {
+        std::string key = capability_key();
+        caps = CapabilityRegistry::instance().find(key);
+        if (caps != nullptr)
+            return;
+        Capabilities fresh;
+        fresh.key = key;
+        fresh.triglines_err = fetch_capability_list(allied_get_triglines_list, handle, fresh.triglines);
+        fresh.sensor_bit_depths_err = fetch_capability_list(allied_get_sensor_bit_depth_list, handle, fresh.sensor_bit_depths);
+        const char *selected = nullptr;
+        if (fresh.triglines_err == VmbErrorSuccess && allied_get_trigline(handle, &selected) == VmbErrorSuccess)
+        {
+            std::string restore = selected;
+            for (const std::string &line : fresh.triglines)
+            {
+                std::vector<std::string> srcs;
+                VmbError_t err = allied_set_trigline(handle, line.c_str());
+                if (err == VmbErrorSuccess)
+                    err = fetch_capability_list(allied_get_trigline_src_list, handle, srcs);
+                if (err == VmbErrorSuccess)
+                    fresh.trigline_srcs[line] = srcs;
+                else
+                    fresh.trigline_srcs_err = err;
+            }
+            allied_set_trigline(handle, restore.c_str());
+            feature_cache.invalidate_all();
+        }
+        caps = CapabilityRegistry::instance().intern(fresh);
+        if (fresh.complete())
+        {
+            dbprintlf("Camera %s: capabilities of %s fetched.", info.idstr.c_str(), key.c_str());
+        }
+        else
+        {
+            dbprintlf("Camera %s: capabilities of %s incomplete, not shared.", info.idstr.c_str(), key.c_str());
+        }
+    }
 
     CameraInfo &get_info()
     {
         return info;
     }
 
+    VmbHandle_t vmb_handle() const
+    {
+        return allied_get_vmbhandle(handle);
+    }
+
     ImageCam()
     {
         handle = nullptr;
         capturing = false;
+        state = 0;
+        adio_mode = AdioMode::Frame;
+        ring_enabled = false;
+        frame_hook = nullptr;
+        frame_hook_calls = 0;
+        seq_switch = SeqSwitch::None;
+        seq_done = false;
+        last_frame_ms = -1;
+        stalled = false;
+        recovering = false;
+        stalls = 0;
+        recoveries = 0;
+        recovery_failures = 0;
+        reset_adio_lag();
     }
 
     ImageCam(CameraInfo &camera_info, DeviceHandle adio_hdl)
     {
         handle = nullptr;
         capturing = false;
+        state = 0;
+        adio_mode = AdioMode::Frame;
+        ring_enabled = false;
+        frame_hook = nullptr;
+        frame_hook_calls = 0;
+        seq_switch = SeqSwitch::None;
+        seq_done = false;
+        last_frame_ms = -1;
+        stalled = false;
+        recovering = false;
+        stalls = 0;
+        recoveries = 0;
+        recovery_failures = 0;
+        reset_adio_lag();
         this->adio_hdl = adio_hdl;
         this->info = camera_info;
-        if (allied_open_camera(&handle, info.idstr.c_str(), 5) != VmbErrorSuccess)
+        feature_watch.set_cache(&feature_cache);
+        if (allied_open_camera(&handle, info.idstr.c_str(), frame_buffers) != VmbErrorSuccess)
         {
             dbprintlf(FATAL "Failed to open camera %s.", camera_info.idstr.c_str());
             throw std::runtime_error("Failed to open camera.");
         }
+        opened = true;
+        // best effort, lets the frame-callback lag be measured without exposure mode
+        if (register_exposure_events() != VmbErrorSuccess)
+        {
+            dbprintlf("Exposure events not available on %s.", camera_info.idstr.c_str());
+        }
+        start_clock_sync();
+        tune_gige_stream();
+        load_capabilities();
+        feature_map.build(vmb_handle(), stream_handle());
+        dbprintlf("Camera %s: %zu features.", camera_info.idstr.c_str(), feature_map.size());
     }
 
     ~ImageCam()
     {
+        if (recovery_thread.joinable())
+            recovery_thread.join();
         close_camera();
+        delete hdr;
+        delete frame_hook.load();
     }
 
     static void Callback(const AlliedCameraHandle_t handle, const VmbHandle_t stream, VmbFrame_t *frame, void *user_data)
@@ -181,100 +357,572 @@ public:
         assert(user_data);
 
         ImageCam *self = (ImageCam *)user_data;
+        int64_t tenter = zclock_usecs();
         self->frames++;
-        if (self->adio_hdl != nullptr && self->adio_bit >= 0)
+        self->last_frame_ms.store(zclock_mono(), std::memory_order_relaxed);
+        FrameMeta meta;
+        meta.recv_ts_ns = host_mono_raw_ns();
+        meta.frame_id = frame->frameID;
+        meta.cam_ts = frame->timestamp;
+        meta.host_ts_ns = self->clock_sync.to_host_ns(frame->timestamp);
+        meta.status = frame->receiveStatus;
+        if (meta.host_ts_ns >= 0)
+            self->delivery_latency.add((meta.recv_ts_ns - meta.host_ts_ns) / 1000);
+        if (self->seq_step >= 0)
+        {
+            bool settling = false;
+            bool pass_done = self->advance_sequence(meta, settling);
+            if (self->hdr != nullptr)
+            {
+                if (frame->receiveStatus == VmbFrameStatusComplete && !settling)
+                    self->hdr->add(frame, meta.exposure_us);
+                if (pass_done)
+                    self->hdr->finish(meta.seq_pass);
+            }
+        }
+        {
+            std::lock_guard<std::mutex> guard(self->meta_lock);
+            self->last_meta = meta;
+        }
+        if (self->ring_enabled.load(std::memory_order_relaxed))
+            self->frame_ring.push(meta);
+        if (self->adio_mode.load(std::memory_order_relaxed) == AdioMode::Frame && self->adio_hdl != nullptr && self->adio_bit >= 0)
         {
-            self->state = ~self->state;
-            WriteBit_aDIO(self->adio_hdl, 0, self->adio_bit, self->state);
+            unsigned char level = self->state.fetch_xor(1, std::memory_order_relaxed) ^ 1;
+            WriteBit_aDIO(self->adio_hdl, 0, self->adio_bit, level);
+        }
+        // seq_cst pairs with the exchange in set_frame_hook: a hook loaded
+        // here is counted before the setter looks at frame_hook_calls
+        self->frame_hook_calls.fetch_add(1);
+        const FrameHook *hook = self->frame_hook.load();
+        if (hook != nullptr)
+        {
+            capture_frame_t out;
+            out.buffer = frame->imageData != nullptr ? (const void *)frame->imageData : frame->buffer;
+            out.size = frame->bufferSize;
+            out.width = frame->width;
+            out.height = frame->height;
+            out.pixel_format = frame->pixelFormat;
+            out.status = frame->receiveStatus;
+            out.frame_id = meta.frame_id;
+            out.cam_ts = meta.cam_ts;
+            out.host_ts_ns = meta.host_ts_ns;
+            out.recv_ts_ns = meta.recv_ts_ns;
+            out.seq_step = meta.seq_step;
+            out.seq_pass = meta.seq_pass;
+            out.exposure_us = meta.exposure_us;
+            hook->cb(hook->cam_id, &out, hook->user);
+        }
+        self->frame_hook_calls.fetch_sub(1, std::memory_order_release);
+        if (self->events_registered)
+        {
+            int64_t tnow = zclock_usecs();
+            int idx = frame->frameID & (EXPOSURE_RING_LEN - 1);
+            if (self->exposure_end_id[idx].load(std::memory_order_acquire) == frame->frameID)
+            {
+                int64_t lag = tnow - self->exposure_end_us[idx].load(std::memory_order_relaxed);
+                self->lag_count++;
+                self->lag_sum_us += lag;
+                int64_t prev = self->lag_max_us.load(std::memory_order_relaxed);
+                while (lag > prev && !self->lag_max_us.compare_exchange_weak(prev, lag))
+                    ;
+            }
         }
 
         // self->stat.update();
         // self->img.update(frame);
+        self->consumer_latency.add(zclock_usecs() - tenter);
     }
 
-    void open_camera()
+    // frame path: tag the frame with its step and count it; a complete step
+    // asks poll() for the next exposure. Frames exposed before that write
+    // lands are settling, neither counted nor merged. Returns true on the
+    // last counted frame of a pass.
+    bool advance_sequence(FrameMeta &meta, bool &settling)
     {
-        std::string errmsg = "";
-        VmbError_t err = allied_open_camera(&handle, info.idstr.c_str(), 5);
-        if (err != VmbErrorSuccess)
+        if (seq_switch.load(std::memory_order_acquire) == SeqSwitch::Written)
         {
-            errmsg = "Could not open camera: " + std::string(allied_strerr(err));
-            dbprintlf(FATAL "%s", errmsg.c_str());
-            return;
+            seq_step = seq_next_step;
+            seq_pass = seq_next_pass;
+            seq_left = sequence[seq_step].frames;
+            seq_settled = false;
+            seq_switch.store(SeqSwitch::None, std::memory_order_relaxed);
         }
-        CharContainer *triglines = nullptr;
-        CharContainer *trigsrcs = nullptr;
-        char *key = nullptr;
-        char **arr = nullptr;
-        VmbUint32_t narr = 0;
-        err = allied_get_trigline(handle, (const char **)&key);
-        if (err == VmbErrorSuccess)
+        meta.seq_pass = seq_pass;
+        if (seq_switch.load(std::memory_order_relaxed) == SeqSwitch::Requested)
         {
-            err = allied_get_triglines_list(handle, &arr, NULL, &narr);
-            if (err == VmbErrorSuccess)
+            // surplus frames of the finished step, still at its exposure
+            meta.seq_step = seq_step;
+            meta.exposure_us = sequence[seq_step].exposure_us;
+            settling = true;
+            return false;
+        }
+        if (!seq_settled)
+        {
+            // by timestamp once the clock model is up, else past every frame
+            // that could have been in flight at the write
+            if (meta.host_ts_ns >= 0 ? meta.host_ts_ns >= seq_settle_ns : meta.frame_id > seq_write_id + frame_buffers)
+                seq_settled = true;
+            else
             {
-                triglines = new CharContainer((const char **)arr, narr, (const char *)key);
-                free(arr);
-                narr = 0;
+                settling = true; // exposure unknown, left untagged
+                return false;
             }
-            else
+        }
+        meta.seq_step = seq_step;
+        meta.exposure_us = sequence[seq_step].exposure_us;
+        if (--seq_left > 0)
+            return false;
+        bool pass_done = seq_step + 1 >= (int32_t)sequence.size();
+        seq_next_step = pass_done ? 0 : seq_step + 1;
+        seq_next_pass = pass_done ? seq_pass + 1 : seq_pass;
+        if (pass_done && seq_repeats > 0 && seq_next_pass >= seq_repeats)
+            seq_next_step = -1;
+        else if (sequence.size() == 1)
+        {
+            // same exposure again, nothing to write
+            seq_pass = seq_next_pass;
+            seq_left = sequence[0].frames;
+            return pass_done;
+        }
+        seq_switch.store(SeqSwitch::Requested, std::memory_order_release);
+        return pass_done;
+    }
+
+    static void ExposureEventCallback(const VmbHandle_t handle, const char *name, void *user_data)
+    {
+        assert(user_data);
+
+        ImageCam *self = (ImageCam *)user_data;
+        bool start = strcmp(name, "EventExposureStart") == 0;
+        // drive the line first, bookkeeping comes after
+        if (self->adio_mode.load(std::memory_order_relaxed) == AdioMode::Exposure && self->adio_hdl != nullptr && self->adio_bit >= 0)
+        {
+            unsigned char level = start ? 1 : 0;
+            self->state.store(level, std::memory_order_relaxed);
+            WriteBit_aDIO(self->adio_hdl, 0, self->adio_bit, level);
+        }
+        if (!start)
+        {
+            int64_t tnow = zclock_usecs();
+            VmbInt64_t frame_id = 0;
+            if (VmbFeatureIntGet(handle, "EventExposureEndFrameID", &frame_id) == VmbErrorSuccess)
             {
-                dbprintlf("Could not get trigger lines list: %s", allied_strerr(err));
+                int idx = frame_id & (EXPOSURE_RING_LEN - 1);
+                self->exposure_end_us[idx].store(tnow, std::memory_order_relaxed);
+                self->exposure_end_id[idx].store(frame_id, std::memory_order_release);
             }
         }
-        else
+    }
+
+    VmbError_t register_exposure_events()
+    {
+        if (events_registered)
+            return VmbErrorSuccess;
+        VmbHandle_t vmb = vmb_handle();
+        const char *events[] = {"ExposureStart", "ExposureEnd"};
+        VmbError_t err = VmbErrorSuccess;
+        for (const char *event : events)
         {
-            dbprintlf("Could not get selected trigger line: %s", allied_strerr(err));
+            err = VmbFeatureEnumSet(vmb, "EventSelector", event);
+            if (err != VmbErrorSuccess)
+            {
+                dbprintlf("Could not select event %s: %s", event, allied_strerr(err));
+                return err;
+            }
+            err = VmbFeatureEnumSet(vmb, "EventNotification", "On");
+            if (err != VmbErrorSuccess)
+            {
+                dbprintlf("Could not enable event %s: %s", event, allied_strerr(err));
+                return err;
+            }
+        }
+        err = VmbFeatureInvalidationRegister(vmb, "EventExposureStart", &ExposureEventCallback, (void *)this);
+        if (err != VmbErrorSuccess)
+        {
+            dbprintlf("Could not register ExposureStart callback: %s", allied_strerr(err));
+            return err;
+        }
+        err = VmbFeatureInvalidationRegister(vmb, "EventExposureEnd", &ExposureEventCallback, (void *)this);
+        if (err != VmbErrorSuccess)
+        {
+            dbprintlf("Could not register ExposureEnd callback: %s", allied_strerr(err));
+            VmbFeatureInvalidationUnregister(vmb, "EventExposureStart", &ExposureEventCallback);
+            return err;
+        }
+        events_registered = true;
+        return err;
+    }
+
+    void unregister_exposure_events()
+    {
+        if (!events_registered)
+            return;
+        VmbHandle_t vmb = vmb_handle();
+        VmbFeatureInvalidationUnregister(vmb, "EventExposureStart", &ExposureEventCallback);
+        VmbFeatureInvalidationUnregister(vmb, "EventExposureEnd", &ExposureEventCallback);
+        const char *events[] = {"ExposureStart", "ExposureEnd"};
+        for (const char *event : events)
+        {
+            if (VmbFeatureEnumSet(vmb, "EventSelector", event) == VmbErrorSuccess)
+                VmbFeatureEnumSet(vmb, "EventNotification", "Off");
+        }
+        events_registered = false;
+    }
+
+    AdioMode get_adio_mode() const
+    {
+        return adio_mode.load();
+    }
+
+    VmbError_t set_adio_mode(AdioMode mode)
+    {
+        VmbError_t err = VmbErrorSuccess;
+        // events stay registered in frame mode as well so the lag can be compared
+        if (mode == AdioMode::Exposure)
+            err = register_exposure_events();
+        if (err != VmbErrorSuccess)
+            return err;
+        adio_mode = mode;
+        reset_adio_lag();
+        if (adio_hdl != nullptr && adio_bit >= 0)
+        {
+            this->state = 0;
+            WriteBit_aDIO(adio_hdl, 0, adio_bit, 0);
         }
-        if (triglines != nullptr)
+        return err;
+    }
+
+    void reset_adio_lag()
+    {
+        for (int i = 0; i < EXPOSURE_RING_LEN; i++)
         {
+            exposure_end_id[i] = UINT64_MAX;
+            exposure_end_us[i] = 0;
+        }
+        lag_count = 0;
+        lag_sum_us = 0;
+        lag_max_us = 0;
+    }
+
+    // number of samples, mean and max delay (us) of the frame callback behind exposure end
+    void get_adio_lag(uint64_t &count, double &mean_us, int64_t &max_us) const
+    {
+        count = lag_count;
+        mean_us = count > 0 ? (double)lag_sum_us / count : 0;
+        max_us = lag_max_us;
+    }
+
+    void open_camera()
+    {
+        std::string errmsg = "";
+        VmbError_t err = allied_open_camera(&handle, info.idstr.c_str(), frame_buffers);
+        if (err != VmbErrorSuccess)
+        {
+            errmsg = "Could not open camera: " + std::string(allied_strerr(err));
+            dbprintlf(FATAL "%s", errmsg.c_str());
+            return;
+        }
+        load_capabilities();
+        const char *key = nullptr;
+        err = allied_get_trigline(handle, &key);
+        if (err == VmbErrorSuccess)
+        {
+            std::string selected = key;
             // set all trigger lines to output
-            for (int i = 0; i < triglines->narr; i++)
+            for (const std::string &line : caps->triglines)
             {
-                char *line = triglines->arr[i];
-                err = allied_set_trigline(handle, line);
+                err = allied_set_trigline(handle, line.c_str());
                 if (err != VmbErrorSuccess)
                 {
-                    dbprintlf("Could not select line %s: %s", line, allied_strerr(err));
+                    dbprintlf("Could not select line %s: %s", line.c_str(), allied_strerr(err));
                 }
                 else
                 {
                     err = allied_set_trigline_mode(handle, "Output");
                     if (err != VmbErrorSuccess)
-                        dbprintlf("Could not set line %s to output: %s", line, allied_strerr(err));
+                        dbprintlf("Could not set line %s to output: %s", line.c_str(), allied_strerr(err));
                 }
             }
-            err = allied_set_trigline(handle, key);
+            err = allied_set_trigline(handle, selected.c_str());
             if (err != VmbErrorSuccess)
-                dbprintlf("Could not select line %s: %s", key, allied_strerr(err));
-            // get trigger source
-            err = allied_get_trigline_src(handle, (const char **)&key);
+                dbprintlf("Could not select line %s: %s", selected.c_str(), allied_strerr(err));
+        }
+        else
+        {
+            dbprintlf("Could not get selected trigger line: %s", allied_strerr(err));
+        }
+        feature_cache.invalidate_all();
+        opened = true;
+        // cleanup() dropped the events and the line state, set them up as the constructor does
+        if (register_exposure_events() != VmbErrorSuccess)
+        {
+            dbprintlf("Exposure events not available on %s.", info.idstr.c_str());
+            if (adio_mode == AdioMode::Exposure)
+                adio_mode = AdioMode::Frame; // nothing to drive the line from
+        }
+        reset_adio_lag();
+        if (adio_hdl != nullptr && adio_bit >= 0)
+        {
+            this->state = 0;
+            WriteBit_aDIO(adio_hdl, 0, adio_bit, 0);
+        }
+        start_clock_sync(); // stopped by cleanup(), the model starts over from new samples
+        feature_watch.track_cache(vmb_handle());
+        tune_gige_stream();
+        feature_map.build(vmb_handle(), stream_handle());
+        // std::cout << "Opened!" << std::endl;
+    }
+
+    void start_clock_sync(int period_ms = 1000)
+    {
+        if (sync_thread.joinable())
+            return;
+        VmbHandle_t vmb = vmb_handle();
+        VmbFeatureInfo_t finfo;
+        // SFNC names first, then the older GigE Vision ones
+        if (VmbFeatureInfoQuery(vmb, "TimestampLatch", &finfo, sizeof(finfo)) == VmbErrorSuccess)
+        {
+            latch_cmd = "TimestampLatch";
+            latch_val = "TimestampLatchValue";
+        }
+        else if (VmbFeatureInfoQuery(vmb, "GevTimestampControlLatch", &finfo, sizeof(finfo)) == VmbErrorSuccess)
+        {
+            latch_cmd = "GevTimestampControlLatch";
+            latch_val = "GevTimestampValue";
+        }
+        else
+        {
+            dbprintlf("Camera %s does not support timestamp latching, host timestamps disabled.", info.idstr.c_str());
+            return;
+        }
+        double tick_ns = 1.0;
+        VmbInt64_t freq = 0;
+        if (VmbFeatureIntGet(vmb, "GevTimestampTickFrequency", &freq) == VmbErrorSuccess && freq > 0)
+            tick_ns = 1e9 / freq;
+        clock_sync.reset(tick_ns);
+        sync_quit = false;
+        sync_thread = std::thread([this, period_ms]()
+                                  {
+            std::unique_lock<std::mutex> lk(sync_lock);
+            while (!sync_quit)
+            {
+                lk.unlock();
+                latch_clock();
+                lk.lock();
+                sync_cv.wait_for(lk, std::chrono::milliseconds(period_ms), [this]()
+                                 { return sync_quit; });
+            } });
+    }
+
+    void stop_clock_sync()
+    {
+        if (!sync_thread.joinable())
+            return;
+        {
+            std::lock_guard<std::mutex> guard(sync_lock);
+            sync_quit = true;
+        }
+        sync_cv.notify_all();
+        sync_thread.join();
+    }
+
+    VmbError_t latch_clock()
+    {
+        VmbHandle_t vmb = vmb_handle();
+        int64_t t0 = host_mono_raw_ns();
+        VmbError_t err = VmbFeatureCommandRun(vmb, latch_cmd);
+        int64_t t1 = host_mono_raw_ns();
+        if (err != VmbErrorSuccess)
+            return err;
+        VmbInt64_t ticks = 0;
+        err = VmbFeatureIntGet(vmb, latch_val, &ticks);
+        if (err != VmbErrorSuccess)
+            return err;
+        // the latch happened somewhere inside [t0, t1]
+        clock_sync.add_sample(ticks, t0 + (t1 - t0) / 2, t1 - t0);
+        return err;
+    }
+
+    const ClockSync &get_clock_sync() const
+    {
+        return clock_sync;
+    }
+
+    FrameMeta get_last_meta()
+    {
+        std::lock_guard<std::mutex> guard(meta_lock);
+        return last_meta;
+    }
+
+    // first stream handle of the camera, nullptr if there is none
+    VmbHandle_t stream_handle() const
+    {
+        VmbCameraInfo_t cinfo;
+        if (VmbCameraInfoQueryByHandle(vmb_handle(), &cinfo, sizeof(cinfo)) == VmbErrorSuccess && cinfo.streamCount > 0)
+            return cinfo.streamHandles[0];
+        return nullptr;
+    }
+
+    // module owning a transport feature: the stream (VmbC) or the camera (older transport layers)
+    VmbHandle_t feature_owner(const char *name) const
+    {
+        VmbFeatureInfo_t finfo;
+        VmbHandle_t stream = stream_handle();
+        if (stream != nullptr && VmbFeatureInfoQuery(stream, name, &finfo, sizeof(finfo)) == VmbErrorSuccess)
+            return stream;
+        if (VmbFeatureInfoQuery(vmb_handle(), name, &finfo, sizeof(finfo)) == VmbErrorSuccess)
+            return vmb_handle();
+        return nullptr;
+    }
+
+    /**
+     * @brief Negotiate the largest GVSP packet size the path to the host
+     * allows, then check the NIC MTU and socket receive buffer limit.
+     * No-op for non-GigE cameras.
+     */
+    VmbError_t tune_gige_stream()
+    {
+        VmbInt64_t ip = 0;
+        if (VmbFeatureIntGet(vmb_handle(), "GevCurrentIPAddress", &ip) != VmbErrorSuccess)
+        {
+            gige.gige = false;
+            return VmbErrorNotSupported;
+        }
+        gige.gige = true;
+        VmbError_t err = VmbErrorNotFound;
+        VmbHandle_t owner = feature_owner("GVSPPacketSize");
+        if (owner != nullptr)
+        {
+            VmbInt64_t psize = -1;
+            VmbFeatureIntGet(owner, "GVSPPacketSize", &psize);
+            gige.packet_size_before = psize;
+            err = VmbFeatureCommandRun(owner, "GVSPAdjustPacketSize");
             if (err == VmbErrorSuccess)
             {
-                err = allied_get_trigline_src_list(handle, &arr, NULL, &narr);
-                if (err == VmbErrorSuccess)
+                VmbBool_t done = VmbBoolFalse;
+                for (int i = 0; i < 200 && !done; i++) // up to 2 s
                 {
-                    trigsrcs = new CharContainer((const char **)arr, narr, (const char *)key);
-                    free(arr);
-                    narr = 0;
-                }
-                else
-                {
-                    dbprintlf("Could not get trigger sources list: %s", allied_strerr(err));
+                    if (VmbFeatureCommandIsDone(owner, "GVSPAdjustPacketSize", &done) != VmbErrorSuccess)
+                        break;
+                    if (!done)
+                        std::this_thread::sleep_for(std::chrono::milliseconds(10));
                 }
             }
+            else
+            {
+                dbprintlf("Camera %s: packet size adjustment failed: %s", info.idstr.c_str(), allied_strerr(err));
+            }
+            VmbFeatureIntGet(owner, "GVSPPacketSize", &psize);
+            gige.packet_size = psize;
         }
-        delete triglines;
-        delete trigsrcs;
-        opened = true;
-        // std::cout << "Opened!" << std::endl;
+        gige_probe_host(gige, (uint32_t)ip);
+        gige_check_host(gige, allied_get_frame_size(handle));
+        dbprintlf("Camera %s: packet size %ld -> %ld, NIC %s MTU %ld, rmem_max %ld", info.idstr.c_str(),
+                  gige.packet_size_before, gige.packet_size, gige.nic.c_str(), gige.nic_mtu, gige.rmem_max);
+        for (auto &warning : gige.warnings)
+            dbprintlf(YELLOW_FG "Camera %s: %s", info.idstr.c_str(), warning.c_str());
+        return err;
+    }
+
+    const GigETuneReport &get_gige_report() const
+    {
+        return gige;
+    }
+
+    /**
+     * @brief Read the transport layer stream statistics. The counters live on
+     * the stream module (VmbC) or on the camera (older transport layers);
+     * cameras without them (e.g. USB) are probed once and skipped afterwards.
+     *
+     * @return true if the counters are available.
+     */
+    bool poll_stream_stats()
+    {
+        if (!stats_probed)
+        {
+            stats_probed = true;
+            stats_handle = feature_owner("StatFrameDelivered");
+        }
+        if (stats_handle == nullptr)
+            return false;
+        StreamStats cur;
+        cur.available = true;
+        struct
+        {
+            const char *name;
+            VmbInt64_t *value;
+        } counters[] = {
+            {"StatFrameDelivered", &cur.frames_delivered},
+            {"StatFrameDropped", &cur.frames_dropped},
+            {"StatFrameUnderrun", &cur.frames_underrun},
+            {"StatPacketReceived", &cur.packets_received},
+            {"StatPacketMissed", &cur.packets_missed},
+            {"StatPacketResent", &cur.packets_resent},
+            {"StatPacketRequested", &cur.packets_requested},
+        };
+        for (auto &counter : counters)
+        {
+            if (VmbFeatureIntGet(stats_handle, counter.name, counter.value) != VmbErrorSuccess)
+                *counter.value = 0;
+        }
+        std::lock_guard<std::mutex> guard(stats_lock);
+        stream_stats_prev = stream_stats;
+        stream_stats = cur;
+        return true;
+    }
+
+    // latest counters and their change since the previous poll
+    void get_stream_stats(StreamStats &cur, StreamStats &delta)
+    {
+        std::lock_guard<std::mutex> guard(stats_lock);
+        cur = stream_stats;
+        delta.available = stream_stats.available && stream_stats_prev.available;
+        delta.frames_delivered = stream_stats.frames_delivered - stream_stats_prev.frames_delivered;
+        delta.frames_dropped = stream_stats.frames_dropped - stream_stats_prev.frames_dropped;
+        delta.frames_underrun = stream_stats.frames_underrun - stream_stats_prev.frames_underrun;
+        delta.packets_received = stream_stats.packets_received - stream_stats_prev.packets_received;
+        delta.packets_missed = stream_stats.packets_missed - stream_stats_prev.packets_missed;
+        delta.packets_resent = stream_stats.packets_resent - stream_stats_prev.packets_resent;
+        delta.packets_requested = stream_stats.packets_requested - stream_stats_prev.packets_requested;
+    }
+
+    void enable_frame_ring(bool enable)
+    {
+        ring_enabled = enable;
+    }
+
+    /**
+     * @brief Call cb from the frame callback for every frame, nullptr to
+     * remove; cam_id is passed through.
+     *
+     * cb, user and cam_id are published together. Returns once no frame
+     * callback still runs the previous hook, so its user data may be freed;
+     * must not be called from the hook itself.
+     */
+    void set_frame_hook(capture_frame_cb_t cb, void *user, uint32_t cam_id)
+    {
+        const FrameHook *hook = cb != nullptr ? new FrameHook{cb, user, cam_id} : nullptr;
+        const FrameHook *old = frame_hook.exchange(hook);
+        while (frame_hook_calls.load(std::memory_order_acquire) > 0)
+            std::this_thread::yield();
+        delete old;
+    }
+
+    FrameRing<FrameMeta, 256> &get_frame_ring()
+    {
+        return frame_ring;
     }
 
     void cleanup()
     {
+        stop_clock_sync();
         if (opened)
         {
             allied_stop_capture(handle);  // just stop capture...
+            unregister_exposure_events();
+            feature_watch.unwatch_all();
+            feature_watch.untrack_cache();
             allied_close_camera(&handle); // close the camera
             opened = false;
         }
@@ -307,37 +955,94 @@ public:
 
     VmbError_t start_capture()
     {
+        std::lock_guard<std::mutex> guard(capture_lock);
         VmbError_t err = VmbErrorSuccess;
         frames = 0;
         if (handle != nullptr && !capturing)
         {
+            if (sequence.size() > 0)
+            {
+                seq_step = 0;
+                seq_pass = 0;
+                seq_left = sequence[0].frames;
+                seq_settled = true; // set before the start, the first frame has it
+                seq_switch = SeqSwitch::None;
+                seq_done = false;
+                err = allied_set_exposure_us(handle, sequence[0].exposure_us);
+                feature_cache.invalidate_all();
+                if (err != VmbErrorSuccess)
+                {
+                    seq_step = -1;
+                    sequence.clear(); // one-shot even if it never ran
+                    return err;
+                }
+                VmbInt64_t width, height;
+                if (hdr != nullptr && allied_get_image_size(handle, &width, &height) == VmbErrorSuccess)
+                    hdr->prepare((uint32_t)width, (uint32_t)height);
+            }
+            double fps = 0;
+            if (allied_get_acq_framerate(handle, &fps) == VmbErrorSuccess && fps > 0)
+                frame_period_ms = 1000.0 / fps;
+            else
+                frame_period_ms = 1000;
+            for (auto &step : sequence) // longest step bounds the frame period
+                frame_period_ms = std::max(frame_period_ms, step.exposure_us * 1e-3);
+            uint32_t depth = choose_buffer_depth(1000.0 / frame_period_ms, allied_get_frame_size(handle));
+            if (depth != frame_buffers)
+            {
+                VmbError_t rerr = allied_realloc_framebuffer(handle, depth);
+                if (rerr == VmbErrorSuccess)
+                    frame_buffers = depth;
+                else
+                    dbprintlf("Could not resize frame buffers %u -> %u: %s", frame_buffers, depth, allied_strerr(rerr));
+            }
             err = allied_start_capture(handle, &Callback, (void *)this); // set the callback here
         }
         if (err == VmbErrorSuccess)
         {
+            struct timespec ts;
+            clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+            cpu_start_ns = (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
             capture_start_time = zclock_mono();
+            last_frame_ms = capture_start_time;
+            stalled = false;
             capturing = true;
         }
         else
         {
             capture_start_time = -1;
+            seq_step = -1;
+            sequence.clear(); // one-shot even if it never ran
         }
         return err;
     }
 
     VmbError_t stop_capture()
     {
+        std::lock_guard<std::mutex> guard(capture_lock);
         VmbError_t err = VmbErrorSuccess;
         if (handle != nullptr && capturing)
         {
             err = allied_stop_capture(handle);
+            if (cpu_start_ns >= 0 && frames > 0)
+            {
+                // process wide, so includes the transport layer receive threads
+                struct timespec ts;
+                clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+                int64_t cpu_ns = (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec - cpu_start_ns;
+                gige.cpu_us_per_frame = cpu_ns * 1e-3 / frames;
+            }
+            cpu_start_ns = -1;
             if (adio_hdl != nullptr && adio_bit >= 0)
             {
                 this->state = 0;
-                WriteBit_aDIO(adio_hdl, 0, adio_bit, this->state);
+                WriteBit_aDIO(adio_hdl, 0, adio_bit, 0);
             }
         }
         capturing = false;
+        stalled = false;
+        seq_step = -1;
+        sequence.clear(); // one-shot, a plain start_capture runs without it
         capture_start_time = -1;
         return err;
     }
@@ -346,4 +1051,383 @@ public:
     {
         return frames;
     }
+
+    /**
+     * @brief Load an exposure sequence, applied by the frame path during the
+     * next capture. Cleared when that capture stops or fails to start.
+     *
+     * @param steps (exposure, frame count) steps, empty to clear the sequence.
+     * @param repeats Passes through the steps, 0 to repeat until stopped.
+     * @return VmbError_t VmbErrorBusy while capturing.
+     */
+    VmbError_t set_sequence(const std::vector<SeqStep> &steps, uint32_t repeats)
+    {
+        std::lock_guard<std::mutex> guard(capture_lock);
+        if (capturing)
+            return VmbErrorBusy;
+        for (auto &step : steps)
+        {
+            if (step.frames == 0 || step.exposure_us <= 0)
+                return VmbErrorInvalidValue;
+        }
+        sequence = steps;
+        seq_repeats = repeats;
+        seq_step = -1;
+        seq_done = false;
+        return VmbErrorSuccess;
+    }
+
+    /**
+     * @brief Merge each exposure sequence pass into one radiance image
+     * written to the given directory. An empty directory disables merging.
+     * Frames exposed before an exposure switch took effect are left out and
+     * do not count towards their step.
+     *
+     * @return VmbError_t VmbErrorBusy while capturing.
+     */
+    VmbError_t set_hdr_output(const std::string &dir)
+    {
+        std::lock_guard<std::mutex> guard(capture_lock);
+        if (capturing)
+            return VmbErrorBusy;
+        delete hdr;
+        hdr = nullptr;
+        if (dir != "")
+            hdr = new HdrMerge(dir, info.serial != "" ? info.serial : info.idstr);
+        return VmbErrorSuccess;
+    }
+
+    std::string get_hdr_output() const
+    {
+        return hdr != nullptr ? hdr->get_outdir() : "";
+    }
+
+    void get_hdr_stats(uint64_t &nwritten, uint64_t &ndropped) const
+    {
+        nwritten = ndropped = 0;
+        if (hdr != nullptr)
+            hdr->get_stats(nwritten, ndropped);
+    }
+
+    // model and the settings the exposure / frame rate envelope depends on
+    std::string envelope_key() const
+    {
+        const char *fmt = "None";
+        VmbInt64_t width = 0, height = 0, tlim = 0;
+        allied_get_image_format(handle, &fmt);
+        allied_get_image_size(handle, &width, &height);
+        allied_get_throughput_limit(handle, &tlim);
+        return info.model + "|" + std::to_string(width) + "x" + std::to_string(height) + "|" + fmt + "|" + std::to_string(tlim);
+    }
+
+    /**
+     * @brief Sample the shortest frame period over a logarithmic exposure
+     * grid. Exposure is restored afterwards.
+     *
+     * @return VmbError_t VmbErrorBusy while capturing.
+     */
+    VmbError_t sweep_envelope(Envelope &env, int npoints = 32)
+    {
+        std::lock_guard<std::mutex> guard(capture_lock);
+        if (capturing)
+            return VmbErrorBusy;
+        VmbHandle_t vmb = vmb_handle();
+        double emin = 0, emax = 0;
+        VmbError_t err = VmbFeatureFloatRangeQuery(vmb, "ExposureTime", &emin, &emax);
+        if (err != VmbErrorSuccess)
+            return err;
+        if (emin <= 0)
+            emin = 1;
+        if (emax > 1e7) // beyond 10 s the frame period is exposure bound anyway
+            emax = 1e7;
+        double saved = 0;
+        err = allied_get_exposure_us(handle, &saved);
+        if (err != VmbErrorSuccess)
+            return err;
+        // long exposures make the camera clamp the frame rate, restored below
+        // along with its enable and auto state where the camera has them
+        double saved_fps = 0;
+        VmbBool_t saved_fps_auto = VmbBoolFalse, saved_fps_enable = VmbBoolFalse;
+        bool have_fps = allied_get_acq_framerate(handle, &saved_fps) == VmbErrorSuccess;
+        bool have_fps_auto = allied_get_acq_framerate_auto(handle, &saved_fps_auto) == VmbErrorSuccess;
+        bool have_fps_enable = VmbFeatureBoolGet(vmb, "AcquisitionFrameRateEnable", &saved_fps_enable) == VmbErrorSuccess;
+        env.exposure_us.clear();
+        env.period_us.clear();
+        for (int i = 0; i < npoints; i++)
+        {
+            double exposure = emin * pow(emax / emin, (double)i / (npoints - 1));
+            double fmin = 0, fmax = 0;
+            if (allied_set_exposure_us(handle, exposure) != VmbErrorSuccess ||
+                allied_get_exposure_us(handle, &exposure) != VmbErrorSuccess ||
+                VmbFeatureFloatRangeQuery(vmb, "AcquisitionFrameRate", &fmin, &fmax) != VmbErrorSuccess || fmax <= 0)
+                continue;
+            double period = 1e6 / fmax;
+            if (!env.exposure_us.empty())
+            {
+                if (exposure <= env.exposure_us.back())
+                    continue;
+                if (period < env.period_us.back()) // keep the table monotonic
+                    period = env.period_us.back();
+            }
+            env.exposure_us.push_back(exposure);
+            env.period_us.push_back(period);
+        }
+        allied_set_exposure_us(handle, saved);
+        if (have_fps_enable)
+            VmbFeatureBoolSet(vmb, "AcquisitionFrameRateEnable", saved_fps_enable);
+        if (have_fps_auto)
+            allied_set_acq_framerate_auto(handle, saved_fps_auto);
+        if (have_fps && !(have_fps_auto && saved_fps_auto))
+        {
+            VmbError_t ferr = allied_set_acq_framerate(handle, saved_fps);
+            if (ferr != VmbErrorSuccess)
+                dbprintlf("Camera %s: could not restore frame rate %.3f after the sweep: %s", info.idstr.c_str(), saved_fps, allied_strerr(ferr));
+        }
+        feature_cache.invalidate_all();
+        return env.exposure_us.size() >= 2 ? VmbErrorSuccess : VmbErrorNoData;
+    }
+
+    /**
+     * @brief Apply the sequence step the frame path asked for: write the next
+     * exposure, or halt the camera after the last pass. Called from the
+     * server loop so feature writes stay off the frame thread.
+     *
+     * @return true if the sequence moved on.
+     */
+    bool poll_sequence()
+    {
+        if (seq_done || seq_switch.load(std::memory_order_acquire) != SeqSwitch::Requested)
+            return false;
+        std::unique_lock<std::mutex> guard(capture_lock, std::try_to_lock);
+        if (!guard.owns_lock() || !capturing) // stop or stream restart under way, next poll
+            return false;
+        if (seq_next_step < 0)
+        {
+            // halt the camera now so no frame is taken at the last exposure;
+            // the stream itself is torn down by the caller
+            VmbError_t err = VmbFeatureCommandRun(vmb_handle(), "AcquisitionStop");
+            if (err != VmbErrorSuccess)
+                dbprintlf("Camera %s: sequence done, AcquisitionStop: %s", info.idstr.c_str(), allied_strerr(err));
+            seq_done = true;
+            return true;
+        }
+        uint64_t last_id;
+        {
+            std::lock_guard<std::mutex> mguard(meta_lock);
+            last_id = last_meta.frame_id;
+        }
+        // the camera timestamp may mark either end of the exposure
+        double settle_us = std::max(sequence[seq_step].exposure_us, sequence[seq_next_step].exposure_us);
+        VmbError_t err = allied_set_exposure_us(handle, sequence[seq_next_step].exposure_us);
+        feature_cache.invalidate_all();
+        if (err != VmbErrorSuccess)
+            dbprintlf("Camera %s: sequence step %d exposure: %s", info.idstr.c_str(), seq_next_step, allied_strerr(err));
+        seq_write_id = last_id;
+        seq_settle_ns = host_mono_raw_ns() + (int64_t)(settle_us * 1000);
+        seq_switch.store(SeqSwitch::Written, std::memory_order_release);
+        return true;
+    }
+
+    // sequence finished its last pass, capture can be stopped
+    bool sequence_done() const
+    {
+        return seq_done;
+    }
+
+    size_t sequence_length() const
+    {
+        return sequence.size();
+    }
+
+    /**
+     * @brief Number of frame buffers to announce for a given rate and frame size.
+     *
+     * A buffer is held by the driver from the camera timestamp until the
+     * callback returns it. Enough buffers to cover the frames in flight over
+     * the 99th percentile of that time, delivery plus callback, so delivery
+     * jitter is included (two frame periods of delivery assumed before the
+     * clock model has placed any frames), plus one being exposed and one
+     * spare. Clamped to [3, 64] and to the buffer memory budget.
+     */
+    uint32_t choose_buffer_depth(double fps, uint32_t fsize) const
+    {
+        int64_t delivery_us = delivery_latency.percentile(99);
+        if (delivery_us < 0)
+            delivery_us = fps > 0 ? (int64_t)(2e6 / fps) : 0;
+        int64_t callback_us = consumer_latency.percentile(99);
+        if (callback_us < 0)
+            callback_us = 2000;
+        uint64_t depth = (uint64_t)ceil(fps * (delivery_us + callback_us) * 1e-6) + 2;
+        if (depth > 64)
+            depth = 64;
+        if (fsize > 0 && depth * fsize > buffer_budget)
+            depth = buffer_budget / fsize;
+        if (depth < 3)
+            depth = 3;
+        return (uint32_t)depth;
+    }
+
+    void set_buffer_budget(uint64_t bytes)
+    {
+        buffer_budget = bytes;
+    }
+
+    // announced buffers, bytes committed, callback latency p50 and p99 (us)
+    void get_buffer_stats(uint32_t &depth, uint64_t &bytes, int64_t &p50_us, int64_t &p99_us) const
+    {
+        depth = frame_buffers;
+        bytes = (uint64_t)frame_buffers * allied_get_frame_size(handle);
+        p50_us = consumer_latency.percentile(50);
+        p99_us = consumer_latency.percentile(99);
+    }
+
+    // camera timestamp to callback entry p50 and p99 (us), -1 before the clock model is ready
+    void get_delivery_latency(int64_t &p50_us, int64_t &p99_us) const
+    {
+        p50_us = delivery_latency.percentile(50);
+        p99_us = delivery_latency.percentile(99);
+    }
+
+    /**
+     * @brief Apply a batch of feature writes in one stop/apply/start cycle.
+     *
+     * The stream is stopped only if it is running. Frame buffers are
+     * reallocated only if the frame size changed, otherwise the announced
+     * buffers are reused.
+     *
+     * @param apply Performs the feature writes, its error aborts the batch (the stream is still restarted).
+     * @param downtime_us Time from stop to restart (or to the end of the writes if not capturing).
+     * @param realloc Set if the frame buffers had to be reallocated.
+     * @return VmbError_t First error encountered.
+     */
+    VmbError_t reconfigure(const std::function<VmbError_t()> &apply, int64_t &downtime_us, bool &realloc)
+    {
+        std::lock_guard<std::mutex> guard(capture_lock);
+        realloc = false;
+        uint32_t fsize = allied_get_frame_size(handle);
+        int64_t tstart = zclock_usecs();
+        bool restart = capturing;
+        VmbError_t err = VmbErrorSuccess;
+        if (restart)
+            err = allied_stop_capture(handle);
+        if (err == VmbErrorSuccess)
+            err = apply();
+        if (allied_get_frame_size(handle) != fsize)
+        {
+            realloc = true;
+            VmbError_t rerr = allied_realloc_framebuffer(handle, frame_buffers);
+            if (rerr != VmbErrorSuccess)
+            {
+                dbprintlf("Could not reallocate frame buffers: %s", allied_strerr(rerr));
+                if (err == VmbErrorSuccess)
+                    err = rerr;
+            }
+        }
+        if (restart)
+        {
+            VmbError_t serr = allied_start_capture(handle, &Callback, (void *)this);
+            if (serr != VmbErrorSuccess)
+            {
+                // stopped for good, same state as stop_capture leaves
+                capturing = false;
+                stalled = false;
+                capture_start_time = -1;
+                cpu_start_ns = -1;
+                seq_step = -1;
+                sequence.clear(); // the partial HDR pass is dropped by prepare() at the next start
+                if (adio_hdl != nullptr && adio_bit >= 0)
+                {
+                    this->state = 0;
+                    WriteBit_aDIO(adio_hdl, 0, adio_bit, 0);
+                }
+                if (err == VmbErrorSuccess)
+                    err = serr;
+            }
+            else
+            {
+                double fps = 0;
+                if (allied_get_acq_framerate(handle, &fps) == VmbErrorSuccess && fps > 0)
+                    frame_period_ms = 1000.0 / fps;
+                last_frame_ms = zclock_mono();
+            }
+        }
+        downtime_us = zclock_usecs() - tstart;
+        return err;
+    }
+
+    /**
+     * @brief Check whether frames are overdue by more than the given number of
+     * frame periods, and if so restart the stream on a separate thread.
+     * Never blocks.
+     *
+     * @param tnow zclock_mono() time.
+     * @param periods Frame periods to tolerate, 0 disables the watchdog.
+     * @return true if a stall was detected in this call.
+     */
+    bool check_stall(int64_t tnow, int periods)
+    {
+        if (periods <= 0 || !capturing || recovering)
+            return false;
+        int64_t timeout = (int64_t)(periods * frame_period_ms) + 100; // allow for callback jitter
+        if (tnow - last_frame_ms.load(std::memory_order_relaxed) < timeout)
+            return false;
+        stalled = true;
+        stalls++;
+        if (recovery_thread.joinable())
+            recovery_thread.join(); // finished, recovering is false
+        recovering = true;
+        recovery_thread = std::thread(&ImageCam::recover, this);
+        return true;
+    }
+
+    void recover()
+    {
+        {
+            std::lock_guard<std::mutex> guard(capture_lock);
+            if (capturing)
+            {
+                // frame buffers stay announced across the cycle
+                allied_stop_capture(handle);
+                VmbError_t err = allied_start_capture(handle, &Callback, (void *)this);
+                if (err == VmbErrorSuccess)
+                {
+                    recoveries++;
+                    stalled = false;
+                    dbprintlf("Camera %s: stream restarted after stall.", info.idstr.c_str());
+                }
+                else
+                {
+                    // the stream is gone: stopped the way stop_capture leaves
+                    // it, still flagged stalled until the next start
+                    recovery_failures++;
+                    capturing = false;
+                    capture_start_time = -1;
+                    cpu_start_ns = -1;
+                    seq_step = -1;
+                    sequence.clear();
+                    if (adio_hdl != nullptr && adio_bit >= 0)
+                    {
+                        this->state = 0;
+                        WriteBit_aDIO(adio_hdl, 0, adio_bit, 0);
+                    }
+                    dbprintlf("Camera %s: stream restart failed, capture stopped: %s", info.idstr.c_str(), allied_strerr(err));
+                }
+                // back off for another timeout before the next attempt
+                last_frame_ms = zclock_mono();
+            }
+        }
+        recovering = false;
+    }
+
+    bool is_stalled() const
+    {
+        return stalled;
+    }
+
+    void get_watchdog_stats(uint64_t &nstalls, uint64_t &nrecoveries, uint64_t &nfailures) const
+    {
+        nstalls = stalls;
+        nrecoveries = recoveries;
+        nfailures = recovery_failures;
+    }
 };
\ No newline at end of file
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+/**
+ * @brief Lock-free latency histogram with power of 2 microsecond buckets.
+ *
+ * Bucket i holds samples in [2^(i-1), 2^i) us, bucket 0 holds 0 us.
+ * Percentiles are reported as the upper edge of the bucket they fall in.
+ */
+class LatencyHist
+{
+    static const int NBUCKETS = 32;
+    std::atomic<uint64_t> buckets[NBUCKETS];
+    std::atomic<uint64_t> count;
+    std::atomic<int64_t> max_us;
+
+public:
+    LatencyHist()
+    {
+        reset();
+    }
+
+    void reset()
+    {
+        for (int i = 0; i < NBUCKETS; i++)
+            buckets[i] = 0;
+        count = 0;
+        max_us = 0;
+    }
+
+    void add(int64_t us)
+    {
+        if (us < 0)
+            us = 0;
+        int idx = us == 0 ? 0 : 64 - __builtin_clzll((uint64_t)us);
+        if (idx >= NBUCKETS)
+            idx = NBUCKETS - 1;
+        buckets[idx].fetch_add(1, std::memory_order_relaxed);
+        count.fetch_add(1, std::memory_order_relaxed);
+        int64_t prev = max_us.load(std::memory_order_relaxed);
+        while (us > prev && !max_us.compare_exchange_weak(prev, us))
+            ;
+    }
+
+    uint64_t samples() const
+    {
+        return count.load(std::memory_order_relaxed);
+    }
+
+    int64_t max() const
+    {
+        return max_us.load(std::memory_order_relaxed);
+    }
+
+    // upper bound (us) of the given percentile, -1 if empty
+    int64_t percentile(double pct) const
+    {
+        uint64_t total = 0;
+        uint64_t snap[NBUCKETS];
+        for (int i = 0; i < NBUCKETS; i++)
+        {
+            snap[i] = buckets[i].load(std::memory_order_relaxed);
+            total += snap[i];
+        }
+        if (total == 0)
+            return -1;
+        uint64_t target = (uint64_t)(pct / 100.0 * total);
+        if (target >= total)
+            target = total - 1;
+        uint64_t acc = 0;
+        for (int i = 0; i < NBUCKETS; i++)
+        {
+            acc += snap[i];
+            if (acc > target)
+                return i == 0 ? 0 : (1LL << i);
+        }
+        return max();
+    }
+};
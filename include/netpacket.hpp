@@ -0,0 +1,578 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <array>
+#include <charconv>
+#include "json.hpp"
+#include "alliedcam.h"
+#include "replyarena.hpp"
+
+using json = nlohmann::json;
+
+class NetPacket
+{
+public:
+    std::string cmd_type = "None";
+    std::string cam_id = "None";
+    int command = 0;
+    std::vector<std::string> arguments;
+    int retcode = VmbErrorSuccess;
+    std::vector<std::string> retargs;
+    // optional client request ID, echoed in the reply; retransmits reuse it
+    std::string req_id = "";
+    // optional, ms since the epoch after which the client no longer waits; 0: none
+    int64_t deadline = 0;
+
+    NLOHMANN_DEFINE_TYPE_INTRUSIVE(NetPacket, cmd_type, cam_id, command, arguments, retcode, retargs)
+};
+
+namespace std
+{
+    static inline std::string to_string(const NetPacket &p) noexcept
+    {
+        return json(p).dump();
+    }
+}
+
+/**
+ * @brief Streaming NetPacket decoder.
+ *
+ * Reads the request JSON in one pass and fills a reused NetPacket in place,
+ * so string and vector capacity carries over between requests. Unknown
+ * keys are skipped; retcode and retargs are ignored in requests, they are
+ * set by the server, and read in replies. Scalars in string arrays are
+ * kept as their JSON text.
+ */
+class NetPacketDecoder
+{
+    const char *p = nullptr;
+    const char *end = nullptr;
+    std::string key;
+
+    void skip_ws()
+    {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r'))
+            p++;
+    }
+
+    bool expect(char c)
+    {
+        skip_ws();
+        if (p >= end || *p != c)
+            return false;
+        p++;
+        return true;
+    }
+
+    static int hexval(char c)
+    {
+        if (c >= '0' && c <= '9')
+            return c - '0';
+        if (c >= 'a' && c <= 'f')
+            return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F')
+            return c - 'A' + 10;
+        return -1;
+    }
+
+    bool read_hex4(uint32_t &cp)
+    {
+        if (end - p < 4)
+            return false;
+        cp = 0;
+        for (int i = 0; i < 4; i++)
+        {
+            int v = hexval(p[i]);
+            if (v < 0)
+                return false;
+            cp = (cp << 4) | v;
+        }
+        p += 4;
+        return true;
+    }
+
+    static void append_utf8(std::string &out, uint32_t cp)
+    {
+        if (cp < 0x80)
+        {
+            out.push_back((char)cp);
+        }
+        else if (cp < 0x800)
+        {
+            out.push_back((char)(0xc0 | (cp >> 6)));
+            out.push_back((char)(0x80 | (cp & 0x3f)));
+        }
+        else if (cp < 0x10000)
+        {
+            out.push_back((char)(0xe0 | (cp >> 12)));
+            out.push_back((char)(0x80 | ((cp >> 6) & 0x3f)));
+            out.push_back((char)(0x80 | (cp & 0x3f)));
+        }
+        else
+        {
+            out.push_back((char)(0xf0 | (cp >> 18)));
+            out.push_back((char)(0x80 | ((cp >> 12) & 0x3f)));
+            out.push_back((char)(0x80 | ((cp >> 6) & 0x3f)));
+            out.push_back((char)(0x80 | (cp & 0x3f)));
+        }
+    }
+
+    // JSON string into out, reusing its capacity
+    bool read_string(std::string &out)
+    {
+        if (!expect('"'))
+            return false;
+        out.clear();
+        while (p < end)
+        {
+            const char *run = p;
+            while (p < end && *p != '"' && *p != '\\')
+                p++;
+            out.append(run, p - run);
+            if (p >= end)
+                return false;
+            if (*p++ == '"')
+                return true;
+            if (p >= end)
+                return false;
+            char esc = *p++;
+            switch (esc)
+            {
+            case '"':
+            case '\\':
+            case '/':
+                out.push_back(esc);
+                break;
+            case 'b':
+                out.push_back('\b');
+                break;
+            case 'f':
+                out.push_back('\f');
+                break;
+            case 'n':
+                out.push_back('\n');
+                break;
+            case 'r':
+                out.push_back('\r');
+                break;
+            case 't':
+                out.push_back('\t');
+                break;
+            case 'u':
+            {
+                uint32_t cp;
+                if (!read_hex4(cp))
+                    return false;
+                if (cp >= 0xd800 && cp < 0xdc00) // surrogate pair
+                {
+                    uint32_t lo;
+                    if (end - p < 6 || p[0] != '\\' || p[1] != 'u')
+                        return false;
+                    p += 2;
+                    if (!read_hex4(lo) || lo < 0xdc00 || lo >= 0xe000)
+                        return false;
+                    cp = 0x10000 + ((cp - 0xd800) << 10) + (lo - 0xdc00);
+                }
+                append_utf8(out, cp);
+                break;
+            }
+            default:
+                return false;
+            }
+        }
+        return false;
+    }
+
+    // number, true, false or null; text span in [start, p)
+    bool read_scalar(const char *&start)
+    {
+        skip_ws();
+        start = p;
+        while (p < end && *p != ',' && *p != ']' && *p != '}' && *p != ' ' && *p != '\t' && *p != '\n' && *p != '\r')
+            p++;
+        return p > start;
+    }
+
+    template <typename T>
+    bool read_int(T &val)
+    {
+        const char *start;
+        if (!read_scalar(start))
+            return false;
+        std::from_chars_result res = std::from_chars(start, p, val);
+        if (res.ec != std::errc())
+            return false;
+        if (res.ptr != p) // fraction or exponent
+        {
+            double dval;
+            if (std::from_chars(start, p, dval).ec != std::errc())
+                return false;
+            val = (T)dval;
+        }
+        return true;
+    }
+
+    // string, or the JSON text of a scalar
+    bool read_text(std::string &out)
+    {
+        skip_ws();
+        if (p < end && *p == '"')
+            return read_string(out);
+        const char *start;
+        if (!read_scalar(start))
+            return false;
+        out.assign(start, p - start);
+        return true;
+    }
+
+    // array of strings, existing elements are overwritten to keep their capacity
+    bool read_string_array(std::vector<std::string> &out)
+    {
+        if (!expect('['))
+            return false;
+        size_t n = 0;
+        skip_ws();
+        if (p < end && *p == ']')
+        {
+            p++;
+            out.resize(0);
+            return true;
+        }
+        while (true)
+        {
+            if (n == out.size())
+                out.emplace_back();
+            if (!read_text(out[n]))
+                return false;
+            n++;
+            skip_ws();
+            if (p >= end)
+                return false;
+            if (*p == ']')
+            {
+                p++;
+                break;
+            }
+            if (*p++ != ',')
+                return false;
+        }
+        out.resize(n);
+        return true;
+    }
+
+    bool skip_value()
+    {
+        skip_ws();
+        if (p >= end)
+            return false;
+        if (*p == '"')
+            return read_string(key);
+        if (*p != '[' && *p != '{')
+        {
+            const char *start;
+            return read_scalar(start);
+        }
+        int depth = 0;
+        while (p < end)
+        {
+            char c = *p;
+            if (c == '"')
+            {
+                if (!read_string(key))
+                    return false;
+                continue;
+            }
+            p++;
+            if (c == '[' || c == '{')
+                depth++;
+            else if ((c == ']' || c == '}') && --depth == 0)
+                return true;
+        }
+        return false;
+    }
+
+public:
+    /**
+     * @brief Decode a request, or a reply with its retcode and retargs. On
+     * failure the packet is left partially filled and must be rejected.
+     *
+     * @param reply Read retcode and retargs, as a broker does for backend replies.
+     * @return true Success.
+     */
+    bool decode(const char *data, size_t len, NetPacket &packet, bool reply = false)
+    {
+        p = data;
+        end = data + len;
+        packet.cmd_type = "None";
+        packet.cam_id = "None";
+        packet.command = 0;
+        packet.arguments.resize(0);
+        packet.retcode = VmbErrorSuccess;
+        packet.retargs.resize(0);
+        packet.req_id.clear();
+        packet.deadline = 0;
+        if (!expect('{'))
+            return false;
+        skip_ws();
+        if (p < end && *p == '}')
+            return true;
+        while (true)
+        {
+            if (!read_string(key) || !expect(':'))
+                return false;
+            bool ok;
+            if (key == "cmd_type")
+                ok = read_string(packet.cmd_type);
+            else if (key == "cam_id")
+                ok = read_string(packet.cam_id);
+            else if (key == "command")
+                ok = read_int(packet.command);
+            else if (key == "arguments")
+                ok = read_string_array(packet.arguments);
+            else if (key == "req_id")
+                ok = read_text(packet.req_id);
+            else if (key == "deadline")
+                ok = read_int(packet.deadline);
+            else if (reply && key == "retcode")
+                ok = read_int(packet.retcode);
+            else if (reply && key == "retargs")
+                ok = read_string_array(packet.retargs);
+            else
+                ok = skip_value();
+            if (!ok)
+                return false;
+            skip_ws();
+            if (p >= end)
+                return false;
+            if (*p == '}')
+                return true;
+            if (*p++ != ',')
+                return false;
+        }
+    }
+};
+
+static inline void netpacket_append_string(std::string &out, std::string_view str)
+{
+    static const char hex[] = "0123456789abcdef";
+    out.push_back('"');
+    const char *s = str.data(), *e = s + str.size();
+    while (s < e)
+    {
+        const char *run = s;
+        while (s < e && *s != '"' && *s != '\\' && (unsigned char)*s >= 0x20)
+            s++;
+        out.append(run, s - run);
+        if (s >= e)
+            break;
+        unsigned char c = *s++;
+        out.push_back('\\');
+        switch (c)
+        {
+        case '"':
+        case '\\':
+            out.push_back(c);
+            break;
+        case '\n':
+            out.push_back('n');
+            break;
+        case '\r':
+            out.push_back('r');
+            break;
+        case '\t':
+            out.push_back('t');
+            break;
+        default:
+            out.append("u00");
+            out.push_back(hex[c >> 4]);
+            out.push_back(hex[c & 0xf]);
+            break;
+        }
+    }
+    out.push_back('"');
+}
+
+static inline void netpacket_append_int(std::string &out, int val)
+{
+    char buf[16];
+    std::to_chars_result res = std::to_chars(buf, buf + sizeof(buf), val);
+    out.append(buf, res.ptr - buf);
+}
+
+// std::vector<std::string> or ReplyArena
+template <typename Array>
+static inline void netpacket_append_array(std::string &out, const Array &arr)
+{
+    out.push_back('[');
+    for (size_t i = 0; i < arr.size(); i++)
+    {
+        if (i > 0)
+            out.push_back(',');
+        netpacket_append_string(out, arr[i]);
+    }
+    out.push_back(']');
+}
+
+/**
+ * @brief Encode a reply into out, reusing its capacity. Same fields and
+ * order as the nlohmann serialization.
+ *
+ * @param retargs Return arguments, packet.retargs or a ReplyArena.
+ */
+template <typename Array>
+static inline void encode_netpacket(const NetPacket &packet, const Array &retargs, std::string &out)
+{
+    out.clear();
+    out.append("{\"arguments\":");
+    netpacket_append_array(out, packet.arguments);
+    out.append(",\"cam_id\":");
+    netpacket_append_string(out, packet.cam_id);
+    out.append(",\"cmd_type\":");
+    netpacket_append_string(out, packet.cmd_type);
+    out.append(",\"command\":");
+    netpacket_append_int(out, packet.command);
+    if (!packet.req_id.empty())
+    {
+        out.append(",\"req_id\":");
+        netpacket_append_string(out, packet.req_id);
+    }
+    out.append(",\"retargs\":");
+    netpacket_append_array(out, retargs);
+    out.append(",\"retcode\":");
+    netpacket_append_int(out, packet.retcode);
+    out.push_back('}');
+}
+
+static inline void encode_netpacket(const NetPacket &packet, std::string &out)
+{
+    encode_netpacket(packet, packet.retargs, out);
+}
+
+enum class CmdType : uint8_t
+{
+    Invalid = 0,
+    Quit,
+    Status,
+    Metrics,
+    Sequence,
+    Reconfigure,
+    GetFeature,
+    SetFeature,
+    ListFeatures,
+    List,
+    StartCaptureAll,
+    StopCaptureAll,
+    StartCapture,
+    StopCapture,
+    Get,
+    Set,
+    Subscribe,
+    Unsubscribe,
+    Count,
+};
+
+struct CmdName
+{
+    const char *name;
+    CmdType type;
+};
+
+static constexpr CmdName cmd_names[] = {
+    {"quit", CmdType::Quit},
+    {"status", CmdType::Status},
+    {"metrics", CmdType::Metrics},
+    {"sequence", CmdType::Sequence},
+    {"reconfigure", CmdType::Reconfigure},
+    {"get_feature", CmdType::GetFeature},
+    {"set_feature", CmdType::SetFeature},
+    {"list_features", CmdType::ListFeatures},
+    {"list", CmdType::List},
+    {"start_capture_all", CmdType::StartCaptureAll},
+    {"stop_capture_all", CmdType::StopCaptureAll},
+    {"start_capture", CmdType::StartCapture},
+    {"stop_capture", CmdType::StopCapture},
+    {"get", CmdType::Get},
+    {"set", CmdType::Set},
+    {"subscribe", CmdType::Subscribe},
+    {"unsubscribe", CmdType::Unsubscribe},
+};
+
+static constexpr size_t NCMD_NAMES = sizeof(cmd_names) / sizeof(cmd_names[0]);
+static constexpr size_t CMD_TABLE_SIZE = 32; // power of 2, > NCMD_NAMES
+
+constexpr size_t cmd_strlen(const char *str)
+{
+    size_t len = 0;
+    while (str[len])
+        len++;
+    return len;
+}
+
+// seeded FNV-1a
+constexpr uint32_t cmd_hash(const char *str, size_t len, uint32_t seed)
+{
+    uint32_t h = 2166136261u ^ seed;
+    for (size_t i = 0; i < len; i++)
+    {
+        h ^= (uint8_t)str[i];
+        h *= 16777619u;
+    }
+    return h ^ (h >> 15);
+}
+
+constexpr bool cmd_seed_is_perfect(uint32_t seed)
+{
+    bool used[CMD_TABLE_SIZE] = {};
+    for (size_t i = 0; i < NCMD_NAMES; i++)
+    {
+        size_t slot = cmd_hash(cmd_names[i].name, cmd_strlen(cmd_names[i].name), seed) & (CMD_TABLE_SIZE - 1);
+        if (used[slot])
+            return false;
+        used[slot] = true;
+    }
+    return true;
+}
+
+constexpr uint32_t cmd_find_seed()
+{
+    uint32_t seed = 0;
+    while (!cmd_seed_is_perfect(seed))
+        seed++;
+    return seed;
+}
+
+struct CmdSlot
+{
+    const char *name;
+    size_t len;
+    CmdType type;
+};
+
+constexpr std::array<CmdSlot, CMD_TABLE_SIZE> cmd_build_table(uint32_t seed)
+{
+    std::array<CmdSlot, CMD_TABLE_SIZE> table = {};
+    for (size_t i = 0; i < CMD_TABLE_SIZE; i++)
+        table[i] = CmdSlot{"", 0, CmdType::Invalid};
+    for (size_t i = 0; i < NCMD_NAMES; i++)
+    {
+        size_t len = cmd_strlen(cmd_names[i].name);
+        table[cmd_hash(cmd_names[i].name, len, seed) & (CMD_TABLE_SIZE - 1)] = CmdSlot{cmd_names[i].name, len, cmd_names[i].type};
+    }
+    return table;
+}
+
+static constexpr uint32_t CMD_SEED = cmd_find_seed();
+static constexpr std::array<CmdSlot, CMD_TABLE_SIZE> cmd_table = cmd_build_table(CMD_SEED);
+
+// collision-free at compile time: one hash, one compare
+static inline CmdType cmd_lookup(const std::string &cmd_type)
+{
+    const CmdSlot &slot = cmd_table[cmd_hash(cmd_type.data(), cmd_type.size(), CMD_SEED) & (CMD_TABLE_SIZE - 1)];
+    if (slot.len != cmd_type.size() || memcmp(slot.name, cmd_type.data(), slot.len) != 0)
+        return CmdType::Invalid;
+    return slot.type;
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <charconv>
+#include <type_traits>
+
+/**
+ * @brief Reply arguments of one request, stored back to back in a single
+ * buffer. Cleared, not freed, between requests, so once the buffers have
+ * grown to the largest reply, building a reply does not allocate.
+ *
+ * Numbers are formatted with std::to_chars; doubles default to the 6
+ * decimals std::to_string and "%.6f" produced.
+ */
+class ReplyArena
+{
+    std::string data;
+    std::vector<uint32_t> ends; // end offset of each entry in data
+
+    void close_entry()
+    {
+        ends.push_back((uint32_t)data.size());
+    }
+
+public:
+    void clear()
+    {
+        data.clear();
+        ends.clear();
+    }
+
+    size_t size() const
+    {
+        return ends.size();
+    }
+
+    bool empty() const
+    {
+        return ends.empty();
+    }
+
+    std::string_view operator[](size_t idx) const
+    {
+        uint32_t start = idx == 0 ? 0 : ends[idx - 1];
+        return std::string_view(data.data() + start, ends[idx] - start);
+    }
+
+    void push_back(std::string_view str)
+    {
+        data.append(str.data(), str.size());
+        close_entry();
+    }
+
+    void push_back(const char *str)
+    {
+        push_back(std::string_view(str));
+    }
+
+    void push_back(const std::string &str)
+    {
+        push_back(std::string_view(str));
+    }
+
+    // same spelling as the status reply; without this a bool would convert to double
+    void push_back(bool val)
+    {
+        push_back(std::string_view(val ? "True" : "False"));
+    }
+
+    template <typename T, typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value, int>::type = 0>
+    void push_back(T val)
+    {
+        char buf[24];
+        std::to_chars_result res = std::to_chars(buf, buf + sizeof(buf), val);
+        push_back(std::string_view(buf, res.ptr - buf));
+    }
+
+    void push_back(double val, int precision = 6)
+    {
+        char buf[64];
+        std::to_chars_result res = std::to_chars(buf, buf + sizeof(buf), val, std::chars_format::fixed, precision);
+        if (res.ec != std::errc()) // beyond 1e50, not a feature value
+            res = std::to_chars(buf, buf + sizeof(buf), val);
+        push_back(std::string_view(buf, res.ptr - buf));
+    }
+
+    // one entry from two parts, e.g. a metric name prefix and name
+    void push_join(std::string_view first, std::string_view second)
+    {
+        data.append(first.data(), first.size());
+        data.append(second.data(), second.size());
+        close_entry();
+    }
+
+    void append(const std::vector<std::string> &list)
+    {
+        for (const std::string &str : list)
+            push_back(str);
+    }
+
+    void append(const ReplyArena &other)
+    {
+        for (size_t i = 0; i < other.size(); i++)
+            push_back(other[i]);
+    }
+};
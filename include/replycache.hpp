@@ -0,0 +1,109 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <string_view>
+#include <map>
+#include <array>
+
+/**
+ * @brief Encoded replies to recent requests, keyed by client identity and
+ * request ID, so a retransmitted request is answered again without running
+ * it a second time. Behind a broker the identity is the whole routing
+ * envelope, the broker's own identity is the same for all its clients.
+ *
+ * Each client keeps its last REPLY_CACHE_DEPTH replies; clients are evicted
+ * least recently seen first once REPLY_CACHE_CLIENTS are tracked. Evicted
+ * slots keep their string capacity.
+ */
+class ReplyCache
+{
+public:
+    static constexpr size_t REPLY_CACHE_DEPTH = 8;
+    static constexpr size_t REPLY_CACHE_CLIENTS = 64;
+
+private:
+    struct Entry
+    {
+        std::string req_id;
+        std::string reply;
+        uint64_t stamp = 0; // 0: unused
+    };
+
+    struct Client
+    {
+        std::array<Entry, REPLY_CACHE_DEPTH> entries;
+        uint64_t stamp = 0;
+    };
+
+    std::map<std::string, Client, std::less<>> clients;
+    uint64_t clock = 0;
+    uint64_t nhits = 0;
+
+    Client &get_client(std::string_view identity)
+    {
+        auto it = clients.find(identity);
+        if (it != clients.end())
+            return it->second;
+        if (clients.size() >= REPLY_CACHE_CLIENTS)
+        {
+            auto oldest = clients.begin();
+            for (auto cit = clients.begin(); cit != clients.end(); cit++)
+            {
+                if (cit->second.stamp < oldest->second.stamp)
+                    oldest = cit;
+            }
+            clients.erase(oldest);
+        }
+        return clients.emplace(std::string(identity), Client()).first->second;
+    }
+
+public:
+    /**
+     * @brief Find the reply to a request seen before.
+     *
+     * @return const std::string* Encoded reply, nullptr if not cached.
+     */
+    const std::string *find(std::string_view identity, std::string_view req_id)
+    {
+        if (req_id.empty())
+            return nullptr;
+        auto it = clients.find(identity);
+        if (it == clients.end())
+            return nullptr;
+        for (Entry &entry : it->second.entries)
+        {
+            if (entry.stamp != 0 && entry.req_id == req_id)
+            {
+                entry.stamp = ++clock;
+                it->second.stamp = clock;
+                nhits++;
+                return &entry.reply;
+            }
+        }
+        return nullptr;
+    }
+
+    // remember the reply to a request, replacing the client's least recently used entry
+    void insert(std::string_view identity, std::string_view req_id, const std::string &reply)
+    {
+        if (req_id.empty())
+            return;
+        Client &client = get_client(identity);
+        Entry *slot = &client.entries[0];
+        for (Entry &entry : client.entries)
+        {
+            if (entry.stamp < slot->stamp)
+                slot = &entry;
+        }
+        slot->req_id.assign(req_id.data(), req_id.size());
+        slot->reply.assign(reply);
+        slot->stamp = ++clock;
+        client.stamp = clock;
+    }
+
+    uint64_t hits() const
+    {
+        return nhits;
+    }
+};
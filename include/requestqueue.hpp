@@ -0,0 +1,160 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <czmq.h>
+#include "netpacket.hpp"
+
+// Control: stop and quit, from either endpoint
+enum class Lane : uint8_t
+{
+    Normal = 0,
+    Control,
+    Count,
+};
+
+static inline const char *lane_name(Lane lane)
+{
+    return lane == Lane::Control ? "control" : "normal";
+}
+
+// commands that must not wait behind queued configuration work
+static inline bool cmd_is_control(CmdType type)
+{
+    return type == CmdType::Quit || type == CmdType::StopCapture || type == CmdType::StopCaptureAll;
+}
+
+/**
+ * @brief A received request waiting to be served: its routing envelope,
+ * decoded packet and lane. Slots are reused, keeping string capacity.
+ */
+struct PendingRequest
+{
+    void *sock = nullptr; // the reply goes back where the request came in
+    std::vector<std::string> envelope;
+    size_t nenvelope = 0;
+    std::string client; // reply cache key, every envelope frame: one broker socket carries many clients
+    NetPacket packet;
+    bool decoded = false;
+    bool control_endpoint = false; // came in on the control endpoint
+    Lane lane = Lane::Normal;
+    uint64_t seq = 0;     // arrival order
+    int64_t recv_us = 0;  // zclock_usecs() at receipt
+    bool used = false;
+};
+
+/**
+ * @brief Requests read off the endpoints ahead of dispatch, so stop and quit
+ * can be served before configuration requests that arrived earlier.
+ *
+ * The control lane is served first, arrival order within a lane. At most
+ * MAX_PENDING requests are held; the rest stay queued in ZMQ.
+ */
+class RequestQueue
+{
+public:
+    static constexpr size_t MAX_PENDING = 64;
+
+private:
+    std::vector<PendingRequest> slots;
+    NetPacketDecoder decoder;
+    size_t npending = 0;
+    uint64_t seq = 0;
+
+    PendingRequest *free_slot()
+    {
+        for (PendingRequest &req : slots)
+        {
+            if (!req.used)
+                return &req;
+        }
+        return nullptr;
+    }
+
+    // one multipart request, false if none is waiting
+    bool receive(void *sock, PendingRequest &req)
+    {
+        zmq_msg_t message;
+        zmq_msg_init(&message);
+        req.nenvelope = 0;
+        while (true)
+        {
+            if (zmq_msg_recv(&message, sock, ZMQ_DONTWAIT) < 0)
+            {
+                zmq_msg_close(&message);
+                return false;
+            }
+            if (!zmq_msg_more(&message))
+                break;
+            if (req.nenvelope == req.envelope.size())
+                req.envelope.emplace_back();
+            req.envelope[req.nenvelope++].assign((const char *)zmq_msg_data(&message), zmq_msg_size(&message));
+        }
+        // frames are ZMQ identities or delimiters, at most 255 bytes: one length byte each
+        req.client.clear();
+        for (size_t i = 0; i < req.nenvelope; i++)
+        {
+            req.client.push_back((char)req.envelope[i].size());
+            req.client.append(req.envelope[i]);
+        }
+        req.decoded = decoder.decode((const char *)zmq_msg_data(&message), zmq_msg_size(&message), req.packet);
+        zmq_msg_close(&message);
+        return true;
+    }
+
+public:
+    RequestQueue() : slots(MAX_PENDING) {}
+
+    size_t size() const
+    {
+        return npending;
+    }
+
+    /**
+     * @brief Read every request waiting on sock without blocking, until the
+     * queue is full.
+     *
+     * @param control_endpoint sock is the control endpoint.
+     * @return size_t Requests read.
+     */
+    size_t drain(void *sock, bool control_endpoint)
+    {
+        size_t nread = 0;
+        PendingRequest *req;
+        while ((req = free_slot()) != nullptr && receive(sock, *req))
+        {
+            if (req->nenvelope == 0) // not from a ROUTER peer, nowhere to reply
+                continue;
+            req->sock = sock;
+            req->recv_us = zclock_usecs();
+            req->seq = seq++;
+            req->control_endpoint = control_endpoint;
+            req->lane = req->decoded && cmd_is_control(cmd_lookup(req->packet.cmd_type)) ? Lane::Control : Lane::Normal;
+            req->used = true;
+            npending++;
+            nread++;
+        }
+        return nread;
+    }
+
+    // next request to serve, nullptr if none
+    PendingRequest *next()
+    {
+        PendingRequest *best = nullptr;
+        for (PendingRequest &req : slots)
+        {
+            if (!req.used)
+                continue;
+            if (best == nullptr || req.lane > best->lane || (req.lane == best->lane && req.seq < best->seq))
+                best = &req;
+        }
+        return best;
+    }
+
+    void release(PendingRequest *req)
+    {
+        req->used = false;
+        npending--;
+    }
+};
@@ -1,7 +1,14 @@
 #pragma once
 
+#include <tuple>
+#include <vector>
+#include <utility>
+#include <type_traits>
 #include "json.hpp"
 #include "alliedcam.h"
+#include "meb_print.h"
+#include "featuretraits.hpp"
+#include "netpacket.hpp"
 
 enum CommandNames
 {
@@ -14,6 +21,8 @@ enum CommandNames
     acq_framerate,                // double
     acq_framerate_auto,           // bool
     frame_size,                   // int
+    frame_buffers,                // special, read-only: buffers, bytes committed, callback latency p50 us, p99 us
+    max_exposure_us,              // special, read-only, argument: frame rate (default current), double
     image_size = 200,             // special, two arguments, ints
     image_ofst = 201,             // special, two arguments, ints
     sensor_size = 202,            // special, two arguments, ints
@@ -24,8 +33,18 @@ enum CommandNames
     triglines_list = 304,         // special
     image_format_list = 305,      // special
     sensor_bit_depth_list = 306,  // special
+    gige_tuning = 307,            // special, read-only: packet size before, after, NIC, MTU, rmem_max, CPU us/frame, warnings...
+    hdr_output = 308,             // special, string, directory for merged sequence passes, empty disables
+    hdr_stats = 309,              // special, read-only: merged images written, dropped
     adio_bit = 10,                // special
+    adio_mode = 11,               // special, string: "frame" or "exposure"
+    adio_lag = 12,                // special, read-only: samples, mean us, max us
     capture_maxlen = 400,         // special, int, time in seconds
+    bundle_tol = 401,             // special, int, frame set tolerance in microseconds
+    bundle_stats = 402,           // special, read-only: sets, incomplete sets, dropped frames
+    watchdog_periods = 403,       // special, int, frame periods before a stalled stream is restarted, 0 disables
+    clock_sync = 500,             // special, read-only: samples, rejected, offset ns, drift ppm, rms ns
+    frame_meta = 501,             // special, read-only: frame id, camera ticks, host ns, receive ns, sequence step, pass
 };
 
 #define ZSYS_ERROR(fmt, ...)                              \
@@ -43,160 +62,160 @@ enum CommandNames
         zsys_info(CYAN_FG fmt TERMINATOR, ##__VA_ARGS__); \
     }
 
-using json = nlohmann::json;
+/**
+ * @brief Scalar camera features served by get / set.
+ *
+ * Each entry carries the alliedcam accessors and the value classes it
+ * provides and depends on; handlers, codecs and cache invalidation masks
+ * are generated from it at compile time.
+ */
+static constexpr auto feature_table = std::make_tuple(
+    FeatureDef<const char *>{CommandNames::image_format, "image_format", "PixelFormat", allied_get_image_format, allied_set_image_format, DEP_FORMAT, DEP_FORMAT},
+    FeatureDef<const char *>{CommandNames::sensor_bit_depth, "sensor_bit_depth", "SensorBitDepth", allied_get_sensor_bit_depth, allied_set_sensor_bit_depth, DEP_FORMAT, DEP_FORMAT},
+    FeatureDef<const char *>{CommandNames::trigline, "trigline", "LineSelector", allied_get_trigline, allied_set_trigline, DEP_TRIGSEL, DEP_NONE},
+    FeatureDef<const char *>{CommandNames::trigline_mode, "trigline_mode", "LineMode", allied_get_trigline_mode, allied_set_trigline_mode, DEP_TRIGGER, DEP_TRIGSEL},
+    FeatureDef<const char *>{CommandNames::trigline_src, "trigline_src", "LineSource", allied_get_trigline_src, allied_set_trigline_src, DEP_TRIGGER, DEP_TRIGSEL},
+    FeatureDef<double>{CommandNames::exposure_us, "exposure_us", "ExposureTime", allied_get_exposure_us, allied_set_exposure_us, DEP_EXPOSURE, DEP_NONE},
+    FeatureDef<double>{CommandNames::acq_framerate, "acq_framerate", "AcquisitionFrameRate", allied_get_acq_framerate, allied_set_acq_framerate, DEP_FRAMERATE, DEP_FORMAT | DEP_ROI | DEP_EXPOSURE | DEP_FRAMERATE | DEP_BANDWIDTH},
+    FeatureDef<bool>{CommandNames::acq_framerate_auto, "acq_framerate_auto", "AcquisitionFrameRateEnable", allied_get_acq_framerate_auto, allied_set_acq_framerate_auto, DEP_FRAMERATE, DEP_NONE},
+    FeatureDef<VmbInt64_t>{CommandNames::throughput_limit, "throughput_limit", "DeviceLinkThroughputLimit", allied_get_throughput_limit, allied_set_throughput_limit, DEP_BANDWIDTH, DEP_NONE});
+
+static constexpr size_t NFEATURES = std::tuple_size<decltype(feature_table)>::value;
+static_assert(NFEATURES <= FeatureCache::NSLOTS, "feature_table exceeds the cache slots");
+
+template <size_t... I>
+constexpr uint32_t feature_invalidation_mask_impl(uint32_t provides, std::index_sequence<I...>)
+{
+    return (((std::get<I>(feature_table).depends & provides) ? (1u << I) : 0u) | ... | 0u);
+}
 
-class NetPacket
+// cache slots to drop after a write that changes the given value classes
+constexpr uint32_t feature_invalidation_mask(uint32_t provides)
 {
-public:
-    std::string cmd_type = "None";
-    std::string cam_id = "None";
-    int command = 0;
-    std::vector<std::string> arguments;
-    int retcode = VmbErrorSuccess;
-    std::vector<std::string> retargs;
-
-    NLOHMANN_DEFINE_TYPE_INTRUSIVE(NetPacket, cmd_type, cam_id, command, arguments, retcode, retargs)
-};
+    return feature_invalidation_mask_impl(provides, std::make_index_sequence<NFEATURES>());
+}
 
-namespace std
+template <size_t... I>
+static std::vector<FeatureCacheSource> feature_cache_sources_impl(std::index_sequence<I...>)
 {
-    static inline std::string to_string(const NetPacket &p) noexcept
-    {
-        return json(p).dump();
-    }
+    return {FeatureCacheSource{std::get<I>(feature_table).genicam, feature_invalidation_mask(std::get<I>(feature_table).provides) | (1u << I)}...};
 }
 
-#define SET_CASE_STR(NAME)                                                                                                  \
-    case CommandNames::NAME:                                                                                                \
-    {                                                                                                                       \
-        err = allied_set_##NAME(image_cam->handle, argument);                                                               \
-        ZSYS_INFO("set (%s): %s -> %s", image_cam->get_info().idstr.c_str(), #NAME, argument);                              \
-        err = allied_get_##NAME(image_cam->handle, &argument);                                                              \
-        if (err == VmbErrorSuccess)                                                                                         \
-        {                                                                                                                   \
-            ZSYS_INFO("set (%s): %s = %s", image_cam->get_info().idstr.c_str(), #NAME, argument);                           \
-        }                                                                                                                   \
-        else                                                                                                                \
-        {                                                                                                                   \
-            ZSYS_ERROR("set (%s): %s = %s (%s)", image_cam->get_info().idstr.c_str(), #NAME, argument, allied_strerr(err)); \
-        }                                                                                                                   \
-        reply.push_back(argument);                                                                                          \
-        break;                                                                                                              \
-    }
+// camera features to watch so changes made behind the server's back drop the cached values
+static inline std::vector<FeatureCacheSource> feature_cache_sources()
+{
+    return feature_cache_sources_impl(std::make_index_sequence<NFEATURES>());
+}
 
-#define SET_CASE_INT(NAME)                                                                                              \
-    case CommandNames::NAME:                                                                                            \
-    {                                                                                                                   \
-        VmbInt64_t arg = atoll(argument);                                                                                \
-        err = allied_set_##NAME(image_cam->handle, arg);                                                                \
-        ZSYS_INFO("set (%s): %s -> %ld", image_cam->get_info().idstr.c_str(), #NAME, arg);                              \
-        err = allied_get_##NAME(image_cam->handle, &arg);                                                               \
-        if (err == VmbErrorSuccess)                                                                                     \
-        {                                                                                                               \
-            ZSYS_INFO("set (%s): %s = %ld", image_cam->get_info().idstr.c_str(), #NAME, arg);                           \
-        }                                                                                                               \
-        else                                                                                                            \
-        {                                                                                                               \
-            ZSYS_ERROR("set (%s): %s = %ld (%s)", image_cam->get_info().idstr.c_str(), #NAME, arg, allied_strerr(err)); \
-        }                                                                                                               \
-        reply.push_back(std::to_string(arg));                                                                           \
-        break;                                                                                                          \
-    }
+template <size_t... I>
+constexpr size_t feature_index_impl(int command, std::index_sequence<I...>)
+{
+    size_t idx = NFEATURES;
+    ((std::get<I>(feature_table).id == command ? (idx = I, true) : false) || ...);
+    return idx;
+}
 
-#define SET_CASE_DBL(NAME)                                                                                             \
-    case CommandNames::NAME:                                                                                           \
-    {                                                                                                                  \
-        double arg = atof(argument);                                                                                   \
-        err = allied_set_##NAME(image_cam->handle, arg);                                                               \
-        ZSYS_INFO("set (%s): %s -> %f", image_cam->get_info().idstr.c_str(), #NAME, arg);                              \
-        err = allied_get_##NAME(image_cam->handle, &arg);                                                              \
-        if (err == VmbErrorSuccess)                                                                                    \
-        {                                                                                                              \
-            ZSYS_INFO("set (%s): %s = %f", image_cam->get_info().idstr.c_str(), #NAME, arg);                           \
-        }                                                                                                              \
-        else                                                                                                           \
-        {                                                                                                              \
-            ZSYS_ERROR("set (%s): %s = %f (%s)", image_cam->get_info().idstr.c_str(), #NAME, arg, allied_strerr(err)); \
-        }                                                                                                              \
-        reply.push_back(string_format("%.6f", arg));                                                                   \
-        break;                                                                                                         \
-    }
+// table index of a command, NFEATURES if it is not a table feature
+constexpr size_t feature_index(int command)
+{
+    return feature_index_impl(command, std::make_index_sequence<NFEATURES>());
+}
 
-#define SET_CASE_BOOL(NAME)                                                                                            \
-    case CommandNames::NAME:                                                                                           \
-    {                                                                                                                  \
-        char *narg = strdup(argument);                                                                                 \
-        for (int i = 0; narg[i]; i++)                                                                                  \
-        {                                                                                                              \
-            narg[i] = tolower(narg[i]);                                                                                \
-        }                                                                                                              \
-        bool arg = streq(narg, "true");                                                                                \
-        err = allied_set_##NAME(image_cam->handle, arg);                                                               \
-        ZSYS_INFO("set (%s): %s -> %d", image_cam->get_info().idstr.c_str(), #NAME, arg);                              \
-        err = allied_get_##NAME(image_cam->handle, &arg);                                                              \
-        if (err == VmbErrorSuccess)                                                                                    \
-        {                                                                                                              \
-            ZSYS_INFO("set (%s): %s = %d", image_cam->get_info().idstr.c_str(), #NAME, arg);                           \
-        }                                                                                                              \
-        else                                                                                                           \
-        {                                                                                                              \
-            ZSYS_ERROR("set (%s): %s = %d (%s)", image_cam->get_info().idstr.c_str(), #NAME, arg, allied_strerr(err)); \
-        }                                                                                                              \
-        reply.push_back(arg ? "True" : "False");                                                                       \
-        break;                                                                                                         \
+// calls fn(std::integral_constant<size_t, I>) for the table entry with the given command, false if none
+template <size_t I = 0, typename Fn>
+static inline bool feature_dispatch(int command, Fn &&fn)
+{
+    if constexpr (I < NFEATURES)
+    {
+        if (std::get<I>(feature_table).id == command)
+        {
+            fn(std::integral_constant<size_t, I>());
+            return true;
+        }
+        return feature_dispatch<I + 1>(command, fn);
     }
-
-#define GET_CASE_STR(NAME)                                                                \
-    case CommandNames::NAME:                                                              \
-    {                                                                                     \
-        char *garg = (char *)"None";                                                      \
-        err = allied_get_##NAME(image_cam->handle, (const char **)&garg);                 \
-        ZSYS_INFO("get (%s): %s = %s", image_cam->get_info().idstr.c_str(), #NAME, garg); \
-        reply.push_back(garg);                                                            \
-        break;                                                                            \
+    else
+    {
+        return false;
     }
+}
 
-#define GET_CASE_DBL(NAME)                                                                  \
-    case CommandNames::NAME:                                                                \
-    {                                                                                       \
-        double garg;                                                                        \
-        err = allied_get_##NAME(image_cam->handle, &garg);                                  \
-        ZSYS_INFO("get (%s): %s = %.6f", image_cam->get_info().idstr.c_str(), #NAME, garg); \
-        reply.push_back(string_format("%.6f", garg));                                       \
-        break;                                                                              \
+/**
+ * @brief Read a table feature, from the cache when valid.
+ *
+ * @return VmbError_t
+ */
+template <size_t I>
+static VmbError_t feature_get(AlliedCameraHandle_t handle, FeatureCache &cache, typename std::tuple_element<I, decltype(feature_table)>::type::value_type &val)
+{
+    constexpr auto def = std::get<I>(feature_table);
+    typedef typename decltype(def)::codec codec;
+    uint64_t slot;
+    if (cache.lookup(I, slot))
+    {
+        val = codec::unpack(slot);
+        return VmbErrorSuccess;
     }
+    uint32_t gen = cache.begin_read();
+    typename codec::get_type raw;
+    VmbError_t err = def.get(handle, &raw);
+    if (err != VmbErrorSuccess)
+        return err;
+    val = raw;
+    cache.store(I, codec::pack(val), gen);
+    return err;
+}
 
-#define GET_CASE_INT(NAME)                                                                 \
-    case CommandNames::NAME:                                                               \
-    {                                                                                      \
-        VmbInt64_t garg;                                                                   \
-        err = allied_get_##NAME(image_cam->handle, &garg);                                 \
-        ZSYS_INFO("get (%s): %s = %ld", image_cam->get_info().idstr.c_str(), #NAME, garg); \
-        reply.push_back(std::to_string(garg));                                             \
-        break;                                                                             \
-    }
+template <size_t I>
+static VmbError_t feature_get_reply(AlliedCameraHandle_t handle, FeatureCache &cache, const char *idstr, ReplyArena &reply)
+{
+    constexpr auto def = std::get<I>(feature_table);
+    typedef typename decltype(def)::codec codec;
+    typename decltype(def)::value_type val;
+    char buf[FEATURE_TEXT_MAX] = "None";
+    int len = 4;
+    VmbError_t err = feature_get<I>(handle, cache, val);
+    if (err == VmbErrorSuccess)
+        len = codec::format(val, buf, sizeof(buf));
+    ZSYS_INFO("get (%s): %s = %s (%s)", idstr, def.name, buf, allied_strerr(err));
+    reply.push_back(std::string_view(buf, len));
+    return err;
+}
 
-#define GET_CASE_BOOL(NAME)                                                                    \
-    case CommandNames::NAME:                                                                   \
-    {                                                                                          \
-        VmbBool_t garg;                                                                        \
-        err = allied_get_##NAME(image_cam->handle, &garg);                                     \
-        ZSYS_INFO("get (%s): %s = %d", image_cam->get_info().idstr.c_str(), #NAME, (int)garg); \
-        reply.push_back(garg == VmbBoolTrue ? "True" : "False");                               \
-        break;                                                                                 \
+/**
+ * @brief Write a table feature and reply with the value read back.
+ *
+ * @return VmbError_t Error of the write if it failed, else of the read-back.
+ */
+template <size_t I>
+static VmbError_t feature_set_reply(AlliedCameraHandle_t handle, FeatureCache &cache, const char *idstr, const char *argument, ReplyArena &reply)
+{
+    constexpr auto def = std::get<I>(feature_table);
+    constexpr uint32_t mask = feature_invalidation_mask(def.provides) | (1u << I);
+    typedef typename decltype(def)::codec codec;
+    typename decltype(def)::value_type val;
+    if (!codec::parse(argument, val))
+    {
+        ZSYS_ERROR("set (%s): %s -> %s (%s)", idstr, def.name, argument, allied_strerr(VmbErrorInvalidValue));
+        return VmbErrorInvalidValue;
     }
-
-#define GET_CASE_LIST(NAME)                                                                                         \
-    case CommandNames::NAME:                                                                                        \
-    {                                                                                                               \
-        const char **srcs = nullptr;                                                                                \
-        VmbUint32_t nsrcs = 0;                                                                                      \
-        err = allied_get_##NAME(image_cam->handle, (char ***)&srcs, NULL, &nsrcs);                                  \
-        ZSYS_INFO("get (%s): " #NAME "-> %d (%s)", image_cam->get_info().idstr.c_str(), nsrcs, allied_strerr(err)); \
-        for (VmbUint32_t i = 0; i < nsrcs; i++)                                                                     \
-        {                                                                                                           \
-            reply.push_back(srcs[i]);                                                                               \
-        }                                                                                                           \
-        allied_free_list((char ***)&srcs);                                                                          \
-        break;                                                                                                      \
+    char req[FEATURE_TEXT_MAX], cur[FEATURE_TEXT_MAX];
+    codec::format(val, req, sizeof(req));
+    VmbError_t err = def.set(handle, val);
+    cache.invalidate(mask);
+    VmbError_t rerr = feature_get<I>(handle, cache, val);
+    int len = rerr == VmbErrorSuccess ? codec::format(val, cur, sizeof(cur)) : snprintf(cur, sizeof(cur), "%s", req);
+    if (err == VmbErrorSuccess)
+        err = rerr;
+    if (err == VmbErrorSuccess)
+    {
+        ZSYS_INFO("set (%s): %s %s -> %s", idstr, def.name, req, cur);
     }
+    else
+    {
+        ZSYS_ERROR("set (%s): %s %s -> %s (%s)", idstr, def.name, req, cur, allied_strerr(err));
+    }
+    reply.push_back(std::string_view(cur, len));
+    return err;
+}
+
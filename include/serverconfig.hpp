@@ -0,0 +1,360 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fnmatch.h>
+#include <sched.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <fstream>
+#include "json.hpp"
+
+/**
+ * @brief Startup configuration of a capture server instance.
+ *
+ * Read from a JSON file (-f), then overridden by command line options.
+ * All keys are optional:
+ *
+ *   {
+ *     "cameras": ["DEV_000F3102*", "50-0536*"],    // IDs or serial numbers, fnmatch patterns; empty: all
+ *     "endpoint": "tcp://0.0.0.0:5555",            // requests; tcp or ipc
+ *     "port": 5555,                                // request port, replaces the endpoint's (-p)
+ *     "control_endpoint": "...", "bundle_endpoint": "...", "notify_endpoint": "...",
+ *     "adio_minor": 0,                             // -1: no aDIO
+ *     "adio_bits": {"DEV_000F310199C1": 2},        // camera ID, serial or pattern -> port 0 bit
+ *     "cpus": "2-5",                               // pin the process (all its threads) to these CPUs
+ *     "buffer_budget_mb": 256,                     // frame buffer memory per camera
+ *     "supervise": false                           // one worker process per camera
+ *   }
+ *
+ * Endpoints left out follow the request endpoint: port + 2, + 1 and + 3
+ * for tcp, suffixes ".ctrl", ".bundle" and ".notify" for ipc.
+ */
+struct ServerConfig
+{
+    std::vector<std::string> cameras;
+    std::string endpoint = "tcp://*:5555";
+    std::string control_endpoint;
+    std::string bundle_endpoint;
+    std::string notify_endpoint;
+    int adio_minor = 0;
+    std::map<std::string, int> adio_bits;
+    std::vector<int> cpus;
+    uint64_t buffer_budget_mb = 256;
+    bool supervise = false;
+    bool worker = false; // started by a supervisor, loopback only
+
+    static bool is_tcp(const std::string &endpoint)
+    {
+        return endpoint.compare(0, 6, "tcp://") == 0;
+    }
+
+    static bool is_ipc(const std::string &endpoint)
+    {
+        return endpoint.compare(0, 6, "ipc://") == 0;
+    }
+
+    // port of a tcp endpoint, -1 if it has none
+    static int endpoint_port(const std::string &endpoint)
+    {
+        size_t colon = endpoint.rfind(':');
+        if (!is_tcp(endpoint) || colon == std::string::npos || colon < 6)
+            return -1;
+        char *end;
+        long port = strtol(endpoint.c_str() + colon + 1, &end, 10);
+        return *end == '\0' && port > 0 && port <= 65535 ? (int)port : -1;
+    }
+
+    // host part of a tcp endpoint
+    static std::string endpoint_host(const std::string &endpoint)
+    {
+        size_t colon = endpoint.rfind(':');
+        return endpoint.substr(6, colon - 6);
+    }
+
+    int port() const
+    {
+        return endpoint_port(endpoint);
+    }
+
+    void set_port(int port)
+    {
+        endpoint = "tcp://" + (is_tcp(endpoint) ? endpoint_host(endpoint) : std::string("*")) + ":" + std::to_string(port);
+    }
+
+    /**
+     * @brief Port of the request endpoint from the command line (-p); an ipc
+     * endpoint becomes tcp on all interfaces. The range is checked by validate().
+     *
+     * @return false if the argument is not a number.
+     */
+    bool parse_port(const std::string &arg)
+    {
+        char *end;
+        long port = strtol(arg.c_str(), &end, 10);
+        if (arg.empty() || *end != '\0' || port <= 0 || port > 65535)
+            return false;
+        set_port((int)port);
+        return true;
+    }
+
+    // the request endpoint moved n ports up (tcp) or suffixed (ipc)
+    std::string derived_endpoint(int offset, const char *suffix) const
+    {
+        if (is_ipc(endpoint))
+            return endpoint + suffix;
+        return "tcp://" + endpoint_host(endpoint) + ":" + std::to_string(port() + offset);
+    }
+
+    std::string get_control_endpoint() const
+    {
+        return control_endpoint.empty() ? derived_endpoint(2, ".ctrl") : control_endpoint;
+    }
+
+    std::string get_bundle_endpoint() const
+    {
+        return bundle_endpoint.empty() ? derived_endpoint(1, ".bundle") : bundle_endpoint;
+    }
+
+    std::string get_notify_endpoint() const
+    {
+        return notify_endpoint.empty() ? derived_endpoint(3, ".notify") : notify_endpoint;
+    }
+
+    // a camera is served if its ID or serial number matches a pattern, or none is given
+    static bool camera_matches(const std::string &pattern, const std::string &idstr, const std::string &serial)
+    {
+        return fnmatch(pattern.c_str(), idstr.c_str(), 0) == 0 || (!serial.empty() && fnmatch(pattern.c_str(), serial.c_str(), 0) == 0);
+    }
+
+    bool serves_camera(const std::string &idstr, const std::string &serial) const
+    {
+        if (cameras.empty())
+            return true;
+        for (const std::string &pattern : cameras)
+        {
+            if (camera_matches(pattern, idstr, serial))
+                return true;
+        }
+        return false;
+    }
+
+    // aDIO bit of a camera, -1 if none is mapped
+    int adio_bit_for(const std::string &idstr, const std::string &serial) const
+    {
+        for (auto &entry : adio_bits)
+        {
+            if (camera_matches(entry.first, idstr, serial))
+                return entry.second;
+        }
+        return -1;
+    }
+
+    /**
+     * @brief Parse a CPU list such as "0-3,6".
+     *
+     * @return false on a syntax error or a CPU number of CPU_SETSIZE or more.
+     */
+    static bool parse_cpu_list(const std::string &list, std::vector<int> &cpus)
+    {
+        cpus.clear();
+        const char *p = list.c_str();
+        while (*p != '\0')
+        {
+            char *end;
+            long first = strtol(p, &end, 10);
+            if (end == p || first < 0 || first >= CPU_SETSIZE)
+                return false;
+            long last = first;
+            p = end;
+            if (*p == '-')
+            {
+                last = strtol(p + 1, &end, 10);
+                if (end == p + 1 || last < first || last >= CPU_SETSIZE)
+                    return false;
+                p = end;
+            }
+            for (long cpu = first; cpu <= last; cpu++)
+                cpus.push_back((int)cpu);
+            if (*p == ',')
+                p++;
+            else if (*p != '\0')
+                return false;
+        }
+        return !cpus.empty();
+    }
+
+    /**
+     * @brief "<camera ID, serial or pattern>:<bit>"
+     *
+     * @return false on a syntax error.
+     */
+    bool parse_adio_bit(const std::string &entry)
+    {
+        size_t colon = entry.rfind(':');
+        if (colon == std::string::npos || colon == 0)
+            return false;
+        char *end;
+        long bit = strtol(entry.c_str() + colon + 1, &end, 10);
+        if (*end != '\0' || end == entry.c_str() + colon + 1)
+            return false;
+        adio_bits[entry.substr(0, colon)] = (int)bit;
+        return true;
+    }
+
+    /**
+     * @brief Read a JSON configuration file; keys present replace the defaults.
+     *
+     * @param err Set to the reason on failure.
+     */
+    bool load(const std::string &path, std::string &err)
+    {
+        std::ifstream file(path);
+        if (!file.is_open())
+        {
+            err = "cannot open " + path;
+            return false;
+        }
+        try
+        {
+            nlohmann::json config = nlohmann::json::parse(file, nullptr, true, true); // comments allowed
+            if (config.contains("cameras"))
+                cameras = config["cameras"].get<std::vector<std::string>>();
+            if (config.contains("endpoint"))
+                endpoint = config["endpoint"].get<std::string>();
+            if (config.contains("port"))
+                set_port(config["port"].get<int>());
+            if (config.contains("control_endpoint"))
+                control_endpoint = config["control_endpoint"].get<std::string>();
+            if (config.contains("bundle_endpoint"))
+                bundle_endpoint = config["bundle_endpoint"].get<std::string>();
+            if (config.contains("notify_endpoint"))
+                notify_endpoint = config["notify_endpoint"].get<std::string>();
+            if (config.contains("adio_minor"))
+                adio_minor = config["adio_minor"].get<int>();
+            if (config.contains("adio_bits"))
+                adio_bits = config["adio_bits"].get<std::map<std::string, int>>();
+            if (config.contains("cpus") && !parse_cpu_list(config["cpus"].get<std::string>(), cpus))
+            {
+                err = "cpus: not a CPU list";
+                return false;
+            }
+            if (config.contains("buffer_budget_mb"))
+                buffer_budget_mb = config["buffer_budget_mb"].get<uint64_t>();
+            if (config.contains("supervise"))
+                supervise = config["supervise"].get<bool>();
+            for (auto &item : config.items())
+            {
+                static const std::set<std::string> known = {"cameras", "endpoint", "port", "control_endpoint", "bundle_endpoint", "notify_endpoint", "adio_minor", "adio_bits", "cpus", "buffer_budget_mb", "supervise"};
+                if (known.count(item.key()) == 0)
+                {
+                    err = "unknown key " + item.key();
+                    return false;
+                }
+            }
+        }
+        catch (const nlohmann::json::exception &e)
+        {
+            err = path + ": " + e.what();
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Check the configuration before anything is opened.
+     *
+     * @param err Set to the first problem found.
+     */
+    bool validate(std::string &err) const
+    {
+        std::vector<std::string> endpoints = {endpoint, get_control_endpoint(), get_bundle_endpoint(), get_notify_endpoint()};
+        std::set<std::string> seen;
+        for (const std::string &ep : endpoints)
+        {
+            if (is_tcp(ep))
+            {
+                int port = endpoint_port(ep);
+                if (port < 5000 || port > 65535)
+                {
+                    err = "invalid port in " + ep + ", expected 5000-65535";
+                    return false;
+                }
+            }
+            else if (!is_ipc(ep) || ep.size() <= 6)
+            {
+                err = "invalid endpoint " + ep + ", expected tcp://host:port or ipc://path";
+                return false;
+            }
+            if (!seen.insert(ep).second)
+            {
+                err = "endpoint " + ep + " used twice";
+                return false;
+            }
+        }
+        if (supervise && !is_tcp(endpoint))
+        {
+            err = "supervisor mode needs a tcp endpoint, worker ports follow its port";
+            return false;
+        }
+        for (const std::string &pattern : cameras)
+        {
+            if (pattern.empty())
+            {
+                err = "empty camera pattern";
+                return false;
+            }
+        }
+        std::set<int> bits;
+        for (auto &entry : adio_bits)
+        {
+            if (entry.second < 0 || entry.second > 7)
+            {
+                err = "aDIO bit " + std::to_string(entry.second) + " of " + entry.first + " out of range 0-7";
+                return false;
+            }
+            if (!bits.insert(entry.second).second)
+            {
+                err = "aDIO bit " + std::to_string(entry.second) + " mapped twice";
+                return false;
+            }
+        }
+        if (!adio_bits.empty() && adio_minor < 0)
+        {
+            err = "aDIO bits mapped with aDIO disabled";
+            return false;
+        }
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        sched_getaffinity(0, sizeof(allowed), &allowed);
+        for (int cpu : cpus)
+        {
+            if (cpu >= CPU_SETSIZE || !CPU_ISSET(cpu, &allowed))
+            {
+                err = "CPU " + std::to_string(cpu) + " is not available";
+                return false;
+            }
+        }
+        if (buffer_budget_mb < 1 || buffer_budget_mb > (1 << 20))
+        {
+            err = "buffer budget " + std::to_string(buffer_budget_mb) + " MB out of range 1-1048576";
+            return false;
+        }
+        return true;
+    }
+
+    // pin the calling thread, and the threads it starts later, to cpus
+    bool apply_cpus() const
+    {
+        if (cpus.empty())
+            return true;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : cpus)
+            CPU_SET(cpu, &set);
+        return sched_setaffinity(0, sizeof(set), &set) == 0;
+    }
+};
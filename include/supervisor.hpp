@@ -0,0 +1,373 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sched.h>
+#include <sys/wait.h>
+#include <sys/prctl.h>
+#include <czmq.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include "server.hpp"
+#include "broker.hpp"
+#include "stringhasher.hpp"
+#include "capture_manager.hpp"
+#include "serverconfig.hpp"
+
+/**
+ * @brief Front end of the process-per-camera mode.
+ *
+ * Each camera runs in its own capture server process (a worker) on loopback
+ * ports, pinned to its own cores, so a camera that hangs in VmbC or crashes
+ * stalls only its worker. The supervisor is a Broker in front of the
+ * workers that also starts them and restarts those that exit.
+ */
+class Supervisor : public Broker
+{
+public:
+    static constexpr int WORKER_PORT_OFFSET = 10; // first worker port, from the front end port
+    static constexpr int WORKER_PORT_STRIDE = 4;  // request, bundle, control, notification
+    static constexpr int64_t RESTART_BACKOFF_MIN_MS = 500;
+    static constexpr int64_t RESTART_BACKOFF_MAX_MS = 30000;
+    static constexpr int64_t STABLE_RUN_MS = 60000; // up this long, the next restart is not delayed
+    static constexpr int64_t LIVENESS_PERIOD_MS = 1000;  // a worker quiet this long is probed
+    static constexpr int64_t LIVENESS_TIMEOUT_MS = 30000; // longer than any command, e.g. an envelope sweep
+
+private:
+    struct Worker
+    {
+        std::string idstr;
+        uint32_t hash = 0;
+        int port = 0;
+        std::vector<int> cpus;
+        int adio_bit = -1;
+        pid_t pid = -1;
+        uint64_t restarts = 0;
+        int64_t started_ms = 0;
+        int64_t restart_at_ms = 0; // while pid < 0
+        int64_t backoff_ms = RESTART_BACKOFF_MIN_MS;
+        int64_t probe_ms = 0; // last liveness probe sent
+        bool killed = false;  // hung, SIGKILL sent
+    };
+
+    std::string exe;
+    ServerConfig config;
+    std::vector<uint32_t> camids; // every camera found, as the list command reports them
+    std::vector<Worker> workers; // by backend index
+    std::string probe_buf;
+    void spawn(Worker &w, int64_t now)
+    {
+        std::string port = std::to_string(w.port);
+        std::string minor = std::to_string(config.adio_minor);
+        std::string budget = std::to_string(config.buffer_budget_mb);
+        std::string bit = w.idstr + ":" + std::to_string(w.adio_bit);
+        std::vector<const char *> argv = {exe.c_str(), "-w", "-p", port.c_str(), "-a", minor.c_str(), "-c", w.idstr.c_str(), "-b", budget.c_str()};
+        if (w.adio_bit >= 0)
+        {
+            argv.push_back("-m");
+            argv.push_back(bit.c_str());
+        }
+        argv.push_back(NULL);
+        pid_t pid = fork();
+        if (pid < 0)
+        {
+            ZSYS_ERROR("Camera %s: could not fork worker: %s", w.idstr.c_str(), strerror(errno));
+            w.restart_at_ms = now + w.backoff_ms;
+            return;
+        }
+        if (pid == 0)
+        {
+            // no logging here, the child shares the parent's ZMQ state until exec
+            prctl(PR_SET_PDEATHSIG, SIGTERM);
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            for (int cpu : w.cpus)
+                CPU_SET(cpu, &set);
+            // inherited across exec, and by the VmbC threads the worker starts
+            if (!w.cpus.empty())
+                sched_setaffinity(0, sizeof(set), &set);
+            execv(exe.c_str(), (char *const *)argv.data());
+            _exit(127);
+        }
+        w.pid = pid;
+        w.started_ms = now;
+        w.probe_ms = 0;
+        w.killed = false;
+        std::string cpus;
+        for (int cpu : w.cpus)
+            cpus += (cpus.empty() ? "" : ",") + std::to_string(cpu);
+        ZSYS_INFO("Camera %s: worker %d on port %d, CPUs %s.", w.idstr.c_str(), pid, w.port, cpus.c_str());
+    }
+
+    // collect exited workers and schedule their restart
+    void reap(int64_t now)
+    {
+        int status;
+        pid_t pid;
+        while ((pid = waitpid(-1, &status, WNOHANG)) > 0)
+        {
+            for (Worker &w : workers)
+            {
+                if (w.pid != pid)
+                    continue;
+                if (WIFSIGNALED(status))
+                {
+                    ZSYS_ERROR("Camera %s: worker %d killed by signal %d (%s).", w.idstr.c_str(), pid, WTERMSIG(status), strsignal(WTERMSIG(status)));
+                }
+                else
+                {
+                    ZSYS_WARNING("Camera %s: worker %d exited with status %d.", w.idstr.c_str(), pid, WEXITSTATUS(status));
+                }
+                w.pid = -1;
+                if (now - w.started_ms >= STABLE_RUN_MS)
+                    w.backoff_ms = RESTART_BACKOFF_MIN_MS;
+                w.restart_at_ms = now + w.backoff_ms;
+                w.backoff_ms = std::min(w.backoff_ms * 2, RESTART_BACKOFF_MAX_MS);
+            }
+        }
+        if (quitting)
+            return;
+        for (Worker &w : workers)
+        {
+            if (w.pid < 0 && now >= w.restart_at_ms)
+            {
+                if (w.started_ms != 0)
+                    w.restarts++;
+                spawn(w, now);
+            }
+        }
+    }
+
+    /**
+     * @brief Kill workers that stopped answering, e.g. hung in VmbC; reap
+     * restarts them. A worker quiet for LIVENESS_PERIOD_MS gets a list
+     * request, which needs no camera; its reply is dropped in collect(), no
+     * fan-out has ID 0.
+     */
+    void check_liveness(int64_t now)
+    {
+        for (size_t i = 0; i < workers.size(); i++)
+        {
+            Worker &w = workers[i];
+            Backend &b = backends[i];
+            if (w.pid <= 0 || w.killed || quitting)
+                continue;
+            int64_t last_ms = std::max(b.last_reply_ms, w.started_ms);
+            if (now - last_ms > LIVENESS_TIMEOUT_MS)
+            {
+                ZSYS_ERROR("Camera %s: worker %d has not answered for %ld ms, killing it.", w.idstr.c_str(), w.pid, now - last_ms);
+                kill(w.pid, SIGKILL);
+                w.killed = true;
+                continue;
+            }
+            // one probe outstanding at a time
+            if (now - last_ms >= LIVENESS_PERIOD_MS && w.probe_ms <= last_ms)
+            {
+                send_frames(zsock_resolve(b.req), {"", "0"}, 2, probe_buf);
+                w.probe_ms = now;
+            }
+        }
+    }
+
+    // cores for the workers, from the configured CPUs or else the affinity
+    // mask; the first one stays with the front end if there are enough
+    void assign_cpus()
+    {
+        std::vector<int> cpus = config.cpus;
+        if (cpus.empty())
+        {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            if (sched_getaffinity(0, sizeof(set), &set) != 0)
+            {
+                ZSYS_WARNING("Could not read CPU affinity, workers are not pinned: %s", strerror(errno));
+                return;
+            }
+            for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+            {
+                if (CPU_ISSET(cpu, &set))
+                    cpus.push_back(cpu);
+            }
+        }
+        size_t first = cpus.size() > workers.size() ? 1 : 0;
+        size_t navail = cpus.size() - first;
+        size_t per = std::max<size_t>(1, navail / workers.size());
+        for (size_t i = 0; i < workers.size(); i++)
+        {
+            for (size_t k = 0; k < per; k++)
+                workers[i].cpus.push_back(cpus[first + (i * per + k) % navail]);
+        }
+    }
+
+    bool backend_up(size_t idx) const override
+    {
+        return workers[idx].pid > 0;
+    }
+
+    bool serve_local(void *front, size_t nenvelope, CmdType type) override
+    {
+        if (type != CmdType::List)
+            return false;
+        std::vector<std::string> list;
+        for (uint32_t hash : camids)
+            list.push_back(std::to_string(hash));
+        reply_direct(front, nenvelope, VmbErrorSuccess, list);
+        return true;
+    }
+
+    void append_metrics(std::vector<std::string> &merged) override
+    {
+        for (Worker &w : workers)
+        {
+            std::string prefix = "supervisor." + std::to_string(w.hash) + ".";
+            merged.push_back(prefix + "running");
+            merged.push_back(w.pid > 0 ? "True" : "False");
+            merged.push_back(prefix + "restarts");
+            merged.push_back(std::to_string(w.restarts));
+        }
+    }
+
+    void stop_workers()
+    {
+        for (Worker &w : workers)
+        {
+            if (w.pid > 0)
+                kill(w.pid, SIGTERM);
+        }
+        int64_t deadline = zclock_mono() + 5000;
+        for (Worker &w : workers)
+        {
+            while (w.pid > 0)
+            {
+                pid_t pid = waitpid(w.pid, NULL, WNOHANG);
+                if (pid == w.pid || pid < 0)
+                {
+                    w.pid = -1;
+                    break;
+                }
+                if (zclock_mono() > deadline)
+                {
+                    ZSYS_WARNING("Camera %s: worker %d did not exit, killing it.", w.idstr.c_str(), w.pid);
+                    kill(w.pid, SIGKILL);
+                    waitpid(w.pid, NULL, 0);
+                    w.pid = -1;
+                    break;
+                }
+                zclock_sleep(10);
+            }
+        }
+    }
+
+public:
+    Supervisor(const ServerConfig &config)
+    {
+        this->config = config;
+        char path[4096];
+        ssize_t len = readlink("/proc/self/exe", path, sizeof(path) - 1);
+        if (len > 0)
+            exe.assign(path, len);
+    }
+
+    ~Supervisor()
+    {
+        stop_workers();
+    }
+
+    /**
+     * @brief Find the cameras and set up aDIO once for all workers.
+     * Worker ports follow the front end port.
+     */
+    VmbError_t open()
+    {
+        int port = config.port();
+        if (exe.empty())
+        {
+            ZSYS_ERROR("Could not find the server executable.");
+            return VmbErrorNotFound;
+        }
+        VmbError_t err = allied_init_api(NULL);
+        if (err != VmbErrorSuccess)
+        {
+            ZSYS_ERROR("Failed to initialize Allied Vision API: %s", allied_strerr(err));
+            return err;
+        }
+        VmbUint32_t count;
+        VmbCameraInfo_t *vmbcaminfos;
+        err = allied_list_cameras(&vmbcaminfos, &count);
+        if (err != VmbErrorSuccess)
+        {
+            ZSYS_ERROR("Failed to list cameras: %s", allied_strerr(err));
+            allied_close_api();
+            return err;
+        }
+        StringHasher hasher = StringHasher(); // same hashes as the workers compute
+        for (VmbUint32_t idx = 0; idx < count; idx++)
+        {
+            CameraInfo caminfo = CameraInfo(vmbcaminfos[idx]);
+            uint32_t hash = hasher.get_hash(caminfo.idstr);
+            camids.push_back(hash);
+            if (!config.serves_camera(caminfo.idstr, caminfo.serial))
+                continue;
+            Worker w;
+            w.idstr = caminfo.idstr;
+            w.hash = hash;
+            w.adio_bit = config.adio_bit_for(caminfo.idstr, caminfo.serial);
+            w.port = port + WORKER_PORT_OFFSET + WORKER_PORT_STRIDE * (int)workers.size();
+            routes[hash] = workers.size();
+            workers.push_back(w);
+        }
+        free(vmbcaminfos);
+        // the workers open the cameras themselves
+        allied_close_api();
+        if (workers.size() == 0)
+        {
+            ZSYS_ERROR("No cameras found.");
+            return VmbErrorNotFound;
+        }
+        if (workers.back().port + WORKER_PORT_STRIDE - 1 > 65535)
+        {
+            ZSYS_ERROR("Not enough ports above %d for %lu workers.", port, workers.size());
+            return VmbErrorBadParameter;
+        }
+        DeviceHandle adio_dev = nullptr;
+        if (config.adio_minor >= 0 && OpenDIO_aDIO(&adio_dev, config.adio_minor) == 0)
+        {
+            CaptureManager::reset_adio_port(adio_dev);
+            CloseDIO_aDIO(adio_dev);
+        }
+        assign_cpus();
+        return VmbErrorSuccess;
+    }
+
+    int run()
+    {
+        if (!bind(config.endpoint, config.get_control_endpoint(), config.get_notify_endpoint()))
+            return 1;
+        for (Worker &w : workers)
+            connect_backend(w.idstr, std::to_string(w.hash), "127.0.0.1", w.port);
+        NetPacket probe;
+        probe.cmd_type = "list";
+        probe.cam_id = "";
+        encode_netpacket(probe, probe_buf);
+        ZSYS_INFO("Supervising %lu workers on %s.", workers.size(), config.endpoint.c_str());
+        while (!zsys_interrupted && !(quitting && fanouts.empty()))
+        {
+            zpoller_wait(poller, 100);
+            int64_t now = zclock_mono();
+            check_liveness(now);
+            reap(now);
+            relay(now);
+        }
+        if (zsys_interrupted)
+        {
+            ZSYS_INFO("Received SIGINT.");
+        }
+        stop_workers();
+        return 0;
+    }
+};
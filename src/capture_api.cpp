@@ -0,0 +1,111 @@
+/**
+ * @file capture_api.cpp
+ * @brief C API of the capture library, over CaptureManager.
+ *
+ */
+
+#include <string.h>
+#include <czmq.h>
+#include <new>
+
+#include "capture_api.h"
+#include "capture_manager.hpp"
+
+struct capture_manager
+{
+    CaptureManager manager;
+    NetPacket packet; // reused across commands
+};
+
+capture_manager_t *capture_manager_new(void)
+{
+    return new (std::nothrow) capture_manager_t();
+}
+
+void capture_manager_free(capture_manager_t *mgr)
+{
+    delete mgr;
+}
+
+int32_t capture_manager_open(capture_manager_t *mgr, const char *camera_id, int adio_minor)
+{
+    if (mgr == NULL)
+        return VmbErrorBadParameter;
+    ServerConfig config;
+    if (camera_id != NULL && camera_id[0] != '\0')
+        config.cameras.push_back(camera_id);
+    config.adio_minor = adio_minor;
+    return mgr->manager.open(config);
+}
+
+void capture_manager_close(capture_manager_t *mgr)
+{
+    if (mgr != NULL)
+        mgr->manager.close();
+}
+
+int32_t capture_manager_cameras(capture_manager_t *mgr, uint32_t *ids, size_t max, size_t *count)
+{
+    if (mgr == NULL || count == NULL)
+        return VmbErrorBadParameter;
+    std::vector<uint32_t> camids = mgr->manager.camera_ids();
+    *count = camids.size();
+    if (ids == NULL)
+        return VmbErrorSuccess;
+    for (size_t i = 0; i < camids.size() && i < max; i++)
+        ids[i] = camids[i];
+    return camids.size() > max ? VmbErrorMoreData : VmbErrorSuccess;
+}
+
+int32_t capture_manager_command(capture_manager_t *mgr, const char *cmd_type, uint32_t cam_id, int command, const char *const *args, size_t nargs)
+{
+    if (mgr == NULL || cmd_type == NULL || (args == NULL && nargs > 0))
+        return VmbErrorBadParameter;
+    NetPacket &packet = mgr->packet;
+    packet.cmd_type = cmd_type;
+    packet.cam_id = cam_id != 0 ? std::to_string(cam_id) : "";
+    packet.command = command;
+    packet.arguments.resize(nargs);
+    for (size_t i = 0; i < nargs; i++)
+        packet.arguments[i] = args[i] != NULL ? args[i] : "";
+    return mgr->manager.execute(packet);
+}
+
+size_t capture_manager_reply_count(const capture_manager_t *mgr)
+{
+    return mgr != NULL ? mgr->manager.reply().size() : 0;
+}
+
+int32_t capture_manager_reply(const capture_manager_t *mgr, size_t idx, char *buf, size_t len)
+{
+    if (mgr == NULL || buf == NULL || len == 0 || idx >= mgr->manager.reply().size())
+        return VmbErrorBadParameter;
+    std::string_view arg = mgr->manager.reply()[idx];
+    size_t n = arg.size() < len - 1 ? arg.size() : len - 1;
+    memcpy(buf, arg.data(), n);
+    buf[n] = '\0';
+    return n < arg.size() ? VmbErrorMoreData : VmbErrorSuccess;
+}
+
+void capture_manager_poll(capture_manager_t *mgr)
+{
+    if (mgr != NULL)
+        mgr->manager.poll(zclock_mono());
+}
+
+int64_t capture_manager_poll_timeout(const capture_manager_t *mgr, int64_t max_ms)
+{
+    return mgr != NULL ? mgr->manager.poll_timeout(max_ms) : max_ms;
+}
+
+int capture_manager_quit_requested(const capture_manager_t *mgr)
+{
+    return mgr != NULL && mgr->manager.quit_requested();
+}
+
+int32_t capture_manager_set_frame_callback(capture_manager_t *mgr, uint32_t cam_id, capture_frame_cb_t cb, void *user)
+{
+    if (mgr == NULL)
+        return VmbErrorBadParameter;
+    return mgr->manager.set_frame_callback(cam_id, cb, user);
+}
@@ -0,0 +1,1339 @@
+/**
+ * @file capture_manager.cpp
+ * @brief Camera setup and command handlers of the capture server, shared
+ * with programs that embed the capture library.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <string.h>
+#include <czmq.h>
+#include <math.h>
+#include <vector>
+#include <map>
+#include <string>
+#include <charconv>
+#include <algorithm>
+
+#include "capture_manager.hpp"
+#include "framebundle.hpp"
+#include "featurenotify.hpp"
+#include "stringhasher.hpp"
+#include "string_format.hpp"
+
+// name, value pairs; prefix distinguishes cameras when several are reported
+static void append_metrics(ReplyArena &reply, std::string_view prefix, ImageCam *image_cam)
+{
+    uint64_t nstalls, nrecoveries, nfailures;
+    image_cam->get_watchdog_stats(nstalls, nrecoveries, nfailures);
+    reply.push_join(prefix, "frames");
+    reply.push_back(image_cam->get_frames());
+    reply.push_join(prefix, "capturing");
+    reply.push_back(image_cam->running());
+    reply.push_join(prefix, "stalled");
+    reply.push_back(image_cam->is_stalled() ? "True" : "False");
+    reply.push_join(prefix, "stalls");
+    reply.push_back(nstalls);
+    reply.push_join(prefix, "recoveries");
+    reply.push_back(nrecoveries);
+    reply.push_join(prefix, "recovery_failures");
+    reply.push_back(nfailures);
+    reply.push_join(prefix, "feature_invalidations");
+    reply.push_back(image_cam->feature_watch.invalidations());
+    reply.push_join(prefix, "start_us");
+    reply.push_back(image_cam->start_all_us);
+    StreamStats stats, delta;
+    image_cam->get_stream_stats(stats, delta);
+    if (stats.available)
+    {
+        reply.push_join(prefix, "stream.frames_delivered");
+        reply.push_back(stats.frames_delivered);
+        reply.push_join(prefix, "stream.frames_dropped");
+        reply.push_back(stats.frames_dropped);
+        reply.push_join(prefix, "stream.frames_underrun");
+        reply.push_back(stats.frames_underrun);
+        reply.push_join(prefix, "stream.packets_received");
+        reply.push_back(stats.packets_received);
+        reply.push_join(prefix, "stream.packets_missed");
+        reply.push_back(stats.packets_missed);
+        reply.push_join(prefix, "stream.packets_resent");
+        reply.push_back(stats.packets_resent);
+        reply.push_join(prefix, "stream.packets_requested");
+        reply.push_back(stats.packets_requested);
+    }
+}
+
+// frames dropped, packets missed, packets resent; -1 if the transport has no stream statistics
+static void append_stream_status(ReplyArena &reply, ImageCam *image_cam)
+{
+    StreamStats stats, delta;
+    image_cam->get_stream_stats(stats, delta);
+    reply.push_back(stats.available ? stats.frames_dropped : -1);
+    reply.push_back(stats.available ? stats.packets_missed : -1);
+    reply.push_back(stats.available ? stats.packets_resent : -1);
+}
+
+// camera feature writes shared by set and reconfigure; read-back values are appended to reply
+static VmbError_t set_camera_feature(ImageCam *image_cam, int command, const std::vector<std::string> &arguments, ReplyArena &reply)
+{
+    VmbError_t err = VmbErrorSuccess;
+    if (arguments.size() < 1)
+    {
+        return VmbErrorNoData;
+    }
+    const char *argument = arguments[0].c_str();
+    if (feature_dispatch(command, [&](auto idx)
+                         { err = feature_set_reply<decltype(idx)::value>(image_cam->handle, image_cam->feature_cache, image_cam->get_info().idstr.c_str(), argument, reply); }))
+    {
+        return err;
+    }
+    switch (command)
+    {
+    case CommandNames::image_size:
+    {
+        if (arguments.size() != 2)
+        {
+            err = VmbErrorWrongType;
+            break;
+        }
+        VmbInt64_t arg1l = atol(arguments[0].c_str());
+        VmbInt64_t arg2l = atol(arguments[1].c_str());
+        ZSYS_INFO("set (%s): image_size -> %ld x %ld", image_cam->get_info().idstr.c_str(), arg1l, arg2l);
+        err = allied_set_image_size(image_cam->handle, arg1l, arg2l);
+        image_cam->feature_cache.invalidate(feature_invalidation_mask(DEP_ROI));
+        if (err != VmbErrorSuccess)
+        {
+            break;
+        }
+        err = allied_get_image_size(image_cam->handle, &arg1l, &arg2l);
+        ZSYS_INFO("set (%s): image_size = %ld x %ld", image_cam->get_info().idstr.c_str(), arg1l, arg2l);
+        reply.push_back(arg1l);
+        reply.push_back(arg2l);
+        break;
+    }
+    case CommandNames::image_ofst:
+    {
+        if (arguments.size() != 2)
+        {
+            err = VmbErrorWrongType;
+            break;
+        }
+        VmbInt64_t arg1l = atol(arguments[0].c_str());
+        VmbInt64_t arg2l = atol(arguments[1].c_str());
+        ZSYS_INFO("set (%s): image_ofst -> %ld x %ld", image_cam->get_info().idstr.c_str(), arg1l, arg2l);
+        err = allied_set_image_ofst(image_cam->handle, arg1l, arg2l);
+        image_cam->feature_cache.invalidate(feature_invalidation_mask(DEP_ROI));
+        if (err != VmbErrorSuccess)
+        {
+            break;
+        }
+        err = allied_get_image_ofst(image_cam->handle, &arg1l, &arg2l);
+        ZSYS_INFO("set (%s): image_ofst = %ld x %ld", image_cam->get_info().idstr.c_str(), arg1l, arg2l);
+        reply.push_back(arg1l);
+        reply.push_back(arg2l);
+        break;
+    }
+    case CommandNames::adio_bit:
+    {
+        long arg1l = atol(argument);
+        image_cam->adio_bit = arg1l;
+        ZSYS_INFO("set (%s): adio_bit = %d", image_cam->get_info().idstr.c_str(), image_cam->adio_bit);
+        reply.push_back(arg1l);
+        break;
+    }
+    case CommandNames::hdr_output:
+    {
+        err = image_cam->set_hdr_output(argument);
+        ZSYS_INFO("set (%s): hdr_output = %s (%s)", image_cam->get_info().idstr.c_str(), image_cam->get_hdr_output().c_str(), allied_strerr(err));
+        reply.push_back(image_cam->get_hdr_output());
+        break;
+    }
+    case CommandNames::adio_mode:
+    {
+        AdioMode mode;
+        if (strcasecmp(argument, "frame") == 0)
+            mode = AdioMode::Frame;
+        else if (strcasecmp(argument, "exposure") == 0)
+            mode = AdioMode::Exposure;
+        else
+        {
+            err = VmbErrorInvalidValue;
+            break;
+        }
+        err = image_cam->set_adio_mode(mode);
+        const char *cur = image_cam->get_adio_mode() == AdioMode::Exposure ? "exposure" : "frame";
+        ZSYS_INFO("set (%s): adio_mode = %s (%s)", image_cam->get_info().idstr.c_str(), cur, allied_strerr(err));
+        reply.push_back(cur);
+        break;
+    }
+    default:
+    {
+        err = VmbErrorWrongType; // wrong command
+        break;
+    }
+    }
+    return err;
+}
+
+// option lists from the shared per-model capability table
+static VmbError_t get_capability_list(ImageCam *image_cam, int command, ReplyArena &reply)
+{
+    if (command == CommandNames::image_format_list)
+    {
+        // depends on the selected sensor bit depth, not cached
+        static thread_local std::vector<std::string> formats;
+        VmbError_t err = fetch_capability_list(allied_get_image_format_list, image_cam->handle, formats);
+        reply.append(formats);
+        return err;
+    }
+    std::shared_ptr<const Capabilities> caps = image_cam->get_capabilities();
+    if (caps == nullptr || !caps->complete())
+    {
+        // an earlier fetch failed, try again
+        image_cam->load_capabilities();
+        caps = image_cam->get_capabilities();
+    }
+    if (caps == nullptr)
+    {
+        return VmbErrorNotAvailable;
+    }
+    const std::vector<std::string> *list = nullptr;
+    VmbError_t err = VmbErrorSuccess;
+    switch (command)
+    {
+    case CommandNames::triglines_list:
+        list = &caps->triglines;
+        err = caps->triglines_err;
+        break;
+    case CommandNames::sensor_bit_depth_list:
+        list = &caps->sensor_bit_depths;
+        err = caps->sensor_bit_depths_err;
+        break;
+    case CommandNames::trigline_src_list:
+    {
+        // sources of the selected line
+        const char *line = nullptr;
+        err = feature_get<feature_index(CommandNames::trigline)>(image_cam->handle, image_cam->feature_cache, line);
+        if (err != VmbErrorSuccess)
+            break;
+        auto it = caps->trigline_srcs.find(line);
+        if (it == caps->trigline_srcs.end())
+            err = caps->trigline_srcs_err != VmbErrorSuccess ? caps->trigline_srcs_err : VmbErrorNotFound;
+        else
+            list = &it->second;
+        break;
+    }
+    default:
+        err = VmbErrorWrongType;
+        break;
+    }
+    if (list != nullptr)
+    {
+        reply.append(*list);
+    }
+    return err;
+}
+
+// number of arguments a camera feature set command takes, 0 if the id is not
+// one; server side settings like hdr_output and adio_mode take the capture lock
+// and cannot be applied inside a reconfigure
+static size_t set_command_nargs(int command)
+{
+    switch (command)
+    {
+    case CommandNames::image_size:
+    case CommandNames::image_ofst:
+        return 2;
+    default:
+        return feature_index(command) < NFEATURES ? 1 : 0;
+    }
+}
+
+typedef VmbError_t (*CmdHandler)(CaptureState &state, NetPacket &packet, uint32_t chash);
+
+static VmbError_t cmd_invalid(CaptureState &state, NetPacket &packet, uint32_t chash)
+{
+    return VmbErrorBadParameter; // wrong command
+}
+
+static VmbError_t cmd_quit(CaptureState &state, NetPacket &packet, uint32_t chash)
+{
+    VmbError_t err = VmbErrorSuccess;
+    ZSYS_INFO("Received quit command.");
+    state.quit = true;
+    state.start_at_us = 0;
+    return err;
+}
+
+// should be sent every second by client if idle
+static VmbError_t cmd_status(CaptureState &state, NetPacket &packet, uint32_t chash)
+{
+    VmbError_t err = VmbErrorSuccess;
+    // status
+    ReplyArena &reply = state.reply;
+    if (packet.cam_id != "")
+    {
+        try
+        {
+            ImageCam *image_cam = state.imagecams.at(chash);
+            double temp;
+            const char *tempsrc;
+            allied_get_temperature(image_cam->handle, &temp);
+            allied_get_temperature_src(image_cam->handle, &tempsrc);
+            reply.push_back(image_cam->running() ? "True" : "False");
+            reply.push_back(tempsrc);
+            reply.push_back(temp);
+            append_stream_status(reply, image_cam);
+            ZSYS_INFO("Camera %s: %s -> %.2f C", image_cam->get_info().idstr.c_str(), tempsrc, temp);
+        }
+        catch (const std::out_of_range &oor)
+        {
+            err = VmbErrorNotFound;
+        }
+    }
+    else
+    {
+        for (auto &image_cam_pair : state.imagecams)
+        {
+            double temp;
+            const char *tempsrc;
+            allied_get_temperature(image_cam_pair.second->handle, &temp);
+            allied_get_temperature_src(image_cam_pair.second->handle, &tempsrc);
+            reply.push_back(image_cam_pair.first);
+            reply.push_back(image_cam_pair.second->get_info().idstr);
+            reply.push_back(image_cam_pair.second->running() ? "True" : "False");
+            reply.push_back(tempsrc);
+            reply.push_back(temp);
+            append_stream_status(reply, image_cam_pair.second);
+            ZSYS_INFO("Camera %s: %s -> %.2f C", image_cam_pair.second->get_info().idstr.c_str(), tempsrc, temp);
+        }
+    }
+    return err;
+}
+
+static VmbError_t cmd_metrics(CaptureState &state, NetPacket &packet, uint32_t chash)
+{
+    VmbError_t err = VmbErrorSuccess;
+    ReplyArena &reply = state.reply;
+    if (packet.cam_id != "")
+    {
+        try
+        {
+            append_metrics(reply, "", state.imagecams.at(chash));
+        }
+        catch (const std::out_of_range &oor)
+        {
+            err = VmbErrorNotFound;
+        }
+    }
+    else
+    {
+        for (auto &image_cam_pair : state.imagecams)
+        {
+            char prefix[16];
+            std::to_chars_result res = std::to_chars(prefix, prefix + sizeof(prefix) - 1, image_cam_pair.first);
+            *res.ptr++ = '.';
+            append_metrics(reply, std::string_view(prefix, res.ptr - prefix), image_cam_pair.second);
+        }
+        // server wide; the clock lets a coordinator estimate this host's offset
+        reply.push_back("server.clock_us");
+        reply.push_back(host_realtime_us());
+        if (state.notifier != nullptr)
+        {
+            uint64_t npublished, nflagged;
+            state.notifier->get_stats(npublished, nflagged);
+            reply.push_back("server.feature_changes_published");
+            reply.push_back(npublished);
+            reply.push_back("server.feature_changes_flagged");
+            reply.push_back(nflagged);
+        }
+        if (state.metrics_hook)
+            state.metrics_hook(reply);
+    }
+    return err;
+}
+
+static VmbError_t cmd_sequence(CaptureState &state, NetPacket &packet, uint32_t chash)
+{
+    VmbError_t err = VmbErrorSuccess;
+    // arguments: passes (0 = until stopped), then exposure (us) and frame count per step; starts capture
+    try
+    {
+        ImageCam *image_cam = state.imagecams.at(chash);
+        if (packet.arguments.size() < 3 || packet.arguments.size() % 2 != 1)
+        {
+            err = VmbErrorBadParameter;
+        }
+        else
+        {
+            uint32_t repeats = atol(packet.arguments[0].c_str());
+            std::vector<SeqStep> steps;
+            for (size_t idx = 1; idx + 1 < packet.arguments.size(); idx += 2)
+            {
+                SeqStep step;
+                step.exposure_us = atof(packet.arguments[idx].c_str());
+                step.frames = atol(packet.arguments[idx + 1].c_str());
+                steps.push_back(step);
+            }
+            err = image_cam->set_sequence(steps, repeats);
+            if (err == VmbErrorSuccess)
+                err = image_cam->start_capture();
+        }
+        ZSYS_INFO("sequence (%s): %lu steps: %s", image_cam->get_info().idstr.c_str(), image_cam->sequence_length(), allied_strerr(err));
+    }
+    catch (const std::out_of_range &oor)
+    {
+        err = VmbErrorNotFound;
+    }
+    return err;
+}
+
+static VmbError_t cmd_reconfigure(CaptureState &state, NetPacket &packet, uint32_t chash)
+{
+    VmbError_t err = VmbErrorSuccess;
+    // arguments: command id followed by its set arguments, repeated; applied in order
+    ReplyArena &reply = state.reply;
+    try
+    {
+        ImageCam *image_cam = state.imagecams.at(chash);
+        ReplyArena readback;
+        int64_t downtime_us = 0;
+        bool realloc = false;
+        err = image_cam->reconfigure([&]()
+                                     {
+            VmbError_t ret = VmbErrorSuccess;
+            size_t idx = 0;
+            while (idx < packet.arguments.size() && ret == VmbErrorSuccess)
+            {
+                int command = atoi(packet.arguments[idx].c_str());
+                size_t nargs = set_command_nargs(command);
+                if (nargs == 0)
+                {
+                    ret = VmbErrorBadParameter;
+                    break;
+                }
+                if (idx + 1 + nargs > packet.arguments.size())
+                {
+                    ret = VmbErrorNoData;
+                    break;
+                }
+                std::vector<std::string> args(packet.arguments.begin() + idx + 1, packet.arguments.begin() + idx + 1 + nargs);
+                ret = set_camera_feature(image_cam, command, args, readback);
+                idx += 1 + nargs;
+            }
+            return ret; }, downtime_us, realloc);
+        ZSYS_INFO("reconfigure (%s): %ld us downtime, buffers %s (%s)", image_cam->get_info().idstr.c_str(), downtime_us, realloc ? "reallocated" : "reused", allied_strerr(err));
+        image_cam->feature_watch.mark_all_dirty();
+        reply.push_back(downtime_us);
+        reply.push_back(realloc ? "True" : "False");
+        reply.push_back(allied_get_frame_size(image_cam->handle));
+        reply.append(readback);
+    }
+    catch (const std::out_of_range &oor)
+    {
+        err = VmbErrorNotFound;
+    }
+    return err;
+}
+
+static VmbError_t cmd_feature(CaptureState &state, NetPacket &packet, uint32_t chash)
+{
+    VmbError_t err = VmbErrorSuccess;
+    // arguments: feature name, value (set only); reply: type, value
+    try
+    {
+        ImageCam *image_cam = state.imagecams.at(chash);
+        bool is_set = packet.cmd_type == "set_feature";
+        if (packet.arguments.size() < (is_set ? 2 : 1))
+        {
+            err = VmbErrorBadParameter;
+        }
+        else
+        {
+            char buf[FEATURE_TEXT_MAX] = "None";
+            const FeatureEntry *entry = nullptr;
+            const std::string &name = packet.arguments[0];
+            if (is_set)
+            {
+                err = image_cam->feature_map.set(name, packet.arguments[1].c_str(), buf, sizeof(buf), &entry);
+                image_cam->feature_cache.invalidate_all(); // relation to the typed features unknown
+                image_cam->feature_watch.mark_all_dirty();
+                ZSYS_INFO("set_feature (%s): %s %s -> %s (%s)", image_cam->get_info().idstr.c_str(), name.c_str(), packet.arguments[1].c_str(), buf, allied_strerr(err));
+            }
+            else
+            {
+                err = image_cam->feature_map.get(name, buf, sizeof(buf), &entry);
+                ZSYS_INFO("get_feature (%s): %s = %s (%s)", image_cam->get_info().idstr.c_str(), name.c_str(), buf, allied_strerr(err));
+            }
+            if (entry != nullptr)
+            {
+                state.reply.push_back(feature_type_name(entry->type));
+                state.reply.push_back(buf);
+            }
+        }
+    }
+    catch (const std::out_of_range &oor)
+    {
+        err = VmbErrorNotFound;
+    }
+    return err;
+}
+
+// features watched when subscribe names none
+static const char *default_watch_features[] = {"ExposureTime", "AcquisitionFrameRate", "TriggerSelector", "TriggerMode", "TriggerSource"};
+
+static VmbError_t cmd_subscribe(CaptureState &state, NetPacket &packet, uint32_t chash)
+{
+    VmbError_t err = VmbErrorSuccess;
+    // arguments: feature names, default set if none; reply: the features now watched.
+    // Changes are published on the notification endpoint (port + 3 in the server), topic "feature:<cam_id>"
+    try
+    {
+        ImageCam *image_cam = state.imagecams.at(chash);
+        if (state.notifier == nullptr)
+        {
+            err = VmbErrorNotAvailable;
+        }
+        else if (packet.arguments.size() == 0)
+        {
+            for (const char *name : default_watch_features)
+                image_cam->feature_watch.watch(image_cam->feature_map, name); // best effort, models differ
+        }
+        else
+        {
+            for (const std::string &name : packet.arguments)
+            {
+                VmbError_t ret = image_cam->feature_watch.watch(image_cam->feature_map, name);
+                if (ret != VmbErrorSuccess)
+                    err = ret;
+            }
+        }
+        for (const std::string &name : image_cam->feature_watch.get_names())
+            state.reply.push_back(name);
+        ZSYS_INFO("subscribe (%s): %zu features watched (%s)", image_cam->get_info().idstr.c_str(), state.reply.size(), allied_strerr(err));
+    }
+    catch (const std::out_of_range &oor)
+    {
+        err = VmbErrorNotFound;
+    }
+    return err;
+}
+
+static VmbError_t cmd_unsubscribe(CaptureState &state, NetPacket &packet, uint32_t chash)
+{
+    VmbError_t err = VmbErrorSuccess;
+    // arguments: feature names, all if none; reply: the features still watched
+    try
+    {
+        ImageCam *image_cam = state.imagecams.at(chash);
+        if (packet.arguments.size() == 0)
+        {
+            image_cam->feature_watch.unwatch_all();
+        }
+        else
+        {
+            for (const std::string &name : packet.arguments)
+            {
+                VmbError_t ret = image_cam->feature_watch.unwatch(name);
+                if (ret != VmbErrorSuccess)
+                    err = ret;
+            }
+        }
+        for (const std::string &name : image_cam->feature_watch.get_names())
+            state.reply.push_back(name);
+        ZSYS_INFO("unsubscribe (%s): %zu features watched (%s)", image_cam->get_info().idstr.c_str(), state.reply.size(), allied_strerr(err));
+    }
+    catch (const std::out_of_range &oor)
+    {
+        err = VmbErrorNotFound;
+    }
+    return err;
+}
+
+static VmbError_t cmd_list_features(CaptureState &state, NetPacket &packet, uint32_t chash)
+{
+    VmbError_t err = VmbErrorSuccess;
+    // reply: name, type, access ("r", "w", "rw", "") and unit for every feature
+    try
+    {
+        ImageCam *image_cam = state.imagecams.at(chash);
+        ReplyArena &reply = state.reply;
+        for (const std::string &name : image_cam->feature_map.get_names())
+        {
+            const FeatureEntry *entry = image_cam->feature_map.find(name);
+            reply.push_back(name);
+            reply.push_back(feature_type_name(entry->type));
+            std::string access = "";
+            if (entry->flags & VmbFeatureFlagsRead)
+                access += "r";
+            if (entry->flags & VmbFeatureFlagsWrite)
+                access += "w";
+            reply.push_back(access);
+            reply.push_back(entry->unit);
+        }
+        ZSYS_INFO("list_features (%s): %zu features", image_cam->get_info().idstr.c_str(), reply.size() / 4);
+    }
+    catch (const std::out_of_range &oor)
+    {
+        err = VmbErrorNotFound;
+    }
+    return err;
+}
+
+static VmbError_t cmd_list(CaptureState &state, NetPacket &packet, uint32_t chash)
+{
+    VmbError_t err = VmbErrorSuccess;
+    // list cameras
+    for (auto &hash : state.camids)
+    {
+        state.reply.push_back(hash);
+    }
+    return err;
+}
+
+// furthest ahead a start can be scheduled
+static const int64_t START_LEAD_MAX_MS = 60000;
+// poll wakes this early for a scheduled start and spins the rest
+static const int64_t START_SPIN_US = 2000;
+// poll period while a camera runs an exposure sequence; frames past a
+// complete step are left out until poll writes the next exposure
+static const int64_t SEQ_POLL_MS = 1;
+
+// start every camera now, stamping each start
+static VmbError_t start_all_cameras(CaptureState &state)
+{
+    VmbError_t err = VmbErrorSuccess;
+    for (auto &image_cam_pair : state.imagecams)
+    {
+        image_cam_pair.second->start_all_us = host_realtime_us();
+        err = image_cam_pair.second->start_capture();
+        ZSYS_INFO("start_capture_all (%s): %s", image_cam_pair.second->get_info().idstr.c_str(), allied_strerr(err));
+        if (err != VmbErrorSuccess)
+        {
+            break;
+        }
+    }
+    return err;
+}
+
+static VmbError_t cmd_start_capture_all(CaptureState &state, NetPacket &packet, uint32_t chash)
+{
+    VmbError_t err = VmbErrorSuccess;
+    // optional argument: start time, ms since the epoch, fractions allowed; a
+    // time past starts now. A later time is kept and started from poll, so
+    // the command thread stays free until then. Scheduled starts reply name,
+    // value pairs, wall clock us: handler entry and exit for clock offset
+    // estimates, then start_at_us, or the start of each camera if it was due.
+    // Camera starts are reported as <hash>.start_us in metrics either way.
+    int64_t entry_us = host_realtime_us();
+    bool scheduled = packet.arguments.size() > 0;
+    state.start_at_us = 0; // replaces a pending start
+    int64_t start_us = scheduled ? llround(strtod(packet.arguments[0].c_str(), NULL) * 1000) : 0;
+    if (scheduled && start_us - entry_us > START_LEAD_MAX_MS * 1000)
+    {
+        return VmbErrorBadParameter;
+    }
+    bool later = scheduled && start_us > entry_us;
+    if (later)
+    {
+        state.start_at_us = start_us;
+        ZSYS_INFO("start_capture_all: scheduled in %ld us.", start_us - entry_us);
+    }
+    else
+    {
+        err = start_all_cameras(state);
+    }
+    if (scheduled)
+    {
+        state.reply.push_back("entry_us");
+        state.reply.push_back(entry_us);
+        state.reply.push_back("exit_us");
+        state.reply.push_back(host_realtime_us());
+        if (later)
+        {
+            state.reply.push_back("start_at_us");
+            state.reply.push_back(start_us);
+        }
+        else
+        {
+            for (auto &image_cam_pair : state.imagecams)
+            {
+                char name[24];
+                snprintf(name, sizeof(name), "%u.start_us", image_cam_pair.first);
+                state.reply.push_back(name);
+                state.reply.push_back(image_cam_pair.second->start_all_us);
+            }
+        }
+    }
+    return err;
+}
+
+static VmbError_t cmd_stop_capture_all(CaptureState &state, NetPacket &packet, uint32_t chash)
+{
+    VmbError_t err = VmbErrorSuccess;
+    if (state.start_at_us > 0)
+    {
+        ZSYS_INFO("stop_capture_all: scheduled start cancelled.");
+        state.start_at_us = 0;
+    }
+    for (auto &image_cam_pair : state.imagecams)
+    {
+        err = image_cam_pair.second->stop_capture();
+        ZSYS_INFO("stop_capture_all (%s): %s", image_cam_pair.second->get_info().idstr.c_str(), allied_strerr(err));
+        if (err != VmbErrorSuccess)
+        {
+            break;
+        }
+    }
+    return err;
+}
+
+static VmbError_t cmd_start_capture(CaptureState &state, NetPacket &packet, uint32_t chash)
+{
+    VmbError_t err = VmbErrorSuccess;
+    try
+    {
+        ImageCam *image_cam = state.imagecams.at(chash);
+        err = image_cam->start_capture(); // do this for specific camera id
+        uint32_t depth;
+        uint64_t bytes;
+        int64_t p50_us, p99_us;
+        image_cam->get_buffer_stats(depth, bytes, p50_us, p99_us);
+        ZSYS_INFO("start_capture (%s): %s, %u buffers (%lu bytes)", image_cam->get_info().idstr.c_str(), allied_strerr(err), depth, bytes);
+        state.reply.push_back(depth);
+        state.reply.push_back(bytes);
+    }
+    catch (const std::out_of_range &oor)
+    {
+        err = VmbErrorNotFound;
+        ZSYS_INFO("start_capture (%u): %s", chash, allied_strerr(err));
+    }
+    return err;
+}
+
+static VmbError_t cmd_stop_capture(CaptureState &state, NetPacket &packet, uint32_t chash)
+{
+    VmbError_t err = VmbErrorSuccess;
+    try
+    {
+        ImageCam *image_cam = state.imagecams.at(chash);
+        err = image_cam->stop_capture(); // do this for specific camera id
+        ZSYS_INFO("stop_capture (%s): %s", image_cam->get_info().idstr.c_str(), allied_strerr(err));
+    }
+    catch (const std::out_of_range &oor)
+    {
+        err = VmbErrorNotFound;
+        ZSYS_INFO("stop_capture (%u): %s", chash, allied_strerr(err));
+    }
+    return err;
+}
+
+static VmbError_t cmd_get(CaptureState &state, NetPacket &packet, uint32_t chash)
+{
+    VmbError_t err = VmbErrorSuccess;
+    try
+    {
+        ImageCam *image_cam = state.imagecams.at(chash);
+        ReplyArena &reply = state.reply;
+        switch (packet.command)
+        {
+        case CommandNames::trigline_src_list:
+        case CommandNames::triglines_list:
+        case CommandNames::image_format_list:
+        case CommandNames::sensor_bit_depth_list:
+        {
+            err = get_capability_list(image_cam, packet.command, reply);
+            ZSYS_INFO("get (%s): %d -> %zu entries (%s)", image_cam->get_info().idstr.c_str(), packet.command, reply.size(), allied_strerr(err));
+            break;
+        }
+        case CommandNames::frame_size:
+        {
+            uint32_t fsize = allied_get_frame_size(image_cam->handle);
+            ZSYS_INFO("get (%s): frame_size -> %d", image_cam->get_info().idstr.c_str(), fsize);
+            reply.push_back(fsize);
+            break;
+        }
+        case CommandNames::hdr_output:
+        {
+            std::string dir = image_cam->get_hdr_output();
+            ZSYS_INFO("get (%s): hdr_output -> %s", image_cam->get_info().idstr.c_str(), dir.c_str());
+            reply.push_back(dir);
+            break;
+        }
+        case CommandNames::hdr_stats:
+        {
+            uint64_t nwritten, ndropped;
+            image_cam->get_hdr_stats(nwritten, ndropped);
+            ZSYS_INFO("get (%s): hdr_stats -> %lu written, %lu dropped", image_cam->get_info().idstr.c_str(), nwritten, ndropped);
+            reply.push_back(nwritten);
+            reply.push_back(ndropped);
+            break;
+        }
+        case CommandNames::gige_tuning:
+        {
+            const GigETuneReport &report = image_cam->get_gige_report();
+            if (!report.gige)
+            {
+                err = VmbErrorNotSupported;
+                break;
+            }
+            ZSYS_INFO("get (%s): gige_tuning -> packet size %ld, MTU %ld, %lu warnings", image_cam->get_info().idstr.c_str(), report.packet_size, report.nic_mtu, report.warnings.size());
+            reply.push_back(report.packet_size_before);
+            reply.push_back(report.packet_size);
+            reply.push_back(report.nic);
+            reply.push_back(report.nic_mtu);
+            reply.push_back(report.rmem_max);
+            reply.push_back(report.cpu_us_per_frame, 1);
+            reply.append(report.warnings);
+            break;
+        }
+        case CommandNames::frame_buffers:
+        {
+            uint32_t depth;
+            uint64_t bytes;
+            int64_t p50_us, p99_us, delivery_p50_us, delivery_p99_us;
+            image_cam->get_buffer_stats(depth, bytes, p50_us, p99_us);
+            image_cam->get_delivery_latency(delivery_p50_us, delivery_p99_us);
+            ZSYS_INFO("get (%s): frame_buffers -> %u (%lu bytes), callback p50 %ld us, p99 %ld us, delivery p50 %ld us, p99 %ld us", image_cam->get_info().idstr.c_str(), depth, bytes, p50_us, p99_us, delivery_p50_us, delivery_p99_us);
+            reply.push_back(depth);
+            reply.push_back(bytes);
+            reply.push_back(p50_us);
+            reply.push_back(p99_us);
+            reply.push_back(delivery_p50_us);
+            reply.push_back(delivery_p99_us);
+            break;
+        }
+        case CommandNames::max_exposure_us:
+        {
+            double fps = 0;
+            if (packet.arguments.size() > 0)
+                fps = atof(packet.arguments[0].c_str());
+            else
+                err = allied_get_acq_framerate(image_cam->handle, &fps);
+            if (err != VmbErrorSuccess)
+                break;
+            std::string key = image_cam->envelope_key();
+            const Envelope *env = state.envelopes.find(key);
+            if (env == nullptr)
+            {
+                Envelope newenv;
+                int64_t tstart = zclock_mono();
+                err = image_cam->sweep_envelope(newenv);
+                ZSYS_INFO("get (%s): calibrated envelope %s in %ld ms (%s)", image_cam->get_info().idstr.c_str(), key.c_str(), zclock_mono() - tstart, allied_strerr(err));
+                if (err != VmbErrorSuccess)
+                    break;
+                env = state.envelopes.insert(key, newenv);
+            }
+            double exposure = env->max_exposure_at(fps);
+            if (exposure < 0)
+            {
+                err = VmbErrorInvalidValue;
+                break;
+            }
+            ZSYS_INFO("get (%s): max_exposure_us @ %.3f fps -> %.6f", image_cam->get_info().idstr.c_str(), fps, exposure);
+            reply.push_back(exposure, 6);
+            break;
+        }
+        case CommandNames::sensor_size:
+        {
+            VmbInt64_t width = 0, height = 0;
+            err = allied_get_sensor_size(image_cam->handle, &width, &height);
+            ZSYS_INFO("get (%s): sensor_size -> %ld x %ld", image_cam->get_info().idstr.c_str(), width, height);
+            reply.push_back(width);
+            reply.push_back(height);
+            break;
+        }
+        case CommandNames::image_size:
+        {
+            VmbInt64_t width = 0, height = 0;
+            err = allied_get_image_size(image_cam->handle, &width, &height);
+            ZSYS_INFO("get (%s): image_size -> %ld x %ld", image_cam->get_info().idstr.c_str(), width, height);
+            reply.push_back(width);
+            reply.push_back(height);
+            break;
+        }
+        case CommandNames::image_ofst:
+        {
+            VmbInt64_t width = 0, height = 0;
+            err = allied_get_image_ofst(image_cam->handle, &width, &height);
+            ZSYS_INFO("get (%s): image_ofst -> %ld x %ld", image_cam->get_info().idstr.c_str(), width, height);
+            reply.push_back(width);
+            reply.push_back(height);
+            break;
+        }
+        case CommandNames::adio_bit:
+        {
+            ZSYS_INFO("get (%s): adio_bit", image_cam->get_info().idstr.c_str());
+            reply.push_back(image_cam->adio_bit);
+            break;
+        }
+        case CommandNames::adio_mode:
+        {
+            const char *mode = image_cam->get_adio_mode() == AdioMode::Exposure ? "exposure" : "frame";
+            ZSYS_INFO("get (%s): adio_mode -> %s", image_cam->get_info().idstr.c_str(), mode);
+            reply.push_back(mode);
+            break;
+        }
+        case CommandNames::adio_lag:
+        {
+            uint64_t count;
+            double mean_us;
+            int64_t max_us;
+            image_cam->get_adio_lag(count, mean_us, max_us);
+            ZSYS_INFO("get (%s): adio_lag -> %lu samples, mean %.1f us, max %ld us", image_cam->get_info().idstr.c_str(), count, mean_us, max_us);
+            reply.push_back(count);
+            reply.push_back(mean_us, 1);
+            reply.push_back(max_us);
+            break;
+        }
+        case CommandNames::watchdog_periods:
+        {
+            ZSYS_INFO("get: watchdog_periods: %d", state.watchdog_periods);
+            reply.push_back(state.watchdog_periods);
+            break;
+        }
+        case CommandNames::bundle_tol:
+        {
+            if (state.bundler == nullptr)
+            {
+                err = VmbErrorNotAvailable;
+                break;
+            }
+            ZSYS_INFO("get: bundle_tol: %ld", state.bundler->get_tolerance_us());
+            reply.push_back(state.bundler->get_tolerance_us());
+            break;
+        }
+        case CommandNames::bundle_stats:
+        {
+            if (state.bundler == nullptr)
+            {
+                err = VmbErrorNotAvailable;
+                break;
+            }
+            uint64_t nbundles, nincomplete, ndropped;
+            state.bundler->get_stats(nbundles, nincomplete, ndropped);
+            ZSYS_INFO("get: bundle_stats: %lu sets, %lu incomplete, %lu dropped", nbundles, nincomplete, ndropped);
+            reply.push_back(nbundles);
+            reply.push_back(nincomplete);
+            reply.push_back(ndropped);
+            break;
+        }
+        case CommandNames::clock_sync:
+        {
+            size_t nsamples;
+            uint64_t nrejected;
+            double offset_ns, drift_ppm, rms_ns;
+            image_cam->get_clock_sync().get_model(nsamples, nrejected, offset_ns, drift_ppm, rms_ns);
+            ZSYS_INFO("get (%s): clock_sync -> %lu samples, drift %.3f ppm, rms %.0f ns", image_cam->get_info().idstr.c_str(), nsamples, drift_ppm, rms_ns);
+            reply.push_back(nsamples);
+            reply.push_back(nrejected);
+            reply.push_back(offset_ns, 0);
+            reply.push_back(drift_ppm, 3);
+            reply.push_back(rms_ns, 0);
+            break;
+        }
+        case CommandNames::frame_meta:
+        {
+            FrameMeta meta = image_cam->get_last_meta();
+            ZSYS_INFO("get (%s): frame_meta -> %lu @ %ld ns", image_cam->get_info().idstr.c_str(), meta.frame_id, meta.host_ts_ns);
+            reply.push_back(meta.frame_id);
+            reply.push_back(meta.cam_ts);
+            reply.push_back(meta.host_ts_ns);
+            reply.push_back(meta.recv_ts_ns);
+            reply.push_back(meta.seq_step);
+            reply.push_back(meta.seq_pass);
+            break;
+        }
+        case CommandNames::throughput_limit_range:
+        {
+            VmbInt64_t vmin = 0, vmax = 0;
+            err = allied_get_throughput_limit_range(image_cam->handle, &vmin, &vmax, NULL);
+            ZSYS_INFO("get (%s): throughput_limit_range -> %ld, %ld", image_cam->get_info().idstr.c_str(), vmin, vmax);
+            reply.push_back(vmin);
+            reply.push_back(vmax);
+            break;
+        }
+        case CommandNames::camera_info:
+        {
+            ZSYS_INFO("get (%s): camera_info", image_cam->get_info().idstr.c_str());
+            reply.push_back(std::to_string(image_cam->get_info()));
+        }
+        case CommandNames::capture_maxlen:
+        {
+            ZSYS_INFO("get: capture_maxlen: %ld", state.capture_timelim);
+            reply.push_back(state.capture_timelim);
+            break;
+        }
+        default:
+        {
+            // scalar features from the feature table
+            if (!feature_dispatch(packet.command, [&](auto idx)
+                                  { err = feature_get_reply<decltype(idx)::value>(image_cam->handle, image_cam->feature_cache, image_cam->get_info().idstr.c_str(), reply); }))
+            {
+                err = VmbErrorWrongType; // wrong command
+            }
+            break;
+        }
+        }
+    }
+    catch (const std::out_of_range &oor)
+    {
+        err = VmbErrorNotFound;
+    }
+    return err;
+}
+
+static VmbError_t cmd_set(CaptureState &state, NetPacket &packet, uint32_t chash)
+{
+    VmbError_t err = VmbErrorSuccess;
+    if (packet.arguments.size() < 1) // no data to set
+    {
+        ZSYS_ERROR("No data to set.");
+        err = VmbErrorNoData;
+    }
+    else
+    {
+        ReplyArena &reply = state.reply;
+        const char *argument = packet.arguments[0].c_str(); // this must exist at this point
+        try
+        {
+            ImageCam *image_cam = state.imagecams.at(chash);
+            switch (packet.command)
+            {
+            case CommandNames::capture_maxlen:
+            {
+                long arg1l = atol(argument);
+                if (arg1l < 1000)
+                {
+                    ZSYS_WARNING("Capture time limit too low, setting to 1000 ms.");
+                    arg1l = 1000;
+                }
+                state.capture_timelim = arg1l;
+                ZSYS_INFO("set: capture_maxlen = %ld", state.capture_timelim);
+                reply.push_back(arg1l);
+                break;
+            }
+            case CommandNames::watchdog_periods:
+            {
+                long arg1l = atol(argument);
+                if (arg1l < 0)
+                {
+                    err = VmbErrorInvalidValue;
+                    break;
+                }
+                state.watchdog_periods = arg1l;
+                ZSYS_INFO("set: watchdog_periods = %d", state.watchdog_periods);
+                reply.push_back(arg1l);
+                break;
+            }
+            case CommandNames::bundle_tol:
+            {
+                if (state.bundler == nullptr)
+                {
+                    err = VmbErrorNotAvailable;
+                    break;
+                }
+                long arg1l = atol(argument);
+                if (arg1l < 1)
+                {
+                    err = VmbErrorInvalidValue;
+                    break;
+                }
+                state.bundler->set_tolerance_us(arg1l);
+                ZSYS_INFO("set: bundle_tol = %ld", state.bundler->get_tolerance_us());
+                reply.push_back(arg1l);
+                break;
+            }
+            default:
+            {
+                err = set_camera_feature(image_cam, packet.command, packet.arguments, reply);
+                image_cam->feature_watch.mark_all_dirty(); // subscribers see related changes too
+                break;
+            }
+            }
+        }
+        catch (const std::out_of_range &oor)
+        {
+            err = VmbErrorNotFound;
+        }
+    }
+    return err;
+}
+
+// indexed by CmdType
+static const CmdHandler cmd_handlers[] = {
+    cmd_invalid,
+    cmd_quit,
+    cmd_status,
+    cmd_metrics,
+    cmd_sequence,
+    cmd_reconfigure,
+    cmd_feature,
+    cmd_feature,
+    cmd_list_features,
+    cmd_list,
+    cmd_start_capture_all,
+    cmd_stop_capture_all,
+    cmd_start_capture,
+    cmd_stop_capture,
+    cmd_get,
+    cmd_set,
+    cmd_subscribe,
+    cmd_unsubscribe,
+};
+static_assert(sizeof(cmd_handlers) / sizeof(cmd_handlers[0]) == (size_t)CmdType::Count, "cmd_handlers must cover CmdType");
+
+void CaptureManager::reset_adio_port(DeviceHandle adio_dev)
+{
+    // set up port A as output and set all bits to low
+    int ret = LoadPort0BitDir_aDIO(adio_dev, 1, 1, 1, 1, 1, 1, 1, 1);
+    if (ret == -1)
+    {
+        ZSYS_ERROR("Could not set PORT0 to output.");
+    }
+    else
+    {
+        ret = WritePort_aDIO(adio_dev, 0, 0); // set all to low
+        if (ret < 0)
+        {
+            ZSYS_ERROR("Could not set all PORT0 bits to LOW: %s [%d]", strerror(ret), ret);
+        }
+    }
+}
+
+VmbError_t CaptureManager::open(const ServerConfig &config)
+{
+    if (api_open)
+    {
+        return VmbErrorAlready;
+    }
+    // Set up ADIO
+    if (config.adio_minor < 0)
+    {
+        state.adio_dev = nullptr;
+    }
+    else if (OpenDIO_aDIO(&state.adio_dev, config.adio_minor) != 0)
+    {
+        ZSYS_WARNING("Could not initialize ADIO API. Check if /dev/rtd-aDIO* exists. aDIO features will be disabled.");
+        state.adio_dev = nullptr;
+    }
+    else if (!config.worker) // a supervisor shares the port with other workers and set it up already
+    {
+        reset_adio_port(state.adio_dev);
+    }
+    // Capability lists are shared by cameras of one model and firmware, and across runs
+    CapabilityRegistry::instance().set_path(CapabilityRegistry::default_path());
+
+    VmbError_t err = allied_init_api(NULL);
+    if (err != VmbErrorSuccess)
+    {
+        ZSYS_ERROR("Failed to initialize Allied Vision API: %s", allied_strerr(err));
+        close();
+        return err;
+    }
+    api_open = true;
+
+    VmbUint32_t count;
+    VmbCameraInfo_t *vmbcaminfos;
+    err = allied_list_cameras(&vmbcaminfos, &count);
+    if (err != VmbErrorSuccess)
+    {
+        ZSYS_ERROR("Failed to list cameras: %s", allied_strerr(err));
+        close();
+        return err;
+    }
+    if (count == 0)
+    {
+        ZSYS_ERROR("No cameras found.");
+        close();
+        return VmbErrorNotFound;
+    }
+    StringHasher hasher = StringHasher();
+    for (VmbUint32_t idx = 0; idx < count; idx++)
+    {
+        CameraInfo caminfo = CameraInfo(vmbcaminfos[idx]);
+        uint32_t hash = hasher.get_hash(caminfo.idstr);
+        state.camids.push_back(hash);
+        state.caminfos.insert(std::pair<uint32_t, CameraInfo>(hash, caminfo));
+        ZSYS_INFO("Camera %d: %s | %s", idx, caminfo.idstr.c_str(), caminfo.name.c_str());
+        if (!config.serves_camera(caminfo.idstr, caminfo.serial))
+        {
+            continue;
+        }
+        try
+        {
+            ImageCam *image_cam = new ImageCam(caminfo, state.adio_dev);
+            image_cam->adio_bit = config.adio_bit_for(caminfo.idstr, caminfo.serial);
+            image_cam->set_buffer_budget(config.buffer_budget_mb << 20);
+            // get must not serve values auto exposure or another client changed
+            image_cam->feature_watch.track_cache(image_cam->vmb_handle(), feature_cache_sources());
+            state.imagecams.insert(std::pair<uint32_t, ImageCam *>(hash, image_cam));
+            if (image_cam->adio_bit >= 0)
+            {
+                ZSYS_INFO("Camera %s: aDIO bit %d", caminfo.idstr.c_str(), image_cam->adio_bit);
+            }
+        }
+        catch (const std::runtime_error &e)
+        {
+            ZSYS_ERROR("Camera %s: %s", caminfo.idstr.c_str(), e.what());
+        }
+    }
+    free(vmbcaminfos);
+    for (auto &entry : config.adio_bits)
+    {
+        bool used = false;
+        for (auto &image_cam_pair : state.imagecams)
+            used = used || ServerConfig::camera_matches(entry.first, image_cam_pair.second->get_info().idstr, image_cam_pair.second->get_info().serial);
+        if (!used)
+        {
+            ZSYS_WARNING("aDIO bit %d: no open camera matches %s.", entry.second, entry.first.c_str());
+        }
+    }
+    return VmbErrorSuccess;
+}
+
+void CaptureManager::close()
+{
+    delete state.bundler;
+    state.bundler = nullptr;
+    delete state.notifier;
+    state.notifier = nullptr;
+    for (auto &image_cam_pair : state.imagecams)
+    {
+        delete image_cam_pair.second;
+    }
+    state.imagecams.clear();
+    state.caminfos.clear();
+    state.camids.clear();
+    if (api_open)
+    {
+        allied_close_api();
+        api_open = false;
+    }
+    if (state.adio_dev != nullptr)
+    {
+        CloseDIO_aDIO(state.adio_dev);
+        state.adio_dev = nullptr;
+    }
+}
+
+std::vector<uint32_t> CaptureManager::camera_ids() const
+{
+    std::vector<uint32_t> ids;
+    for (auto &image_cam_pair : state.imagecams)
+    {
+        ids.push_back(image_cam_pair.first);
+    }
+    return ids;
+}
+
+ImageCam *CaptureManager::camera(uint32_t cam_id)
+{
+    auto it = state.imagecams.find(cam_id);
+    return it == state.imagecams.end() ? nullptr : it->second;
+}
+
+VmbError_t CaptureManager::execute(NetPacket &packet)
+{
+    state.reply.clear();
+    uint32_t chash = atol(packet.cam_id.c_str()); // get camera hash
+    return cmd_handlers[(int)cmd_lookup(packet.cmd_type)](state, packet, chash);
+}
+
+void CaptureManager::poll(int64_t now_ms)
+{
+    if (state.start_at_us > 0 && host_realtime_us() >= state.start_at_us - START_SPIN_US)
+    {
+        int64_t start_us = state.start_at_us;
+        state.start_at_us = 0;
+        while (host_realtime_us() < start_us)
+            ;
+        start_all_cameras(state);
+    }
+    if (now_ms - stats_last >= stats_interval)
+    {
+        stats_last = now_ms;
+        for (auto &image_cam_pair : state.imagecams)
+        {
+            if (!image_cam_pair.second->poll_stream_stats())
+                continue;
+            StreamStats stats, delta;
+            image_cam_pair.second->get_stream_stats(stats, delta);
+            if (delta.available && (delta.packets_missed > 0 || delta.packets_resent > 0 || delta.frames_dropped > 0))
+            {
+                ZSYS_WARNING("Camera %s: %ld packets missed, %ld resent, %ld frames dropped in the last %ld ms.", image_cam_pair.second->get_info().idstr.c_str(), delta.packets_missed, delta.packets_resent, delta.frames_dropped, stats_interval);
+            }
+        }
+    }
+    for (auto &image_cam_pair : state.imagecams)
+    {
+        if (image_cam_pair.second->check_stall(now_ms, state.watchdog_periods))
+        {
+            ZSYS_WARNING("Camera %s: no frames for %d frame periods, restarting stream.", image_cam_pair.second->get_info().idstr.c_str(), state.watchdog_periods);
+        }
+        image_cam_pair.second->poll_sequence();
+        if (image_cam_pair.second->running() && image_cam_pair.second->sequence_done())
+        {
+            image_cam_pair.second->stop_capture();
+            ZSYS_INFO("Camera %s: Exposure sequence complete, stopping capture.", image_cam_pair.second->get_info().idstr.c_str());
+        }
+        if (image_cam_pair.second->running())
+        {
+            int64_t elapsed = image_cam_pair.second->capture_time(now_ms);
+            if (elapsed > state.capture_timelim)
+            {
+                image_cam_pair.second->stop_capture();
+                ZSYS_INFO("Camera %s: Capture time limit reached (%ld ms), stopping capture.", image_cam_pair.second->get_info().idstr.c_str(), state.capture_timelim);
+            }
+            else
+            {
+                ZSYS_INFO("Camera %s: Capture time remaining %ld ms, not stopping capture.", image_cam_pair.second->get_info().idstr.c_str(), state.capture_timelim - elapsed);
+            }
+        }
+    }
+}
+
+int64_t CaptureManager::poll_timeout(int64_t max_ms) const
+{
+    for (auto &image_cam_pair : state.imagecams)
+    {
+        if (image_cam_pair.second->running() && image_cam_pair.second->sequence_length() > 0)
+        {
+            max_ms = std::min(max_ms, SEQ_POLL_MS);
+            break;
+        }
+    }
+    if (state.start_at_us <= 0)
+        return max_ms;
+    int64_t wait_ms = (state.start_at_us - START_SPIN_US - host_realtime_us()) / 1000;
+    return std::max<int64_t>(0, std::min(wait_ms, max_ms));
+}
+
+void CaptureManager::enable_bundling(const std::string &endpoint)
+{
+    if (state.bundler == nullptr && state.imagecams.size() > 1)
+    {
+        state.bundler = new FrameBundler(endpoint, state.imagecams);
+    }
+}
+
+void CaptureManager::enable_notifications(const std::string &endpoint)
+{
+    if (state.notifier == nullptr)
+    {
+        state.notifier = new FeatureNotifier(endpoint, state.imagecams);
+    }
+}
+
+VmbError_t CaptureManager::set_frame_callback(uint32_t cam_id, capture_frame_cb_t cb, void *user)
+{
+    ImageCam *image_cam = camera(cam_id);
+    if (image_cam == nullptr)
+    {
+        return VmbErrorNotFound;
+    }
+    image_cam->set_frame_hook(cb, user, cam_id);
+    return VmbErrorSuccess;
+}
@@ -0,0 +1,75 @@
+/**
+ * @file coordinator.cpp
+ * @brief Cluster coordinator: one capture server front end for the
+ * capture servers of several hosts.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <czmq.h>
+#include <string>
+#include <vector>
+
+#include "server.hpp"
+#include "coordinator.hpp"
+
+int main(int argc, char *argv[])
+{
+    // Initialize ZSYS
+    void *zctx = zsys_init();
+    if (zctx == NULL)
+    {
+        dbprintlf(FATAL "Could not initialize ZSYS.");
+        return 1;
+    }
+    // arguments
+    int port = 5600;
+    std::vector<std::string> servers;
+    // Argument parsing
+    {
+        int c;
+        while ((c = getopt(argc, argv, "s:p:h")) != -1)
+        {
+            switch (c)
+            {
+            case 's':
+            {
+                ZSYS_INFO("Capture server: %s", optarg);
+                servers.push_back(optarg);
+                break;
+            }
+            case 'p':
+            {
+                ZSYS_INFO("Port number: %s", optarg);
+                port = atoi(optarg);
+                if (port < 5000 || port > 65535)
+                {
+                    ZSYS_ERROR("Invalid port number: %d", port);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            }
+            case 'h':
+            default:
+            {
+                printf("\nUsage: %s -s host:port [-s host:port ...] [-p ZMQ Port] [-h Show this message]\n\n", argv[0]);
+                exit(EXIT_SUCCESS);
+            }
+            }
+        }
+    }
+    if (servers.empty())
+    {
+        ZSYS_ERROR("No capture servers given, use -s host:port.");
+        return 1;
+    }
+    int ret;
+    {
+        Coordinator coordinator(servers);
+        ret = coordinator.run(port);
+    }
+    zsys_shutdown();
+    return ret;
+}
@@ -22,9 +22,100 @@
 #include <signal.h>
 
 #include "server.hpp"
-#include "imagecam.hpp"
-#include "stringhasher.hpp"
+#include "capture_manager.hpp"
 #include "string_format.hpp"
+#include "replycache.hpp"
+#include "requestqueue.hpp"
+#include "latencyhist.hpp"
+#include "supervisor.hpp"
+
+// transport state around the capture manager
+struct ServerState
+{
+    CaptureManager manager;
+    // Replies to recent requests that carried a req_id, per client
+    ReplyCache replies;
+    // Requests dropped because their deadline had passed
+    uint64_t nshed = 0;
+    // Receipt to reply, per lane
+    LatencyHist lane_latency[(int)Lane::Count];
+};
+
+// server wide entries of the all-camera metrics reply
+static void append_server_metrics(ServerState &state, ReplyArena &reply)
+{
+    reply.push_back("server.reply_cache_hits");
+    reply.push_back(state.replies.hits());
+    reply.push_back("server.requests_shed");
+    reply.push_back(state.nshed);
+    for (int lane = 0; lane < (int)Lane::Count; lane++)
+    {
+        const LatencyHist &hist = state.lane_latency[lane];
+        char prefix[32];
+        snprintf(prefix, sizeof(prefix), "server.lane.%s.", lane_name((Lane)lane));
+        reply.push_join(prefix, "requests");
+        reply.push_back(hist.samples());
+        reply.push_join(prefix, "p50_us");
+        reply.push_back(hist.percentile(50));
+        reply.push_join(prefix, "p99_us");
+        reply.push_back(hist.percentile(99));
+        reply.push_join(prefix, "max_us");
+        reply.push_back(hist.max());
+    }
+}
+
+// run one request, or answer it from the reply cache, and send the reply
+static void serve_request(ServerState &state, PendingRequest &req, std::string &txbuf)
+{
+    NetPacket &packet = req.packet;
+    const std::string *cached = req.decoded ? state.replies.find(req.client, packet.req_id) : nullptr;
+    if (cached != nullptr)
+    {
+        ZSYS_INFO("%s (%s): retransmit, replying from cache", packet.cmd_type.c_str(), packet.req_id.c_str());
+    }
+    else
+    {
+        VmbError_t err = VmbErrorBadParameter; // malformed packet or wrong command
+        ReplyArena none;
+        const ReplyArena *reply = &none;
+        int64_t now_ms = zclock_time(); // deadlines are wall clock, the client may be on another host
+        bool shed = req.decoded && packet.deadline > 0 && now_ms > packet.deadline;
+        if (shed)
+        {
+            // the client gave up already, do not touch the camera for it
+            err = VmbErrorTimeout;
+            state.nshed++;
+            ZSYS_WARNING("%s: deadline passed %ld ms ago, dropped.", packet.cmd_type.c_str(), now_ms - packet.deadline);
+        }
+        else if (req.decoded && req.control_endpoint && req.lane != Lane::Control)
+        {
+            // keep the control endpoint free of slow configuration work
+            err = VmbErrorInvalidCall;
+            ZSYS_WARNING("%s: not accepted on the control endpoint.", packet.cmd_type.c_str());
+        }
+        else if (req.decoded)
+        {
+            err = state.manager.execute(packet);
+            reply = &state.manager.reply();
+        }
+        else
+        {
+            ZSYS_ERROR("Malformed packet.");
+        }
+        packet.retcode = err; // set return code
+        encode_netpacket(packet, *reply, txbuf);
+        if (!shed) // a retransmit with a new deadline must run
+            state.replies.insert(req.client, packet.req_id, txbuf);
+    }
+    // send reply
+    const std::string &out = cached != nullptr ? *cached : txbuf;
+    for (size_t i = 0; i < req.nenvelope; i++)
+    {
+        zmq_send(req.sock, req.envelope[i].data(), req.envelope[i].size(), ZMQ_SNDMORE);
+    }
+    zmq_send(req.sock, out.data(), out.size(), 0);
+    state.lane_latency[(int)req.lane].add(zclock_usecs() - req.recv_us);
+}
 
 int main(int argc, char *argv[])
 {
@@ -35,146 +126,185 @@ int main(int argc, char *argv[])
         dbprintlf(FATAL "Could not initialize ZSYS.");
         return 1;
     }
-    // arguments
-    int adio_minor_num = 0;
-    int port = 5555;
-    std::string camera_id = "";
+    // Configuration: the file given with -f, then the other options over it
+    ServerConfig config;
+    {
+        int c;
+        opterr = 0;
+        while ((c = getopt(argc, argv, "f:c:a:p:e:k:b:m:swh")) != -1)
+        {
+            if (c != 'f')
+                continue;
+            ZSYS_INFO("Configuration file: %s", optarg);
+            std::string err;
+            if (!config.load(optarg, err))
+            {
+                ZSYS_ERROR("Could not load configuration: %s", err.c_str());
+                exit(EXIT_FAILURE);
+            }
+        }
+        opterr = 1;
+        optind = 1;
+    }
     // Argument parsing
     {
         int c;
-        while ((c = getopt(argc, argv, "c:a:h")) != -1)
+        bool cli_cameras = false;
+        while ((c = getopt(argc, argv, "f:c:a:p:e:k:b:m:swh")) != -1)
         {
             switch (c)
             {
+            case 'f':
+            {
+                break;
+            }
             case 'c':
             {
-                ZSYS_INFO("Camera ID from command line: %s\n", optarg);
-                camera_id = optarg;
+                ZSYS_INFO("Camera ID from command line: %s", optarg);
+                // cameras given here replace those of the file
+                if (!cli_cameras)
+                    config.cameras.clear();
+                cli_cameras = true;
+                config.cameras.push_back(optarg);
                 break;
             }
             case 'a':
             {
-                ZSYS_INFO("ADIO minor number: %s\n", optarg);
-                adio_minor_num = atoi(optarg);
+                ZSYS_INFO("ADIO minor number: %s", optarg);
+                config.adio_minor = atoi(optarg);
                 break;
             }
             case 'p':
             {
-                ZSYS_INFO("Port number: %s\n", optarg);
-                port = atoi(optarg);
-                if (port < 5000 || port > 65535)
+                ZSYS_INFO("Port number: %s", optarg);
+                if (!config.parse_port(optarg))
+                {
+                    ZSYS_ERROR("Invalid port: %s", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            }
+            case 'e':
+            {
+                ZSYS_INFO("Endpoint: %s", optarg);
+                config.endpoint = optarg;
+                break;
+            }
+            case 'k':
+            {
+                ZSYS_INFO("CPUs: %s", optarg);
+                if (!ServerConfig::parse_cpu_list(optarg, config.cpus))
                 {
-                    ZSYS_ERROR("Invalid port number: %d", port);
+                    ZSYS_ERROR("Invalid CPU list: %s", optarg);
                     exit(EXIT_FAILURE);
                 }
                 break;
             }
+            case 'b':
+            {
+                ZSYS_INFO("Buffer budget: %s MB", optarg);
+                config.buffer_budget_mb = strtoull(optarg, NULL, 10);
+                break;
+            }
+            case 'm':
+            {
+                ZSYS_INFO("ADIO bit: %s", optarg);
+                if (!config.parse_adio_bit(optarg))
+                {
+                    ZSYS_ERROR("Invalid aDIO bit mapping, expected camera:bit: %s", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            }
+            case 's':
+            {
+                config.supervise = true;
+                break;
+            }
+            case 'w':
+            {
+                config.worker = true;
+                break;
+            }
             case 'h':
             default:
             {
-                printf("\nUsage: %s [-c Camera ID] [-a ADIO Minor Device] [-p ZMQ Port] [-h Show this message]\n\n", argv[0]);
-                exit(EXIT_SUCCESS);
+                printf("\nUsage: %s [-f Config file] [-c Camera ID or serial pattern, repeatable] [-a ADIO Minor Device, -1 for none] [-p ZMQ Port] [-e ZMQ Endpoint] [-k CPU list] [-b Buffer budget MB per camera] [-m Camera:ADIO bit, repeatable] [-s One worker process per camera] [-h Show this message]\n\n", argv[0]);
+                exit(c == 'h' ? EXIT_SUCCESS : EXIT_FAILURE);
             }
             }
         }
     }
-    // Create the pipe name
-    std::string pipe_name = string_format("tcp://*:%d", port);
-    // Set up ADIO
-    DeviceHandle adio_dev = nullptr;
-    if (OpenDIO_aDIO(&adio_dev, adio_minor_num) != 0)
+    if (config.worker)
     {
-        ZSYS_WARNING("Could not initialize ADIO API. Check if /dev/rtd-aDIO* exists. aDIO features will be disabled.");
-        adio_dev = nullptr;
+        // workers are only reached through the supervisor
+        config.endpoint = string_format("tcp://127.0.0.1:%d", config.port());
+        config.control_endpoint.clear();
+        config.bundle_endpoint.clear();
+        config.notify_endpoint.clear();
+        config.supervise = false;
     }
-    else
     {
-        // set up port A as output and set all bits to low
-        int ret = LoadPort0BitDir_aDIO(adio_dev, 1, 1, 1, 1, 1, 1, 1, 1);
-        if (ret == -1)
+        std::string err;
+        if (!config.validate(err))
         {
-            ZSYS_ERROR("Could not set PORT0 to output.");
+            ZSYS_ERROR("Invalid configuration: %s", err.c_str());
+            exit(EXIT_FAILURE);
         }
-        else
+    }
+    ZSYS_INFO("Endpoints: %s, control %s, bundle %s, notify %s.", config.endpoint.c_str(), config.get_control_endpoint().c_str(), config.get_bundle_endpoint().c_str(), config.get_notify_endpoint().c_str());
+    if (config.supervise)
+    {
+        int ret = 0;
         {
-            ret = WritePort_aDIO(adio_dev, 0, 0); // set all to low
-            if (ret < 0)
+            Supervisor supervisor(config);
+            if (supervisor.open() == VmbErrorSuccess)
             {
-                ZSYS_ERROR("Could not set all PORT0 bits to LOW: %s [%d]", strerror(ret), ret);
+                ret = supervisor.run();
             }
         }
+        zsys_shutdown();
+        return ret;
     }
-    // Initialize String Hasher
-    StringHasher hasher = StringHasher();
-    // Set up cameras
-    std::vector<uint32_t> camids;
-    std::map<uint32_t, CameraInfo> caminfos;
-    std::map<uint32_t, ImageCam *> imagecams;
-
-    VmbError_t err = allied_init_api(NULL);
-    if (err != VmbErrorSuccess)
+    if (!config.apply_cpus())
     {
-        ZSYS_ERROR("Failed to initialize Allied Vision API: %s", allied_strerr(err));
-        return 0;
+        ZSYS_WARNING("Could not pin to the configured CPUs: %s", strerror(errno));
     }
-
-    VmbUint32_t count;
-    VmbCameraInfo_t *vmbcaminfos;
-    err = allied_list_cameras(&vmbcaminfos, &count);
+    // Set up cameras
+    ServerState state;
+    VmbError_t err = state.manager.open(config);
     if (err != VmbErrorSuccess)
     {
-        ZSYS_ERROR("Failed to list cameras: %s", allied_strerr(err));
-        return 0;
-    }
-    if (count == 0)
-    {
-        ZSYS_ERROR("No cameras found.");
         return 0;
     }
-    for (VmbUint32_t idx = 0; idx < count; idx++)
-    {
-        CameraInfo caminfo = CameraInfo(vmbcaminfos[idx]);
-        uint32_t hash = hasher.get_hash(caminfo.idstr);
-        camids.push_back(hash);
-        caminfos.insert(std::pair<uint32_t, CameraInfo>(hash, caminfo));
-        ZSYS_INFO("Camera %d: %s | %s", idx, caminfo.idstr.c_str(), caminfo.name.c_str());
-        if (camera_id != "" && camera_id != caminfo.idstr) // if a camera id was specified and it doesn't match this camera
-        {
-            continue;
-        }
-        imagecams.insert(std::pair<uint32_t, ImageCam *>(hash, new ImageCam(caminfo, adio_dev)));
-    }
-    free(vmbcaminfos);
-    // Capture time limit
-    int64_t capture_timelim = 5000; // milliseconds
+    state.manager.set_metrics_hook([&state](ReplyArena &reply)
+                                   { append_server_metrics(state, reply); });
+    // Frame set bundling, only meaningful with more than one camera
+    state.manager.enable_bundling(config.get_bundle_endpoint());
+    state.manager.enable_notifications(config.get_notify_endpoint());
     // Setup ZMQ.
-    zsock_t *pipe = zsock_new_rep(pipe_name.c_str());
+    // ROUTER rather than REP: the client identity keys the reply cache, and
+    // REQ clients are served unchanged by echoing their envelope
+    zsock_t *pipe = zsock_new_router(config.endpoint.c_str());
     assert(pipe);
-    zpoller_t *poller = zpoller_new(pipe, NULL);
+    // Control endpoint, stop and quit only; they wait for nothing but each other
+    zsock_t *ctrl = zsock_new_router(config.get_control_endpoint().c_str());
+    assert(ctrl);
+    zpoller_t *poller = zpoller_new(pipe, ctrl, NULL);
     assert(poller);
+    // Request and reply buffers, reused across requests
+    RequestQueue queue;
+    std::string txbuf;
     // Loop, waiting for ZMQ commands and performing them as necessary.
-    while (!zsys_interrupted)
+    while (!zsys_interrupted && !state.manager.quit_requested())
     {
-        zsock_t *which = (zsock_t *)zpoller_wait(poller, 1000); // wait a second
+        // requests left over from a full batch were already read off the
+        // sockets, so the poller would not wake for them; only look in
+        int timeout_ms = queue.size() > 0 ? 0 : (int)state.manager.poll_timeout(1000); // wait a second, less ahead of a scheduled start
+        zsock_t *which = (zsock_t *)zpoller_wait(poller, timeout_ms);
         // here we have returned, either for a timeout or because we have a message
-        int64_t currtime = zclock_mono();
-        for (auto &image_cam_pair : imagecams)
-        {
-            if (image_cam_pair.second->running())
-            {
-                int64_t elapsed = image_cam_pair.second->capture_time(currtime);
-                if (elapsed > capture_timelim)
-                {
-                    image_cam_pair.second->stop_capture();
-                    ZSYS_INFO("Camera %s: Capture time limit reached (%ld ms), stopping capture.", image_cam_pair.second->get_info().idstr.c_str(), capture_timelim);
-                }
-                else
-                {
-                    ZSYS_INFO("Camera %s: Capture time remaining %ld ms, not stopping capture.", image_cam_pair.second->get_info().idstr.c_str(), capture_timelim - elapsed);
-                }
-            }
-        }
-        if (which == NULL)
+        state.manager.poll(zclock_mono());
+        if (which == NULL && queue.size() == 0)
         {
             if (zsys_interrupted)
             {
@@ -182,344 +312,32 @@ int main(int argc, char *argv[])
             }
             continue;
         }
-        char *message = zstr_recv(which);
-        if (message == NULL)
+        // read everything waiting on both endpoints, then serve the control
+        // lane first; the endpoints are read again between requests so a stop
+        // arriving during a batch of slow sets runs next. One batch is bounded
+        // so the watchdog and capture limits above keep running under load.
+        queue.drain(zsock_resolve(ctrl), true);
+        queue.drain(zsock_resolve(pipe), false);
+        PendingRequest *req;
+        size_t nserved = 0;
+        while (nserved++ < RequestQueue::MAX_PENDING && (req = queue.next()) != nullptr)
         {
-            char *ident = zsock_identity(which);
-            ZSYS_INFO("Client disconnected: %s", ident);
-            zstr_free(&ident);
-            continue;
-        }
-        NetPacket packet = json::parse(message);
-        zstr_free(&message);
-
-        packet.retargs.clear();               // clear return arguments
-        uint32_t chash = atol(packet.cam_id.c_str()); // get camera hash
-        VmbError_t err = VmbErrorSuccess;     // set default error
-
-        if (packet.cmd_type == "quit")
-        {
-            ZSYS_INFO("Received quit command.");
-            zsys_interrupted = true;
-        }
-        else if (packet.cmd_type == "status") // should be sent every second by client if idle
-        {
-            // status
-            std::vector<std::string> reply;
-            if (packet.cam_id != "")
-            {
-                try
-                {
-                    ImageCam *image_cam = imagecams.at(chash);
-                    double temp;
-                    const char *tempsrc;
-                    allied_get_temperature(image_cam->handle, &temp);
-                    allied_get_temperature_src(image_cam->handle, &tempsrc);
-                    reply.push_back(image_cam->running() ? "True" : "False");
-                    reply.push_back(tempsrc);
-                    reply.push_back(std::to_string(temp));
-                    ZSYS_INFO("Camera %s: %s -> %.2f C", image_cam->get_info().idstr.c_str(), tempsrc, temp);
-                }
-                catch (const std::out_of_range &oor)
-                {
-                    err = VmbErrorNotFound;
-                }
-            }
-            else
-            {
-                for (auto &image_cam_pair : imagecams)
-                {
-                    double temp;
-                    const char *tempsrc;
-                    allied_get_temperature(image_cam_pair.second->handle, &temp);
-                    allied_get_temperature_src(image_cam_pair.second->handle, &tempsrc);
-                    reply.push_back(std::to_string(image_cam_pair.first));
-                    reply.push_back(image_cam_pair.second->get_info().idstr);
-                    reply.push_back(image_cam_pair.second->running() ? "True" : "False");
-                    reply.push_back(tempsrc);
-                    reply.push_back(std::to_string(temp));
-                    ZSYS_INFO("Camera %s: %s -> %.2f C", image_cam_pair.second->get_info().idstr.c_str(), tempsrc, temp);
-                }
-            }
-            packet.retargs = reply;
-        }
-        else if (packet.cmd_type == "list")
-        {
-            // list cameras
-            for (auto &hash : camids)
-            {
-                packet.retargs.push_back(std::to_string(hash));
-            }
-        }
-        else if (packet.cmd_type == "start_capture_all")
-        {
-            err = VmbErrorSuccess;
-            for (auto &image_cam_pair : imagecams)
-            {
-                err = image_cam_pair.second->start_capture();
-                ZSYS_INFO("start_capture_all (%s): %s", image_cam_pair.second->get_info().idstr.c_str(), allied_strerr(err));
-                if (err != VmbErrorSuccess)
-                {
-                    break;
-                }
-            }
-        }
-        else if (packet.cmd_type == "stop_capture_all")
-        {
-            err = VmbErrorSuccess;
-            for (auto &image_cam_pair : imagecams)
-            {
-                err = image_cam_pair.second->stop_capture();
-                ZSYS_INFO("stop_capture_all (%s): %s", image_cam_pair.second->get_info().idstr.c_str(), allied_strerr(err));
-                if (err != VmbErrorSuccess)
-                {
-                    break;
-                }
-            }
-        }
-        else if (packet.cmd_type == "start_capture")
-        {
-            try
-            {
-                ImageCam *image_cam = imagecams.at(chash);
-                err = image_cam->start_capture(); // do this for specific camera id
-                ZSYS_INFO("start_capture (%s): %s", image_cam->get_info().idstr.c_str(), allied_strerr(err));
-            }
-            catch (const std::out_of_range &oor)
-            {
-                err = VmbErrorNotFound;
-                ZSYS_INFO("start_capture (%s): %s", std::to_string(chash), allied_strerr(err));
-            }
-        }
-        else if (packet.cmd_type == "stop_capture")
-        {
-            try
-            {
-                ImageCam *image_cam = imagecams.at(chash);
-                err = image_cam->stop_capture(); // do this for specific camera id
-                ZSYS_INFO("stop_capture (%s): %s", image_cam->get_info().idstr.c_str(), allied_strerr(err));
-            }
-            catch (const std::out_of_range &oor)
-            {
-                err = VmbErrorNotFound;
-                ZSYS_INFO("stop_capture (%s): %s", std::to_string(chash), allied_strerr(err));
-            }
-        }
-        else if (packet.cmd_type == "get")
-        {
-            try
-            {
-                ImageCam *image_cam = imagecams.at(chash);
-                std::vector<std::string> reply;
-                switch (packet.command)
-                {
-                    GET_CASE_STR(image_format)
-                    GET_CASE_STR(sensor_bit_depth)
-                    GET_CASE_STR(trigline)
-                    GET_CASE_STR(trigline_mode)
-                    GET_CASE_STR(trigline_src)
-                    GET_CASE_DBL(exposure_us)
-                    GET_CASE_DBL(acq_framerate)
-                    GET_CASE_BOOL(acq_framerate_auto)
-                    GET_CASE_INT(throughput_limit)
-                    GET_CASE_LIST(trigline_src_list)
-                    GET_CASE_LIST(triglines_list)
-                    GET_CASE_LIST(image_format_list)
-                    GET_CASE_LIST(sensor_bit_depth_list)
-                case CommandNames::frame_size:
-                {
-                    uint32_t fsize = allied_get_frame_size(image_cam->handle);
-                    ZSYS_INFO("get (%s): frame_size -> %d", image_cam->get_info().idstr.c_str(), fsize);
-                    reply.push_back(std::to_string(fsize));
-                    break;
-                }
-                case CommandNames::sensor_size:
-                {
-                    VmbInt64_t width = 0, height = 0;
-                    err = allied_get_sensor_size(image_cam->handle, &width, &height);
-                    ZSYS_INFO("get (%s): sensor_size -> %ld x %ld", image_cam->get_info().idstr.c_str(), width, height);
-                    reply.push_back(std::to_string(width));
-                    reply.push_back(std::to_string(height));
-                    break;
-                }
-                case CommandNames::image_size:
-                {
-                    VmbInt64_t width = 0, height = 0;
-                    err = allied_get_image_size(image_cam->handle, &width, &height);
-                    ZSYS_INFO("get (%s): image_size -> %ld x %ld", image_cam->get_info().idstr.c_str(), width, height);
-                    reply.push_back(std::to_string(width));
-                    reply.push_back(std::to_string(height));
-                    break;
-                }
-                case CommandNames::image_ofst:
-                {
-                    VmbInt64_t width = 0, height = 0;
-                    err = allied_get_image_ofst(image_cam->handle, &width, &height);
-                    ZSYS_INFO("get (%s): image_ofst -> %ld x %ld", image_cam->get_info().idstr.c_str(), width, height);
-                    reply.push_back(std::to_string(width));
-                    reply.push_back(std::to_string(height));
-                    break;
-                }
-                case CommandNames::adio_bit:
-                {
-                    ZSYS_INFO("get (%s): adio_bit", image_cam->get_info().idstr.c_str());
-                    reply.push_back(std::to_string(image_cam->adio_bit));
-                    break;
-                }
-                case CommandNames::throughput_limit_range:
-                {
-                    VmbInt64_t vmin = 0, vmax = 0;
-                    err = allied_get_throughput_limit_range(image_cam->handle, &vmin, &vmax, NULL);
-                    ZSYS_INFO("get (%s): throughput_limit_range -> %ld, %ld", image_cam->get_info().idstr.c_str(), vmin, vmax);
-                    reply.push_back(std::to_string(vmin));
-                    reply.push_back(std::to_string(vmax));
-                    break;
-                }
-                case CommandNames::camera_info:
-                {
-                    ZSYS_INFO("get (%s): camera_info", image_cam->get_info().idstr.c_str());
-                    reply.push_back(std::to_string(image_cam->get_info()));
-                }
-                case CommandNames::capture_maxlen:
-                {
-                    ZSYS_INFO("get: capture_maxlen: %ld", capture_timelim);
-                    reply.push_back(std::to_string(capture_timelim));
-                    break;
-                }
-                default:
-                {
-                    err = VmbErrorWrongType; // wrong command
-                    break;
-                }
-                }
-                packet.retargs = reply;
-            }
-            catch (const std::out_of_range &oor)
-            {
-                err = VmbErrorNotFound;
-            }
-        }
-        else if (packet.cmd_type == "set")
-        {
-            if (packet.arguments.size() < 1) // no data to set
-            {
-                ZSYS_ERROR("No data to set.");
-                err = VmbErrorNoData;
-            }
-            else
-            {
-                std::vector<std::string> reply;
-                const char *argument = packet.arguments[0].c_str(); // this must exist at this point
-                try
-                {
-                    ImageCam *image_cam = imagecams.at(chash);
-                    switch (packet.command)
-                    {
-                        SET_CASE_STR(image_format)
-                        SET_CASE_STR(sensor_bit_depth)
-                        SET_CASE_STR(trigline)
-                        SET_CASE_STR(trigline_mode)
-                        SET_CASE_STR(trigline_src)
-                        SET_CASE_DBL(exposure_us)
-                        SET_CASE_DBL(acq_framerate)
-                        SET_CASE_BOOL(acq_framerate_auto)
-                        SET_CASE_INT(throughput_limit)
-                    case CommandNames::image_size:
-                    {
-                        if (packet.arguments.size() != 2)
-                        {
-                            err = VmbErrorWrongType;
-                            break;
-                        }
-                        VmbInt64_t arg1l = atol(packet.arguments[0].c_str());
-                        VmbInt64_t arg2l = atol(packet.arguments[1].c_str());
-                        ZSYS_INFO("set (%s): image_size -> %ld x %ld", image_cam->get_info().idstr.c_str(), arg1l, arg2l);
-                        err = allied_set_image_size(image_cam->handle, arg1l, arg2l);
-                        if (err != VmbErrorSuccess)
-                        {
-                            break;
-                        }
-                        err = allied_get_image_size(image_cam->handle, &arg1l, &arg2l);
-                        ZSYS_INFO("set (%s): image_size = %ld x %ld", image_cam->get_info().idstr.c_str(), arg1l, arg2l);
-                        reply.push_back(std::to_string(arg1l));
-                        reply.push_back(std::to_string(arg2l));
-                        break;
-                    }
-                    case CommandNames::image_ofst:
-                    {
-                        if (packet.arguments.size() != 2)
-                        {
-                            err = VmbErrorWrongType;
-                            break;
-                        }
-                        VmbInt64_t arg1l = atol(packet.arguments[0].c_str());
-                        VmbInt64_t arg2l = atol(packet.arguments[1].c_str());
-                        ZSYS_INFO("set (%s): image_ofst -> %ld x %ld", image_cam->get_info().idstr.c_str(), arg1l, arg2l);
-                        err = allied_set_image_ofst(image_cam->handle, arg1l, arg2l);
-                        if (err != VmbErrorSuccess)
-                        {
-                            break;
-                        }
-                        err = allied_get_image_ofst(image_cam->handle, &arg1l, &arg2l);
-                        ZSYS_INFO("set (%s): image_ofst = %ld x %ld", image_cam->get_info().idstr.c_str(), arg1l, arg2l);
-                        reply.push_back(std::to_string(arg1l));
-                        reply.push_back(std::to_string(arg2l));
-                        break;
-                    }
-                    case CommandNames::adio_bit:
-                    {
-                        long arg1l = atol(argument);
-                        image_cam->adio_bit = arg1l;
-                        ZSYS_INFO("set (%s): adio_bit = %d", image_cam->get_info().idstr.c_str(), image_cam->adio_bit);
-                        reply.push_back(std::to_string(arg1l));
-                        break;
-                    }
-                    case CommandNames::capture_maxlen:
-                    {
-                        long arg1l = atol(argument);
-                        if (arg1l < 1000)
-                        {
-                            ZSYS_WARNING("Capture time limit too low, setting to 1000 ms.");
-                            arg1l = 1000;
-                        }
-                        capture_timelim = arg1l;
-                        ZSYS_INFO("set: capture_maxlen = %ld", capture_timelim);
-                        reply.push_back(std::to_string(arg1l));
-                        break;
-                    }
-                    default:
-                    {
-                        err = VmbErrorWrongType; // wrong command
-                        break;
-                    }
-                    }
-                }
-                catch (const std::out_of_range &oor)
-                {
-                    err = VmbErrorNotFound;
-                }
-                packet.retargs = reply;
-            }
-        }
-        else
-        {
-            err = VmbErrorBadParameter; // wrong command
+            serve_request(state, *req, txbuf);
+            queue.release(req);
+            if (zsys_interrupted || state.manager.quit_requested())
+                break;
+            queue.drain(zsock_resolve(ctrl), true);
+            queue.drain(zsock_resolve(pipe), false);
         }
-        packet.retcode = err; // set return code
-        // send reply
-        json j = packet;
-        zstr_send(which, j.dump().c_str());
     }
     // Cleanup
     zpoller_destroy(&poller);
+    zsock_destroy(&ctrl);
     zsock_destroy(&pipe);
+    // the bundler and notifier threads own PUB sockets; stop them before
+    // zsys_shutdown closes whatever sockets are still open
+    state.manager.close();
     zsys_shutdown();
-    for (auto &image_cam_pair : imagecams)
-    {
-        delete image_cam_pair.second;
-    }
-    if (adio_dev != nullptr)
-        CloseDIO_aDIO(adio_dev);
 
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,245 @@
+/**
+ * @file test_coordinator.cpp
+ * @brief The cluster coordinator in front of two stub capture servers on
+ * local ports: aggregated list and status, a scheduled start_capture_all
+ * with per-server clock offsets, and merged metrics.
+ *
+ * The stubs answer the capture server protocol without cameras; the
+ * second one runs its clock STUB_OFFSET_US ahead, so the start it is sent
+ * must be shifted by that much.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <math.h>
+#include <czmq.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <atomic>
+#include <thread>
+
+#include "coordinator.hpp"
+
+static const int COORD_PORT = 5700;
+static const int64_t STUB_OFFSET_US = 50000;
+static const int64_t TOLERANCE_US = 5000; // loopback round trips and ms rounding
+
+static int nfailed = 0;
+
+static void check(bool cond, const char *what)
+{
+    printf("%s: %s\n", cond ? "ok" : "FAILED", what);
+    if (!cond)
+        nfailed++;
+}
+
+// capture server protocol on one port, a fixed set of cameras, no hardware
+struct StubServer
+{
+    int port;
+    int64_t offset_us; // clock ahead of the host clock
+    std::vector<uint32_t> cams;
+    std::atomic<bool> quit{false};
+    std::atomic<int64_t> start_at_us{-1}; // as received, in this stub's clock
+    std::thread thread;
+
+    StubServer(int port, int64_t offset_us, std::vector<uint32_t> cams) : port(port), offset_us(offset_us), cams(cams) {}
+
+    int64_t clock_us() const
+    {
+        return host_realtime_us() + offset_us;
+    }
+
+    void answer(NetPacket &packet)
+    {
+        std::vector<std::string> &out = packet.retargs;
+        out.clear();
+        CmdType type = cmd_lookup(packet.cmd_type);
+        if (type == CmdType::List)
+        {
+            for (uint32_t cam : cams)
+                out.push_back(std::to_string(cam));
+        }
+        else if (type == CmdType::Status)
+        {
+            for (uint32_t cam : cams)
+            {
+                std::vector<std::string> entry = {std::to_string(cam), "DEV_" + std::to_string(cam), "False", "Sensor", "40.000000", "-1", "-1", "-1"};
+                out.insert(out.end(), entry.begin(), entry.end());
+            }
+        }
+        else if (type == CmdType::Metrics)
+        {
+            for (uint32_t cam : cams)
+            {
+                out.push_back(std::to_string(cam) + ".frames");
+                out.push_back("0");
+                out.push_back(std::to_string(cam) + ".start_us");
+                out.push_back(std::to_string(start_at_us.load()));
+            }
+            out.push_back("server.reply_cache_hits");
+            out.push_back("0");
+            out.push_back("server.clock_us");
+            out.push_back(std::to_string(clock_us()));
+        }
+        else if (type == CmdType::StartCaptureAll)
+        {
+            int64_t entry_us = clock_us();
+            int64_t start_us = packet.arguments.size() > 0 ? llround(strtod(packet.arguments[0].c_str(), NULL) * 1000) : entry_us;
+            start_at_us = start_us; // the cameras start on time
+            out = {"entry_us", std::to_string(entry_us), "exit_us", std::to_string(clock_us()), "start_at_us", std::to_string(start_us)};
+        }
+        else if (type == CmdType::Quit)
+        {
+            quit = true;
+        }
+        else
+        {
+            packet.retcode = VmbErrorBadParameter;
+            return;
+        }
+        packet.retcode = VmbErrorSuccess;
+    }
+
+    void run()
+    {
+        zsock_t *router = zsock_new_router(string_format("tcp://127.0.0.1:%d", port).c_str());
+        zpoller_t *poller = zpoller_new(router, NULL);
+        std::string txbuf;
+        while (!quit)
+        {
+            if (zpoller_wait(poller, 50) == NULL)
+                continue;
+            zmsg_t *msg = zmsg_recv(router);
+            if (msg == NULL)
+                break;
+            zmsg_t *reply = zmsg_new();
+            while (zmsg_size(msg) > 1)
+            {
+                zframe_t *frame = zmsg_pop(msg);
+                zmsg_append(reply, &frame);
+            }
+            char *payload = zmsg_popstr(msg);
+            NetPacket packet = json::parse(payload).get<NetPacket>();
+            zstr_free(&payload);
+            answer(packet);
+            encode_netpacket(packet, txbuf);
+            zmsg_addstr(reply, txbuf.c_str());
+            zmsg_send(&reply, router);
+            zmsg_destroy(&msg);
+        }
+        zpoller_destroy(&poller);
+        zsock_destroy(&router);
+    }
+
+    void start()
+    {
+        thread = std::thread([this]()
+                             { run(); });
+    }
+};
+
+static bool transact(zsock_t *req, const char *cmd_type, const std::vector<std::string> &arguments, NetPacket &reply)
+{
+    NetPacket packet;
+    packet.cmd_type = cmd_type;
+    packet.cam_id = "";
+    packet.arguments = arguments;
+    std::string txbuf;
+    encode_netpacket(packet, txbuf);
+    zstr_send(req, txbuf.c_str());
+    char *rx = zstr_recv(req);
+    if (rx == NULL)
+        return false;
+    reply = json::parse(rx).get<NetPacket>();
+    zstr_free(&rx);
+    return true;
+}
+
+// name, value pairs of a reply
+static std::map<std::string, std::string> pairs(const NetPacket &reply)
+{
+    std::map<std::string, std::string> values;
+    for (size_t i = 0; i + 1 < reply.retargs.size(); i += 2)
+        values[reply.retargs[i]] = reply.retargs[i + 1];
+    return values;
+}
+
+static bool near(int64_t value, int64_t expected)
+{
+    return llabs(value - expected) <= TOLERANCE_US;
+}
+
+int main()
+{
+    zsys_init();
+    StubServer stub1(COORD_PORT + 10, 0, {1001, 1002});
+    StubServer stub2(COORD_PORT + 20, STUB_OFFSET_US, {2001, 2002});
+    stub1.start();
+    stub2.start();
+    std::string name1 = string_format("127.0.0.1:%d", stub1.port);
+    std::string name2 = string_format("127.0.0.1:%d", stub2.port);
+    Coordinator coordinator({name1, name2});
+    std::thread coord_thread([&]()
+                             { coordinator.run(COORD_PORT); });
+    zsock_t *req = zsock_new_req(string_format(">tcp://127.0.0.1:%d", COORD_PORT).c_str());
+    zsock_set_rcvtimeo(req, 2000);
+
+    // routes and clock offsets come from the first refresh
+    NetPacket reply;
+    std::map<std::string, std::string> metrics;
+    int64_t deadline = zclock_mono() + 5000;
+    while (zclock_mono() < deadline)
+    {
+        if (!transact(req, "metrics", {}, reply))
+            break;
+        metrics = pairs(reply);
+        if (metrics["coordinator." + name1 + ".offset_us"] != "None" && metrics["coordinator." + name2 + ".offset_us"] != "None" && metrics["coordinator." + name2 + ".cameras"] == "2")
+            break;
+        zclock_sleep(100);
+    }
+    check(metrics.count("coordinator." + name2 + ".offset_us") && metrics["coordinator." + name2 + ".offset_us"] != "None", "offsets measured by the route refresh");
+
+    check(transact(req, "list", {}, reply) && reply.retcode == VmbErrorSuccess, "list answered");
+    std::set<std::string> listed(reply.retargs.begin(), reply.retargs.end());
+    check(listed == std::set<std::string>({"1001", "1002", "2001", "2002"}), "list covers the cameras of both servers");
+
+    check(transact(req, "status", {}, reply) && reply.retcode == VmbErrorSuccess, "status answered");
+    check(reply.retargs.size() == 4 * Coordinator::STATUS_FIELDS, "status merges every camera");
+    check(reply.retargs.size() > 3 * Coordinator::STATUS_FIELDS && reply.retargs[0] == "1001" && reply.retargs[2 * Coordinator::STATUS_FIELDS] == "2001", "status in server order");
+
+    check(transact(req, "metrics", {}, reply) && reply.retcode == VmbErrorSuccess, "metrics answered");
+    metrics = pairs(reply);
+    check(metrics.count(name1 + ".server.clock_us") && metrics.count(name2 + ".server.clock_us"), "server clocks prefixed per server");
+    check(metrics.count(name1 + ".server.reply_cache_hits") && metrics.count(name2 + ".server.reply_cache_hits"), "server metrics prefixed per server");
+    check(metrics.count("1001.frames") && metrics.count("2002.frames"), "camera metrics of both servers");
+    check(near(atoll(metrics["coordinator." + name1 + ".offset_us"].c_str()), 0), "offset of the server on the host clock");
+    check(near(atoll(metrics["coordinator." + name2 + ".offset_us"].c_str()), STUB_OFFSET_US), "offset of the server ahead");
+
+    int64_t start_ms = zclock_time() + 300;
+    check(transact(req, "start_capture_all", {std::to_string(start_ms)}, reply) && reply.retcode == VmbErrorSuccess, "scheduled start_capture_all answered");
+    std::map<std::string, std::string> start = pairs(reply);
+    check(start.count("skew_us") && atoll(start["skew_us"].c_str()) <= TOLERANCE_US, "scheduled starts within the skew tolerance");
+    check(atoll(start["target_us"].c_str()) == start_ms * 1000, "target in the coordinator clock");
+    check(start.count(name1 + ".offset_us") && start.count(name2 + ".offset_us"), "offset per server");
+    check(start.count(name1 + ".start_at_us") && near(atoll(start[name2 + ".start_at_us"].c_str()), start_ms * 1000), "start per server in the coordinator clock");
+    check(near(stub1.start_at_us, start_ms * 1000), "server on the host clock sent the target");
+    check(near(stub2.start_at_us, start_ms * 1000 + STUB_OFFSET_US), "server ahead sent the target in its own clock");
+
+    check(transact(req, "metrics", {}, reply) && reply.retcode == VmbErrorSuccess, "metrics after the start answered");
+    metrics = pairs(reply);
+    check(metrics.count("coordinator.start_skew_us") && atoll(metrics["coordinator.start_skew_us"].c_str()) >= 0 && atoll(metrics["coordinator.start_skew_us"].c_str()) <= TOLERANCE_US, "camera start skew in the coordinator clock");
+
+    check(transact(req, "quit", {}, reply), "quit answered");
+    coord_thread.join();
+    stub1.quit = true;
+    stub2.quit = true;
+    stub1.thread.join();
+    stub2.thread.join();
+    zsock_destroy(&req);
+    printf("%d failed\n", nfailed);
+    return nfailed == 0 ? 0 : 1;
+}
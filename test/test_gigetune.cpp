@@ -0,0 +1,100 @@
+/**
+ * @file test_gigetune.cpp
+ * @brief Host checks of the GigE stream tuning step, against made-up NIC,
+ * packet size and socket buffer values.
+ *
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "gigetune.hpp"
+
+static int nfailed = 0;
+
+static bool has_warning(const GigETuneReport &report, const char *text)
+{
+    for (const std::string &warning : report.warnings)
+    {
+        if (warning.find(text) != std::string::npos)
+            return true;
+    }
+    return false;
+}
+
+static void check(bool cond, const char *what)
+{
+    printf("%s: %s\n", cond ? "ok" : "FAILED", what);
+    if (!cond)
+        nfailed++;
+}
+
+static GigETuneReport make_report(int64_t nic_mtu, int64_t packet_size, int64_t rmem_max)
+{
+    GigETuneReport report;
+    report.gige = true;
+    report.nic = "eth1";
+    report.nic_mtu = nic_mtu;
+    report.packet_size = packet_size;
+    report.rmem_max = rmem_max;
+    return report;
+}
+
+int main()
+{
+    const uint32_t frame_size = 5 << 20;
+    const int64_t rmem_ok = 16 << 20;
+    {
+        GigETuneReport report = make_report(9000, 8228, rmem_ok);
+        gige_check_host(report, frame_size);
+        check(report.warnings.empty(), "jumbo NIC with jumbo packets: no warnings");
+    }
+    {
+        GigETuneReport report = make_report(1500, 1500, rmem_ok);
+        gige_check_host(report, frame_size);
+        check(!has_warning(report, "exceeds NIC MTU"), "1500 byte packets fit a 1500 byte MTU");
+        check(has_warning(report, "enable jumbo frames"), "1500 byte MTU: suggest jumbo frames");
+    }
+    {
+        GigETuneReport report = make_report(1500, 1501, rmem_ok);
+        gige_check_host(report, frame_size);
+        check(has_warning(report, "exceeds NIC MTU"), "1501 byte packets exceed a 1500 byte MTU");
+    }
+    {
+        GigETuneReport report = make_report(9000, 1500, rmem_ok);
+        gige_check_host(report, frame_size);
+        check(has_warning(report, "supports jumbo frames"), "jumbo NIC with 1500 byte packets: jumbo unused");
+    }
+    {
+        GigETuneReport report = make_report(9000, 1501, rmem_ok);
+        gige_check_host(report, frame_size);
+        check(!has_warning(report, "supports jumbo frames"), "jumbo NIC with 1501 byte packets: jumbo in use");
+    }
+    {
+        GigETuneReport report = make_report(9000, 9001, rmem_ok);
+        gige_check_host(report, frame_size);
+        check(has_warning(report, "exceeds NIC MTU"), "9001 byte packets exceed a 9000 byte MTU");
+    }
+    {
+        GigETuneReport report = make_report(-1, 8228, rmem_ok);
+        gige_check_host(report, frame_size);
+        check(has_warning(report, "Could not determine the NIC"), "unknown NIC");
+    }
+    {
+        GigETuneReport report = make_report(9000, 8228, 212992);
+        gige_check_host(report, frame_size);
+        check(has_warning(report, "raise it to at least 10485760"), "small rmem_max: two frames wanted");
+        report.rmem_max = 10 << 20;
+        gige_check_host(report, frame_size);
+        check(report.warnings.empty(), "rmem_max of two frames: no warnings");
+    }
+    {
+        GigETuneReport report = make_report(9000, 8228, (4 << 20) - 1);
+        gige_check_host(report, 1024);
+        check(has_warning(report, "raise it to at least 4194304"), "small frames: 4 MiB wanted");
+    }
+    printf("%d failed\n", nfailed);
+    return nfailed == 0 ? 0 : 1;
+}